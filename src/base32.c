@@ -0,0 +1,152 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <string.h>  // For memcopy()
+
+#include "common.h"
+#include "base32.h"
+#include "qrcodegen.h"
+#include <gbdk/emu_debug.h>
+
+
+#pragma bank 255  // Autobanked
+
+
+// RFC 4648 alphabet: all of these are QR Code alphanumeric mode chars
+// (unlike base64, which needs lower case, and base45, which needs url-unsafe ' ' and '%')
+const uint8_t base32_digit_lut[32] = {
+    'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H',
+    'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P',
+    'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X',
+    'Y', 'Z', '2', '3', '4', '5', '6', '7'
+};
+
+// Streaming encodes this many source bytes (a multiple of 5, so only the last
+// chunk can be a partial unit) at a time into a small buffer which then gets appended to the QR Code
+#define B32_STREAM_CHUNK_IN_LEN  (BASE32_IN_LEN * 8u)
+#define B32_STREAM_CHUNK_OUT_LEN (B32_CALC_OUT_SZ(B32_STREAM_CHUNK_IN_LEN))
+
+
+static uint8_t chunk_buf[B32_STREAM_CHUNK_OUT_LEN];
+
+static uint16_t base32_encode(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len);
+
+
+uint16_t base32_encode_to_url(uint8_t * p_dest, const uint8_t * p_prefix, uint8_t prefix_len, const uint8_t * p_src, uint16_t src_len) BANKED {
+
+    memcpy(p_dest, p_prefix, prefix_len);
+    uint16_t out_len = prefix_len + base32_encode(p_dest + prefix_len, p_src, src_len);
+
+    // Append string null terminator (not included in the length, see base64_encode_to_url())
+    p_dest[out_len] = '\0';
+
+    return out_len;
+}
+
+
+uint16_t base32_qr_url_begin(const uint8_t * p_prefix, uint8_t prefix_len, uint16_t src_len) BANKED {
+
+    static qr_segment_t segments[QR_SEGMENTS_MAX];
+
+    // Far too large to fit long before this, but it keeps the 16 bit lengths below from overflowing
+    if ((src_len == 0u) || ((B32_CALC_OUT_SZ(src_len) + prefix_len) > 0xFFFFu)) return 0;
+    const uint16_t body_len = (uint16_t)B32_CALC_OUT_SZ(src_len);
+
+    // Prefix gets whatever segments suit it (leaving one for the body),
+    // then the base32 body is alphanumeric, joining the prefix's last segment if that is too
+    uint8_t count = qrcodegen_make_segments(p_prefix, prefix_len, segments, QR_SEGMENTS_MAX - 1u);
+    if (count && (segments[count - 1u].mode == qrcodegen_Mode_ALPHANUMERIC))
+        segments[count - 1u].len += body_len;
+    else {
+        segments[count].mode = qrcodegen_Mode_ALPHANUMERIC;
+        segments[count].len  = body_len;
+        count++;
+    }
+
+    if (!qrcodegen_stream_begin_segments(segments, count))
+        return 0;
+
+    return prefix_len + body_len;
+}
+
+
+uint16_t base32_encode_to_qr_url(const uint8_t * p_prefix, uint8_t prefix_len, const uint8_t * p_src, uint16_t src_len) BANKED {
+
+    const uint16_t out_len = base32_qr_url_begin(p_prefix, prefix_len, src_len);
+    if (out_len == 0u)
+        return 0;
+
+    qrcodegen_stream_append(p_prefix, prefix_len);
+
+    while (src_len) {
+        uint16_t chunk_in_len = (src_len > B32_STREAM_CHUNK_IN_LEN) ? B32_STREAM_CHUNK_IN_LEN : src_len;
+
+        qrcodegen_stream_append(chunk_buf, base32_encode(chunk_buf, p_src, chunk_in_len));
+        p_src   += chunk_in_len;
+        src_len -= chunk_in_len;
+    }
+
+    return out_len;
+}
+
+
+uint16_t base32_encode_url_part(uint8_t * p_dest, const uint8_t * p_prefix, uint8_t prefix_len, const uint8_t * p_src, uint16_t src_len,
+                                uint16_t url_offset, uint16_t max_len) BANKED {
+
+    uint8_t * p_dest_start = p_dest;
+
+    // Part of the prefix
+    if (url_offset < prefix_len) {
+        uint16_t len = prefix_len - url_offset;
+        if (len > max_len) len = max_len;
+        memcpy(p_dest, p_prefix + url_offset, len);
+        p_dest     += len;
+        max_len    -= len;
+        url_offset += len;
+    }
+
+    // Base32 gets encoded from the start of the unit the offset is in, skipping chars before it
+    url_offset -= prefix_len;
+    uint16_t src_offset = (url_offset / BASE32_OUT_LEN) * BASE32_IN_LEN;
+    uint8_t  skip       = url_offset % BASE32_OUT_LEN;
+
+    while (max_len && (src_offset < src_len)) {
+        uint16_t chunk_in_len = ((src_len - src_offset) > B32_STREAM_CHUNK_IN_LEN) ? B32_STREAM_CHUNK_IN_LEN : (src_len - src_offset);
+
+        uint16_t len = base32_encode(chunk_buf, p_src + src_offset, chunk_in_len);
+        if (len <= skip) break;  // Offset is past the end, in the chars a partial last unit doesn't have
+        len -= skip;
+        if (len > max_len) len = max_len;
+        memcpy(p_dest, chunk_buf + skip, len);
+        p_dest     += len;
+        max_len    -= len;
+        src_offset += chunk_in_len;
+        skip = 0u;
+    }
+
+    return (p_dest - p_dest_start);
+}
+
+
+// Encodes base32 without padding, 5 bits at a time from a bit accumulator
+static uint16_t base32_encode(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len) {
+
+    uint8_t * p_dest_start = p_dest;
+    uint16_t  bits = 0u;      // Pending source bits, left over ones at the bottom
+    uint8_t   bit_count = 0u;
+
+    while (src_len--) {
+        bits = (bits << 8) | *p_src++;
+        bit_count += 8u;
+
+        while (bit_count >= 5u) {
+            bit_count -= 5u;
+            *p_dest++ = base32_digit_lut[(bits >> bit_count) & 0x1Fu];
+        }
+    }
+
+    // Left over bits are padded with zeros up to a full char
+    if (bit_count)
+        *p_dest++ = base32_digit_lut[(bits << (5u - bit_count)) & 0x1Fu];
+
+    return (p_dest - p_dest_start);
+}
@@ -0,0 +1,42 @@
+#ifndef BASE32_H
+#define BASE32_H
+
+#include <stdint.h>
+
+#define BASE32_IN_LEN  5u  // Base32 works in 5 byte units
+#define BASE32_OUT_LEN 8u  // And writes out 8 byte units
+
+// No padding, so a partial last unit only takes as many chars as its bits need
+#define B32_CALC_OUT_SZ(len) ((((uint32_t)(len) * 8u) + 4u) / 5u)
+
+// Url formats for the QR Code (build with "make URL_BASE32=<prefix>" to select base32)
+//
+// - DATA_URL: "data:image/png;base64,..." opens directly in the browser, but is byte mode (8 bits per char)
+// - BASE32:   <prefix> + base32 of the PNG (RFC 4648 alphabet, no padding), which is all
+//             alphanumeric mode chars (5.5 bits per char). The prefix points at a copy of
+//             util/base32_viewer.html which decodes the part of the url after the "#"
+#define QR_URL_FORMAT_DATA_URL 0
+#define QR_URL_FORMAT_BASE32   1
+
+#ifndef QR_URL_FORMAT
+    #define QR_URL_FORMAT QR_URL_FORMAT_DATA_URL
+#endif
+
+uint16_t base32_encode_to_url(uint8_t * p_dest, const uint8_t * p_prefix, uint8_t prefix_len, const uint8_t * p_src, uint16_t src_len) BANKED;
+
+// Same url as base32_encode_to_url(), but streamed straight into the QR Code data bits with
+// qrcodegen_stream_begin_segments() / qrcodegen_stream_append(), without a buffer for the url.
+// The prefix gets split into the cheapest segments and the base32 part is alphanumeric.
+// Call qrcodegen_stream_end() afterward. Returns url length, or 0 if it doesn't fit in a QR Code
+uint16_t base32_encode_to_qr_url(const uint8_t * p_prefix, uint8_t prefix_len, const uint8_t * p_src, uint16_t src_len) BANKED;
+
+// Just the qrcodegen_stream_begin_segments() part of base32_encode_to_qr_url(), for appending the url
+// in pieces with base32_encode_url_part(). Returns url length, or 0 if it doesn't fit in a QR Code
+uint16_t base32_qr_url_begin(const uint8_t * p_prefix, uint8_t prefix_len, uint16_t src_len) BANKED;
+
+// Writes up to max_len chars of the url from url_offset onward (without a null terminator),
+// for splitting the url across several QR Codes. Returns the number of chars, 0 past the end
+uint16_t base32_encode_url_part(uint8_t * p_dest, const uint8_t * p_prefix, uint8_t prefix_len, const uint8_t * p_src, uint16_t src_len,
+                                uint16_t url_offset, uint16_t max_len) BANKED;
+
+#endif // BASE32_H
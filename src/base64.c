@@ -4,6 +4,7 @@
 
 #include "common.h"
 #include "base64.h"
+#include "qrcodegen.h"
 #include <gbdk/emu_debug.h>
 
 
@@ -42,12 +43,21 @@ const uint8_t url_base64_pngimage_prefix_sz = ARRAY_LEN(url_base64_pngimage_pref
 #define PAD_2_CHARS 2u
 #define PAD_1_CHARS 1u
 
+// Streaming encodes this many source bytes (a multiple of 3, so padding only happens
+// in the last chunk) at a time into a small buffer which then gets appended to the QR Code
+#define B64_STREAM_CHUNK_IN_LEN  (BASE64_IN_LEN * 16u)
+#define B64_STREAM_CHUNK_OUT_LEN (B64_CALC_OUT_SZ(B64_STREAM_CHUNK_IN_LEN))
+
+
+static uint8_t chunk_buf[B64_STREAM_CHUNK_OUT_LEN];
 
 static uint16_t base64_encode_url_format(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len);
 
 
 uint16_t base64_encode_to_url(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len) BANKED {
 
+    EMU_PROFILE_BEGIN(" B64 prof start ");
+
     // Convert to Base64 (offset past prefix)
     uint16_t out_len = base64_encode_url_format(p_dest + url_base64_pngimage_prefix_sz, p_src, src_len);
 
@@ -68,10 +78,82 @@ uint16_t base64_encode_to_url(uint8_t * p_dest, const uint8_t * p_src, uint16_t
 
     // EMU_printf(".2 B64 sz=%u\n", (uint16_t)out_len);
 
+    EMU_PROFILE_END(" B64 prof end: ");
+
+    return out_len;
+}
+
+
+uint16_t base64_qr_url_begin(uint16_t src_len) BANKED {
+
+    // The QR Code header needs the final length up front, which Base64 makes easy to calculate
+    const uint16_t out_len = url_base64_pngimage_prefix_sz + B64_CALC_OUT_SZ(src_len);
+    if (!qrcodegen_stream_begin(out_len))
+        return 0;
+
     return out_len;
 }
 
 
+uint16_t base64_encode_to_qr_url(const uint8_t * p_src, uint16_t src_len) BANKED {
+
+    EMU_PROFILE_BEGIN(" B64 stream prof start ");
+
+    const uint16_t out_len = base64_qr_url_begin(src_len);
+    if (out_len == 0u)
+        return 0;
+
+    qrcodegen_stream_append(url_base64_pngimage_prefix, url_base64_pngimage_prefix_sz);
+
+    while (src_len) {
+        uint16_t chunk_in_len = (src_len > B64_STREAM_CHUNK_IN_LEN) ? B64_STREAM_CHUNK_IN_LEN : src_len;
+
+        qrcodegen_stream_append(chunk_buf, base64_encode_url_format(chunk_buf, p_src, chunk_in_len));
+        p_src   += chunk_in_len;
+        src_len -= chunk_in_len;
+    }
+
+    EMU_PROFILE_END(" B64 stream prof end: ");
+
+    return out_len;
+}
+
+
+uint16_t base64_encode_url_part(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len, uint16_t url_offset, uint16_t max_len) BANKED {
+
+    uint8_t * p_dest_start = p_dest;
+
+    // Part of the prefix
+    if (url_offset < url_base64_pngimage_prefix_sz) {
+        uint16_t len = url_base64_pngimage_prefix_sz - url_offset;
+        if (len > max_len) len = max_len;
+        memcpy(p_dest, url_base64_pngimage_prefix + url_offset, len);
+        p_dest     += len;
+        max_len    -= len;
+        url_offset += len;
+    }
+
+    // Base64 gets encoded from the start of the unit the offset is in, skipping chars before it
+    url_offset -= url_base64_pngimage_prefix_sz;
+    uint16_t src_offset = (url_offset / BASE64_OUT_LEN) * BASE64_IN_LEN;
+    uint8_t  skip       = url_offset % BASE64_OUT_LEN;
+
+    while (max_len && (src_offset < src_len)) {
+        uint16_t chunk_in_len = ((src_len - src_offset) > B64_STREAM_CHUNK_IN_LEN) ? B64_STREAM_CHUNK_IN_LEN : (src_len - src_offset);
+
+        uint16_t len = base64_encode_url_format(chunk_buf, p_src + src_offset, chunk_in_len) - skip;
+        if (len > max_len) len = max_len;
+        memcpy(p_dest, chunk_buf + skip, len);
+        p_dest     += len;
+        max_len    -= len;
+        src_offset += chunk_in_len;
+        skip = 0u;
+    }
+
+    return (p_dest - p_dest_start);
+}
+
+
 // TODO: Fixed, easier to read, but slower -> PROFILE: 2E14
 //
 // TODO: OPTIMIZE: Not much luck trying to optimize the C implementation (they all get slower).
@@ -80,8 +162,6 @@ uint16_t base64_encode_to_url(uint8_t * p_dest, const uint8_t * p_src, uint16_t
 // Encodes URL style base64
 static uint16_t base64_encode_url_format(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len) {
 
-    EMU_PROFILE_BEGIN(" B64 prof start ");
-
     static uint16_t len_in;
     static uint8_t b1, b2, b3;
 
@@ -123,8 +203,6 @@ static uint16_t base64_encode_url_format(uint8_t * p_dest, const uint8_t * p_src
         case PAD_1_CHARS: *(p_dest - 1u) = PADDING_CHAR; // Overwrite 4th (of 4) previously encoded bytes with padding
     }
 
-    EMU_PROFILE_END(" B64 prof end: ");
-
     // Return length
     return (p_dest - p_dest_start);
 }
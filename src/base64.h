@@ -10,4 +10,17 @@
 
 uint16_t base64_encode_to_url(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len) BANKED;
 
+// Same url as base64_encode_to_url(), but streamed straight into the QR Code data bits
+// with qrcodegen_stream_begin() / qrcodegen_stream_append(), without a buffer for the url.
+// Call qrcodegen_stream_end() afterward. Returns url length, or 0 if it doesn't fit in a QR Code
+uint16_t base64_encode_to_qr_url(const uint8_t * p_src, uint16_t src_len) BANKED;
+
+// Just the qrcodegen_stream_begin() part of base64_encode_to_qr_url(), for appending the url
+// in pieces with base64_encode_url_part(). Returns url length, or 0 if it doesn't fit in a QR Code
+uint16_t base64_qr_url_begin(uint16_t src_len) BANKED;
+
+// Writes up to max_len chars of the url from url_offset onward (without a null terminator),
+// for splitting the url across several QR Codes. Returns the number of chars, 0 past the end
+uint16_t base64_encode_url_part(uint8_t * p_dest, const uint8_t * p_src, uint16_t src_len, uint16_t url_offset, uint16_t max_len) BANKED;
+
 #endif // BASE64_H
\ No newline at end of file
@@ -24,7 +24,6 @@ void app_state_reset(void) BANKED {
 
     app_state.undo_count        = DRAW_UNDO_COUNT_NONE;
     app_state.redo_count        = DRAW_REDO_COUNT_NONE;
-    app_state.next_undo_slot    = DRAW_UNDO_SLOT_DEFAULT;
 
     // UI related
     app_state.cursor_x = CURSOR_8U_TO_16U(DEVICE_SCREEN_PX_WIDTH / 2);
@@ -11,6 +11,7 @@
 #define UI_ACTION_BUTTON            (J_A)
 #define UI_CURSOR_SPEED_BUTTON      (J_B)
 #define UI_SHORTCUT_BUTTON          (J_SELECT)
+#define QR_PRINT_BUTTON             (J_SELECT)  // While a QR Code is shown
 
 #define DRAW_MAIN_BUTTON            (J_A)
 #define DRAW_CANCEL_BUTTON          (J_B)
@@ -49,15 +50,10 @@
 #define DRAW_SAVE_SLOT_COUNT   ((DRAW_SAVE_SLOT_MAX - DRAW_SAVE_SLOT_MIN) + 1u)
 #define DRAW_SAVE_SLOT_DEFAULT (DRAW_SAVE_SLOT_MIN)
 
-// Similar deal as Save slots, different Cart SRAM Bank
-#define DRAW_UNDO_SLOTS_PER_SRAM_BANK 3u // 3 slots per sram bank based on 0x2000 / (12 x 12 tiles x 16 bytes per tile)
-#define DRAW_UNDO_SRAM_NUM_BANKS      2u  // TODO: Could be expanded up to ~14 banks with a 128K cart for a deep undo queue
-
-#define DRAW_UNDO_SLOT_MIN     (DRAW_SAVE_SLOT_MIN)
-#define DRAW_UNDO_SLOT_MAX     ((DRAW_UNDO_SRAM_NUM_BANKS * DRAW_UNDO_SLOTS_PER_SRAM_BANK) - 1u) // NOTE: Spread across 2 SRAM banks!
-#define DRAW_UNDO_SLOT_COUNT   ((DRAW_UNDO_SLOT_MAX - DRAW_UNDO_SLOT_MIN) + 1u)
-#define DRAW_UNDO_SLOT_COUNT_USABLE   (DRAW_UNDO_SLOT_COUNT - 1u) // Usable undo count is reduced by 1 since redo adds 1 snapshot of "current" drawing image before undos
-#define DRAW_UNDO_SLOT_DEFAULT (DRAW_UNDO_SLOT_MIN)
+// Undo history uses 2 other Cart SRAM banks: a full copy of the drawing as of the last snapshot
+// plus a ring of XOR delta records of the tiles that changed between snapshots (see save_and_undo.c).
+// So the depth depends on how much each step changes, dozens of typical pencil strokes
+#define DRAW_UNDO_COUNT_MAX    255u  // Undo and redo counts are uint8_t
 #define DRAW_UNDO_COUNT_NONE   (0u)
 #define DRAW_REDO_COUNT_NONE   (0u)
 
@@ -73,7 +69,7 @@
 #define SRAM_BANK_2   2u
 #define SRAM_BANK_3   3u
 
-#define SRAM_BANK_CALC_BUFFER        (SRAM_BANK_0)  // Keep [PNG / Base64] Calc buffer in first SRAM bank so that image apps can detect it as PNG format
+#define SRAM_BANK_CALC_BUFFER        (SRAM_BANK_0)  // Keep PNG Calc buffer in first SRAM bank so that image apps can detect it as PNG format
 #define SRAM_BANK_DRAWING_SAVES      (SRAM_BANK_1)
 #define SRAM_BANK_UNDO_SNAPSHOTS_LO  (SRAM_BANK_2)
 #define SRAM_BANK_UNDO_SNAPSHOTS_HI  (SRAM_BANK_3)
@@ -106,8 +102,33 @@
 #define IMG_TILE_Y_END    ((IMG_Y_END) / TILE_SZ_PX)
 
 // SRAM used for working buffers
+// - 0xA000: PNG export (plus its compression staging area, < 4K), left as is for the .sav PNG
+// - 0xAB00: Drawing capture for the PNG export (1bpp rows, only changed tiles get read again)
+// - 0xB000: Flood fill shadow (0xB000) and span queue (0xB480), shared with (flood fill invalidates / overwrites them):
+//   - 0xB000: QR Code function pattern template cache
+//   - 0xB800: Url text of one QR Code in a multi QR Code export (the single QR Code export streams the url instead)
 #define SRAM_BASE_A000  0xA000u
 #define SRAM_UPPER_B000 0xB000u
+#define SRAM_UPPER_B000_SZ 0x1000u
+
+#define SRAM_DRAWING_CAPTURE    (SRAM_BASE_A000 + 0x0B00u)  // The PNG export + staging area ends before this
+#define SRAM_DRAWING_CAPTURE_SZ (IMG_WIDTH_TILES * IMG_HEIGHT_PX)
+
+#define SRAM_FLOOD_SHADOW       (SRAM_UPPER_B000)  // Drawing capture copy the flood fill works on
+#define SRAM_FLOOD_SHADOW_SZ    (SRAM_DRAWING_CAPTURE_SZ)
+#define SRAM_FLOOD_QUEUE        (SRAM_FLOOD_SHADOW + SRAM_FLOOD_SHADOW_SZ)
+#define SRAM_FLOOD_QUEUE_SZ     ((SRAM_UPPER_B000 + SRAM_UPPER_B000_SZ) - SRAM_FLOOD_QUEUE)
+
+#define SRAM_QR_TEMPLATE_CACHE    (SRAM_UPPER_B000)
+#define SRAM_QR_TEMPLATE_CACHE_SZ 0x0800u  // Version 31 needs 1447 bytes
+#define SRAM_QR_PART_TEXT         (SRAM_UPPER_B000 + SRAM_QR_TEMPLATE_CACHE_SZ)
+#define SRAM_QR_PART_TEXT_SZ      (SRAM_UPPER_B000_SZ - SRAM_QR_TEMPLATE_CACHE_SZ)
+
+// Game Boy Printer link speed probe results, in the last bytes of the drawing saves bank
+// (after the save slots and the profiler ring)
+#define SRAM_BANK_PRINTER_LINK  (SRAM_BANK_DRAWING_SAVES)
+#define SRAM_PRINTER_LINK_SZ    0x10u
+#define SRAM_PRINTER_LINK       (SRAM_BASE_A000 + 0x2000u - SRAM_PRINTER_LINK_SZ)
 
 #define APA_MODE_VRAM_START (_VRAM8000 + 0x100u)  // APA Mode starts at 0x8100, I guess leaving a couple tiles for sprites and such
 #define APA_MODE_VRAM_SZ    ((_SCRN0 - _VRAM8000) - 0x100u)
@@ -260,7 +281,6 @@ typedef struct app_state_t {
 
     uint8_t undo_count;
     uint8_t redo_count;
-    uint8_t next_undo_slot;
 
 
     // == Cursor ==
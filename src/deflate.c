@@ -0,0 +1,288 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>  // For memset()
+
+#include <gbdk/emu_debug.h>
+
+#include "common.h"
+#include "deflate.h"
+
+#pragma bank 255  // Autobanked
+
+// == Fixed Huffman DEFLATE encoder (RFC 1951, BTYPE=01) ==
+//
+// Tuned for small 1bpp line art images on the SM83:
+// - Uses the fixed Huffman code tables, so no code tables need to be built or stored in the output
+// - LZ77 match search is bounded to a few candidates per position instead of hash chains:
+//   - Most recent position with the same 3 byte hash (single entry per hash, no chains)
+//   - Distance 1 (runs of the same byte, i.e. blank areas)
+//   - Distance of one image scanline (vertically repeated areas)
+// - No lazy matching
+//
+// The whole input is kept available, so the window is the entire input (must be < 32K)
+
+
+#define DEFLATE_BLOCK_FINAL_FIXED_HUFFMAN  0x03u // BFINAL=1, BTYPE=01 (packed LSB first)
+#define DEFLATE_BLOCK_HEADER_BITS          3u
+
+#define DEFLATE_SYM_END_OF_BLOCK           256u
+#define DEFLATE_SYM_LEN_FIRST              257u
+
+#define DEFLATE_LEN_CODE_COUNT             29u
+#define DEFLATE_DIST_CODE_COUNT            30u
+#define DEFLATE_DIST_CODE_BITS             5u
+
+// Fixed Huffman literal/length code ranges (RFC 1951 3.2.6)
+//   Lit Value    Bits        Codes
+//   ---------    ----        -----
+//     0 - 143     8          00110000 through 10111111
+//   144 - 255     9          110010000 through 111111111
+//   256 - 279     7          0000000 through 0010111
+//   280 - 287     8          11000000 through 11000111
+#define FIXED_LIT_0_143_BASE               0x30u
+#define FIXED_LIT_144_255_BASE             0x190u
+#define FIXED_SYM_280_287_BASE             0xC0u
+
+#define HASH_POS_NONE                      0u  // Hash table stores (position + 1) so that 0 can mean empty
+
+
+static const uint16_t len_code_base[DEFLATE_LEN_CODE_COUNT] = {
+    3u, 4u, 5u, 6u, 7u, 8u, 9u, 10u, 11u, 13u, 15u, 17u, 19u, 23u, 27u, 31u,
+    35u, 43u, 51u, 59u, 67u, 83u, 99u, 115u, 131u, 163u, 195u, 227u, 258u };
+
+static const uint8_t len_code_extra_bits[DEFLATE_LEN_CODE_COUNT] = {
+    0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 1u, 1u, 1u, 1u, 2u, 2u, 2u, 2u,
+    3u, 3u, 3u, 3u, 4u, 4u, 4u, 4u, 5u, 5u, 5u, 5u, 0u };
+
+static const uint16_t dist_code_base[DEFLATE_DIST_CODE_COUNT] = {
+    1u, 2u, 3u, 4u, 5u, 7u, 9u, 13u, 17u, 25u, 33u, 49u, 65u, 97u, 129u, 193u,
+    257u, 385u, 513u, 769u, 1025u, 1537u, 2049u, 3073u, 4097u, 6145u, 8193u, 12289u, 16385u, 24577u };
+
+static const uint8_t dist_code_extra_bits[DEFLATE_DIST_CODE_COUNT] = {
+    0u, 0u, 0u, 0u, 1u, 1u, 2u, 2u, 3u, 3u, 4u, 4u, 5u, 5u, 6u, 6u,
+    7u, 7u, 8u, 8u, 9u, 9u, 10u, 10u, 11u, 11u, 12u, 12u, 13u, 13u };
+
+// Huffman codes are stored MSB first in the bitstream, everything else LSB first,
+// so the fixed codes get bit reversed before writing. Nibble table keeps it small.
+static const uint8_t reverse_nibble[16] = {
+    0x0u, 0x8u, 0x4u, 0xCu, 0x2u, 0xAu, 0x6u, 0xEu,
+    0x1u, 0x9u, 0x5u, 0xDu, 0x3u, 0xBu, 0x7u, 0xFu };
+
+#define REVERSE_8(b) ((uint8_t)((reverse_nibble[(b) & 0x0Fu] << 4) | reverse_nibble[(b) >> 4]))
+
+
+static uint16_t hash_head[DEFLATE_HASH_SZ];
+
+static uint8_t * p_out_start;
+static uint8_t * p_out_cur;
+static uint8_t * p_out_end;
+static bool      out_overflow;
+
+static uint16_t bit_buf;    // Pending output bits, LSB first
+static uint8_t  bit_count;  // Always < 8 between calls to put_bits()
+
+// Input being encoded, see deflate_fixed_begin()
+static const uint8_t * p_in_start;
+static uint16_t        in_size;
+static uint16_t        in_pos;
+static uint16_t        in_row_stride;
+
+// Encoding a position can read this far past it (longest match, then the hash of its last position)
+#define DEFLATE_STEP_LOOKAHEAD  (DEFLATE_MATCH_LEN_MAX + DEFLATE_MATCH_LEN_MIN)
+
+
+static void put_bits_8(uint8_t value, uint8_t count);
+static void put_bits(uint16_t value, uint8_t count);
+static void put_huff(uint16_t code, uint8_t code_len);
+static void put_literal(uint8_t value);
+static void put_match(uint16_t length, uint16_t distance);
+static uint16_t match_length(const uint8_t * p_cur, const uint8_t * p_prev, uint16_t len_max);
+
+
+
+// Writes up to 8 bits, LSB first
+static void put_bits_8(uint8_t value, uint8_t count) {
+
+    bit_buf |= (uint16_t)value << bit_count;
+    bit_count += count;
+
+    if (bit_count >= 8u) {
+        if (p_out_cur < p_out_end) *p_out_cur++ = (uint8_t)bit_buf;
+        else out_overflow = true;
+
+        bit_buf >>= 8;
+        bit_count -= 8u;
+    }
+}
+
+
+// Writes up to 16 bits, LSB first
+static void put_bits(uint16_t value, uint8_t count) {
+
+    // Keep the bit buffer within 16 bits by splitting larger writes
+    if (count > 8u) {
+        put_bits_8((uint8_t)value, 8u);
+        value >>= 8;
+        count -= 8u;
+    }
+    put_bits_8((uint8_t)value, count);
+}
+
+
+// Writes a Huffman code of up to 9 bits (stored MSB first)
+static void put_huff(uint16_t code, uint8_t code_len) {
+
+    uint16_t reversed;
+    if (code_len > 8u)
+        reversed = ((uint16_t)REVERSE_8((uint8_t)code) << 1) | (code >> 8);
+    else
+        reversed = REVERSE_8((uint8_t)code) >> (8u - code_len);
+
+    put_bits(reversed, code_len);
+}
+
+
+static void put_literal(uint8_t value) {
+
+    if (value < 144u) put_huff(FIXED_LIT_0_143_BASE + value, 8u);
+    else              put_huff(FIXED_LIT_144_255_BASE + (value - 144u), 9u);
+}
+
+
+static void put_match(uint16_t length, uint16_t distance) {
+
+    // Length: symbols 257 - 285 plus extra bits
+    uint8_t code = DEFLATE_LEN_CODE_COUNT - 1u;
+    while (len_code_base[code] > length) code--;
+
+    uint16_t sym = DEFLATE_SYM_LEN_FIRST + code;
+    if (sym < 280u) put_huff(sym - DEFLATE_SYM_END_OF_BLOCK, 7u);
+    else            put_huff(FIXED_SYM_280_287_BASE + (sym - 280u), 8u);
+
+    if (len_code_extra_bits[code])
+        put_bits(length - len_code_base[code], len_code_extra_bits[code]);
+
+    // Distance: fixed 5 bit codes plus extra bits
+    code = DEFLATE_DIST_CODE_COUNT - 1u;
+    while (dist_code_base[code] > distance) code--;
+
+    put_huff(code, DEFLATE_DIST_CODE_BITS);
+
+    if (dist_code_extra_bits[code])
+        put_bits(distance - dist_code_base[code], dist_code_extra_bits[code]);
+}
+
+
+// Counts matching bytes. p_prev may overlap p_cur (i.e. distance < length), which is valid for LZ77
+static uint16_t match_length(const uint8_t * p_cur, const uint8_t * p_prev, uint16_t len_max) {
+
+    uint16_t len = 0u;
+    while ((len < len_max) && (*p_cur++ == *p_prev++)) len++;
+    return len;
+}
+
+
+bool deflate_fixed_begin(uint8_t * p_out, uint16_t out_max_len, const uint8_t * p_in, uint16_t in_len, uint16_t row_stride) BANKED {
+
+    if (in_len >= DEFLATE_WINDOW_SZ_MAX) return false;
+
+    p_out_start  = p_out;
+    p_out_cur    = p_out;
+    p_out_end    = p_out + out_max_len;
+    out_overflow = false;
+    bit_buf      = 0u;
+    bit_count    = 0u;
+
+    p_in_start    = p_in;
+    in_size       = in_len;
+    in_pos        = 0u;
+    in_row_stride = row_stride;
+
+    memset(hash_head, HASH_POS_NONE, sizeof(hash_head));
+
+    put_bits(DEFLATE_BLOCK_FINAL_FIXED_HUFFMAN, DEFLATE_BLOCK_HEADER_BITS);
+    return true;
+}
+
+
+void deflate_fixed_step(uint16_t avail_len) BANKED {
+
+    // Only positions whose matches can't reach past the available input, so the
+    // output is the same as if all of it had been there from the start
+    uint16_t pos_end = in_size;
+    if (avail_len < in_size)
+        pos_end = (avail_len > DEFLATE_STEP_LOOKAHEAD) ? (avail_len - DEFLATE_STEP_LOOKAHEAD) : 0u;
+
+    const uint8_t * p_in       = p_in_start;
+    const uint16_t  in_len     = in_size;
+    const uint16_t  row_stride = in_row_stride;
+    uint16_t        pos        = in_pos;
+
+    while ((pos < pos_end) && !out_overflow) {
+
+        uint16_t best_len  = 0u;
+        uint16_t best_dist = 0u;
+        uint16_t len_max   = in_len - pos;
+
+        if (len_max >= DEFLATE_MATCH_LEN_MIN) {
+            if (len_max > DEFLATE_MATCH_LEN_MAX) len_max = DEFLATE_MATCH_LEN_MAX;
+
+            const uint8_t * p_cur = p_in + pos;
+            uint8_t hash = (uint8_t)((p_cur[0] << 4) ^ (p_cur[1] << 2) ^ p_cur[2]);
+
+            // Candidate distances, cheapest and most likely for line art first
+            uint16_t candidates[3];
+            candidates[0] = 1u;
+            candidates[1] = row_stride;
+            candidates[2] = (hash_head[hash] != HASH_POS_NONE) ? (pos - (hash_head[hash] - 1u)) : 0u;
+            hash_head[hash] = pos + 1u;
+
+            for (uint8_t c = 0u; c < ARRAY_LEN(candidates); c++) {
+                uint16_t dist = candidates[c];
+                if ((dist == 0u) || (dist > pos) || (dist == best_dist)) continue;
+
+                uint16_t len = match_length(p_cur, p_cur - dist, len_max);
+                if (len > best_len) {
+                    best_len  = len;
+                    best_dist = dist;
+                    if (len == len_max) break;
+                }
+            }
+        }
+
+        if (best_len >= DEFLATE_MATCH_LEN_MIN) {
+            put_match(best_len, best_dist);
+
+            // Record hashes for the positions covered by the match so later data can refer to them
+            uint16_t match_end = pos + best_len;
+            pos++;
+            while ((pos < match_end) && ((pos + (DEFLATE_MATCH_LEN_MIN - 1u)) < in_len)) {
+                const uint8_t * p_cur = p_in + pos;
+                hash_head[(uint8_t)((p_cur[0] << 4) ^ (p_cur[1] << 2) ^ p_cur[2])] = pos + 1u;
+                pos++;
+            }
+            pos = match_end;
+        } else {
+            put_literal(p_in[pos]);
+            pos++;
+        }
+    }
+    in_pos = pos;
+}
+
+
+uint16_t deflate_fixed_end(void) BANKED {
+
+    EMU_PROFILE_BEGIN(" DEFLATE prof start ");
+    deflate_fixed_step(in_size);
+    EMU_PROFILE_END(" DEFLATE prof end: ");
+
+    // End of block symbol (256 -> 7 bit code 0000000) then flush any remaining partial byte
+    put_huff(0u, 7u);
+    if (bit_count) put_bits(0u, 8u - bit_count);
+
+    if (out_overflow) return 0u;
+    else return (p_out_cur - p_out_start);
+}
+
@@ -0,0 +1,31 @@
+#ifndef DEFLATE_H
+#define DEFLATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define DEFLATE_MATCH_LEN_MIN    3u
+#define DEFLATE_MATCH_LEN_MAX  258u
+#define DEFLATE_WINDOW_SZ_MAX  32768u  // Max back reference distance allowed by DEFLATE
+
+// Hash of the next 3 input bytes -> most recent input position with that hash
+#define DEFLATE_HASH_BITS        8u
+#define DEFLATE_HASH_SZ          (1u << DEFLATE_HASH_BITS)
+
+
+// Encodes p_in as a single final Fixed Huffman DEFLATE block (RFC 1951 BTYPE=01) into p_out.
+// The input can be added to while it gets encoded, so the work can be spread out:
+// - deflate_fixed_begin(): in_len is the final input size. Returns false if it's too large
+//   - in_len:      Must be less than DEFLATE_WINDOW_SZ_MAX so every previous byte can be referenced
+//   - row_stride:  Size of an image scanline in bytes, used as an extra match candidate (0 to disable)
+//   - out_max_len: If the encoded data won't fit in this many bytes encoding is abandoned
+// - deflate_fixed_step():  encodes as much as it can of the first avail_len input bytes (the rest may not be there yet)
+// - deflate_fixed_end():   once all of the input is there, encodes the rest. Returns the size of the encoded
+//                          DEFLATE data, or 0 if it didn't fit in out_max_len
+//
+// The output is the same however the input was split up.
+bool deflate_fixed_begin(uint8_t * p_out, uint16_t out_max_len, const uint8_t * p_in, uint16_t in_len, uint16_t row_stride) BANKED;
+void deflate_fixed_step(uint16_t avail_len) BANKED;
+uint16_t deflate_fixed_end(void) BANKED;
+
+#endif // DEFLATE_H
@@ -12,6 +12,9 @@
 
 #include "save_and_undo.h"
 #include "ui_main.h"
+#include "draw.h"
+#include "qrcodegen.h"
+#include "img_2_qrcode.h"
 
 #include <gbdk/emu_debug.h>  // Sensitive to duplicated line position across source files
 
@@ -53,18 +56,83 @@ static void draw_tool_rect_finalize_last_preview(void);
 static void draw_tool_circle_finalize_last_preview(void);
 
 static bool flood_queue_push(int8_t x1, int8_t x2, int8_t y1, int8_t y2);
-static bool flood_check_fillable(uint8_t x, uint8_t y);
 
 static uint8_t  tool_start_x, tool_start_y;
 static bool     tool_undo_snapshot_taken = false;
 static bool     tool_started_with_speed_button = false;
 
 // For Flood-fill
-static int8_t * p_flood_queue = (int8_t *)SRAM_UPPER_B000; // Flood-fill Queue temp buffer is in SRAM shared with other uses
+// The shadow fill's queue goes after the shadow. It can be smaller since dropped spans get filled anyway
+#if (FLOOD_FILL_SHADOW)
+    #define FLOOD_QUEUE_ADDR (SRAM_FLOOD_QUEUE)
+    #define FLOOD_QUEUE_SZ   (SRAM_FLOOD_QUEUE_SZ)
+#else
+    #define FLOOD_QUEUE_ADDR (SRAM_UPPER_B000)
+    #define FLOOD_QUEUE_SZ   (SRAM_UPPER_B000_SZ)
+#endif
+static int8_t * p_flood_queue = (int8_t *)FLOOD_QUEUE_ADDR; // Flood-fill Queue temp buffer is in SRAM shared with other uses
 static uint16_t flood_queue_count = 0u;
 #define FLOOD_QUEUE_ENTRY_SIZE 4u  // Four bytes per flood-fill queue entry
 #define FILL_OUT_OF_MEMORY false
 
+// Dirty tile tracking, see draw.h
+uint16_t draw_dirty_rows[DRAW_DIRTY_COUNT][IMG_HEIGHT_TILES];
+
+// Pixels a tool may draw past its reference points (width 2 and 3 brushes, offset lines and rects)
+#define DIRTY_BRUSH_MARGIN 2u
+
+
+
+void drawing_dirty_mark_all(void) BANKED {
+
+    for (uint8_t consumer = 0u; consumer < DRAW_DIRTY_COUNT; consumer++)
+        for (uint8_t ty = 0u; ty < IMG_HEIGHT_TILES; ty++)
+            draw_dirty_rows[consumer][ty] = DRAW_DIRTY_ROW_ALL;
+}
+
+
+void drawing_dirty_clear(uint8_t consumer) BANKED {
+
+    for (uint8_t ty = 0u; ty < IMG_HEIGHT_TILES; ty++)
+        draw_dirty_rows[consumer][ty] = 0u;
+}
+
+
+// Converts a pixel coordinate to a drawing area tile, clipped to the drawing area
+static uint8_t dirty_tile_x(int16_t x) {
+    if (x < (int16_t)IMG_X_START) x = IMG_X_START;
+    if (x > (int16_t)IMG_X_END)   x = IMG_X_END;
+    return (uint8_t)((x - IMG_X_START) / TILE_SZ_PX);
+}
+
+static uint8_t dirty_tile_y(int16_t y) {
+    if (y < (int16_t)IMG_Y_START) y = IMG_Y_START;
+    if (y > (int16_t)IMG_Y_END)   y = IMG_Y_END;
+    return (uint8_t)((y - IMG_Y_START) / TILE_SZ_PX);
+}
+
+
+// Marks the tiles in the box around two pixel points (either order), grown by margin pixels
+static void drawing_dirty_mark(uint8_t x1, uint8_t y1, uint8_t x2, uint8_t y2, uint8_t margin) {
+
+    if (x1 > x2) { uint8_t t = x1; x1 = x2; x2 = t; }
+    if (y1 > y2) { uint8_t t = y1; y1 = y2; y2 = t; }
+
+    uint8_t tx1 = dirty_tile_x((int16_t)x1 - margin);
+    uint8_t tx2 = dirty_tile_x((int16_t)x2 + margin);
+    uint8_t ty1 = dirty_tile_y((int16_t)y1 - margin);
+    uint8_t ty2 = dirty_tile_y((int16_t)y2 + margin);
+
+    uint16_t mask = (uint16_t)((2u << tx2) - 1u) & (uint16_t)~((1u << tx1) - 1u);
+
+    for (uint8_t ty = ty1; ty <= ty2; ty++) {
+        // Copy on write for a lazy undo snapshot, so this has to be called before drawing over the tiles
+        if (undo_lazy_rows[ty] & mask) drawing_undo_lazy_copy(ty, mask);
+
+        for (uint8_t consumer = 0u; consumer < DRAW_DIRTY_COUNT; consumer++)
+            draw_dirty_rows[consumer][ty] |= mask;
+    }
+}
 
 
 // Foreground drawing colors (border and fill the same)
@@ -99,6 +167,7 @@ void drawing_clear(void) BANKED {
     // Fill active image area in white
     drawing_set_to_alt_colors();
     box(IMG_X_START, IMG_Y_START, IMG_X_END, IMG_Y_END, M_FILL);
+    drawing_dirty_mark_all();
 
     drawing_set_to_main_colors();
 }
@@ -159,6 +228,7 @@ void draw_tools_cancel_and_reset(void) BANKED {
     app_state.draw_tool_using_b_button_action = false;
     app_state.tool_currently_drawing = false;
     tool_undo_snapshot_taken = false;
+    drawing_undo_lazy_commit();
 
     drawing_set_to_main_colors();
 }
@@ -221,7 +291,7 @@ static void draw_tool_pencil(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
     if (KEY_TICKED(DRAW_MAIN_BUTTON)) {
         // Take a undo snapshot only at the start of a drawing segment
         if (tool_undo_snapshot_taken == false) {
-            drawing_take_undo_snapshot();
+            drawing_take_undo_snapshot_lazy();
             tool_undo_snapshot_taken = true;
             tool_start_x = cursor_8u_x;
             tool_start_y = cursor_8u_y;
@@ -232,11 +302,13 @@ static void draw_tool_pencil(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
         // End Drawing
         tool_undo_snapshot_taken = false;
         app_state.tool_currently_drawing = false;
+        drawing_undo_lazy_commit();
     }
 
     // Draw if active
     if (app_state.tool_currently_drawing) {
         bool new_cursor_pos = ((cursor_8u_x != tool_start_x) || (cursor_8u_y != tool_start_y));
+        drawing_dirty_mark(tool_start_x, tool_start_y, cursor_8u_x, cursor_8u_y, DIRTY_BRUSH_MARGIN);
 
         // If cursor speed button pressed or using mouse, movement may be more than 1 pixel
         // So draw line instead to fill any pixel gaps.
@@ -334,6 +406,8 @@ static void draw_tool_line_width_2_and_3(uint8_t cursor_8u_x, uint8_t cursor_8u_
 
 
 static void draw_tool_line_finalize_last_preview(void) {
+    drawing_dirty_mark(tool_start_x, tool_start_y, app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y, DIRTY_BRUSH_MARGIN);
+
     // Undraw last preview
     // Don't draw (for preview) lines that start and end on the same pixel
     if ((tool_start_x != app_state.draw_cursor_8u_last_x) || (tool_start_y != app_state.draw_cursor_8u_last_y)) {
@@ -393,6 +467,8 @@ static void draw_tool_line(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
         //
         // But only if the cursor moved (so it remains visible), it's being canceled, or being finalized (to take a clean undo snapshot)
         if (current_action != DRAW_ACTION_IDLE) {
+            drawing_dirty_mark(tool_start_x, tool_start_y, app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y, DIRTY_BRUSH_MARGIN);
+            drawing_dirty_mark(tool_start_x, tool_start_y, cursor_8u_x, cursor_8u_y, DIRTY_BRUSH_MARGIN);
             // Don't draw (for preview) lines that start and end on the same pixel
             if ((tool_start_x != app_state.draw_cursor_8u_last_x) || (tool_start_y != app_state.draw_cursor_8u_last_y)) {
                 color(BLACK,WHITE,XOR);
@@ -520,6 +596,8 @@ static void draw_tool_rect_width_2_and_3(uint8_t cursor_8u_x, uint8_t cursor_8u_
 
 // Used for when a tool is canceled and there is an active preview pending
 static void draw_tool_rect_finalize_last_preview(void) {
+    drawing_dirty_mark(tool_start_x, tool_start_y, app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y, DIRTY_BRUSH_MARGIN);
+
     // Undraw last preview
     color(BLACK,WHITE,XOR);
     box(tool_start_x, tool_start_y, app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y, M_NOFILL);
@@ -551,6 +629,7 @@ static void draw_tool_rect(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
             tool_start_x = cursor_8u_x;
             tool_start_y = cursor_8u_y;
             // Draw the first rect(1 pixel) XOR style so it can be undrawn
+            drawing_dirty_mark(tool_start_x, tool_start_y, tool_start_x, tool_start_y, 0u);
             color(BLACK,WHITE,XOR);
             box(tool_start_x, tool_start_y, cursor_8u_x, cursor_8u_y, M_NOFILL);
 
@@ -578,6 +657,8 @@ static void draw_tool_rect(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
         // Un-draw from the last frame (XOR)
         // But only if the cursor moved (so it remains visible), it's being canceled, or being finalized (to take a clean undo snapshot)
         if (current_action != DRAW_ACTION_IDLE) {
+            drawing_dirty_mark(tool_start_x, tool_start_y, app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y, DIRTY_BRUSH_MARGIN);
+            drawing_dirty_mark(tool_start_x, tool_start_y, cursor_8u_x, cursor_8u_y, DIRTY_BRUSH_MARGIN);
             color(BLACK,WHITE,XOR);
             box(tool_start_x, tool_start_y, app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y, M_NOFILL);
         }
@@ -714,7 +795,16 @@ static void draw_tool_rect_circle_2_and_3(uint8_t cursor_8u_x, uint8_t cursor_8u
 }
 
 
+// Circles reach radius (+1 for the wider widths) pixels around the start point
+static void draw_tool_circle_dirty_mark(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
+    uint8_t radius = get_radius(cursor_8u_x, cursor_8u_y) + DIRTY_BRUSH_MARGIN;
+    drawing_dirty_mark(tool_start_x, tool_start_y, tool_start_x, tool_start_y, radius);
+}
+
+
 static void draw_tool_circle_finalize_last_preview(void) {
+    draw_tool_circle_dirty_mark(app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y);
+
     // Undraw last preview
     color(BLACK,WHITE,XOR);
     circle(tool_start_x, tool_start_y, get_radius(app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y), M_NOFILL);
@@ -745,6 +835,7 @@ static void draw_tool_circle(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
                 tool_start_x = cursor_8u_x;
                 tool_start_y = cursor_8u_y;
                 // Draw the first XOR style so it can be undrawn
+                draw_tool_circle_dirty_mark(cursor_8u_x, cursor_8u_y);
                 color(BLACK,WHITE,XOR);
                 circle(tool_start_x, tool_start_y, get_radius(cursor_8u_x, cursor_8u_y), M_NOFILL);
 
@@ -773,6 +864,8 @@ static void draw_tool_circle(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
         // Un-draw from the last frame (XOR)
         // But only if the cursor moved (so it remains visible), it's being canceled, or being finalized (to take a clean undo snapshot)
         if (current_action != DRAW_ACTION_IDLE) {
+            draw_tool_circle_dirty_mark(app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y);
+            draw_tool_circle_dirty_mark(cursor_8u_x, cursor_8u_y);
             color(BLACK,WHITE,XOR);
             circle(tool_start_x, tool_start_y, get_radius(app_state.draw_cursor_8u_last_x, app_state.draw_cursor_8u_last_y), M_NOFILL);
         }
@@ -812,7 +905,7 @@ static void draw_tool_eraser(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
     if (KEY_TICKED(DRAW_MAIN_BUTTON)) {
         // Take a undo snapshot only at the start of a drawing segment
         if (tool_undo_snapshot_taken == false) {
-            drawing_take_undo_snapshot();
+            drawing_take_undo_snapshot_lazy();
             tool_undo_snapshot_taken = true;
         }
         app_state.tool_currently_drawing = true;
@@ -821,6 +914,7 @@ static void draw_tool_eraser(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
         // End Drawing
         tool_undo_snapshot_taken = false;
         app_state.tool_currently_drawing = false;
+        drawing_undo_lazy_commit();
     }
 
     // Draw if active
@@ -831,6 +925,7 @@ static void draw_tool_eraser(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
         if (end_x > IMG_X_END) end_x = IMG_X_END;
         if (end_y > IMG_Y_END) end_y = IMG_Y_END;
 
+        drawing_dirty_mark(cursor_8u_x, cursor_8u_y, end_x, end_y, 0u);
         drawing_set_to_alt_colors();
         box(cursor_8u_x, cursor_8u_y, end_x, end_y, M_FILL);
     }
@@ -841,7 +936,7 @@ static void draw_tool_eraser(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
 static bool flood_queue_push(int8_t x1, int8_t x2, int8_t y1, int8_t y2) {
 
    // Bail if over memory limit
-    if (flood_queue_count >= 0x1000u) {
+    if (flood_queue_count >= FLOOD_QUEUE_SZ) {
         return FILL_OUT_OF_MEMORY;
     }
 
@@ -856,6 +951,10 @@ static bool flood_queue_push(int8_t x1, int8_t x2, int8_t y1, int8_t y2) {
 }
 
 
+#if (FLOOD_FILL_SHADOW == 0)
+// Flood-fill bounding box of the plotted pixels, for dirty tile marking
+static uint8_t flood_min_x, flood_max_x, flood_min_y, flood_max_y;
+
 static bool flood_check_fillable(uint8_t x, uint8_t y) {
 
     // EMU_printf(" Check: %hu, %hu\n", (uint8_t)x, (uint8_t)y);
@@ -866,71 +965,338 @@ static bool flood_check_fillable(uint8_t x, uint8_t y) {
     return false;
 }
 
+// Widens the flood-fill bounding box to include a span of pixels on one row
+static void flood_bounds_add(uint8_t x1, uint8_t x2, uint8_t y) {
+    if (x1 < flood_min_x) flood_min_x = x1;
+    if (x2 > flood_max_x) flood_max_x = x2;
+    if (y  < flood_min_y) flood_min_y = y;
+    if (y  > flood_max_y) flood_max_y = y;
+}
+
+
 // A lot of the time this spends is waiting for safe VRAM access (get/set pixel).
 // Could turn the screen off to be faster, but it's a lot more fun to watch.
-// Could also copy VRAM to SRAM and work off that, but it's ok enough as is.
+// (FLOOD_FILL_SHADOW works off an SRAM copy instead)
 //
 // "Combined-scan-and-fill span filler" per Wikipedia
 // Heckbert, Paul S (1990). "IV.10: A Seed Fill Algorithm"
-static void draw_tool_floodfill(uint8_t x, uint8_t y) {
+static void floodfill_run(uint8_t x, uint8_t y) {
 
-    if (KEY_TICKED(DRAW_MAIN_BUTTON)) {
+    if (flood_check_fillable(x,y) == false) return;
+    flood_queue_count = 0u;
+    // queue_fill_max = 0u;
 
-        drawing_take_undo_snapshot();
+    flood_queue_push(x, x, y,      1);
+    flood_queue_push(x, x, y - 1, -1);
 
-        drawing_set_to_main_colors();
+    while (flood_queue_count >= FLOOD_QUEUE_ENTRY_SIZE) {
 
-        // EMU_printf("Start: %hu, %hu\n", (uint8_t)x, (uint8_t)y);
+        // Pop an entry from the queue
+        uint8_t dy = p_flood_queue[--flood_queue_count]; // Last entry in is first out since it was last in (queue is LIFO)
+        uint8_t y  = p_flood_queue[--flood_queue_count];
+        uint8_t x2 = p_flood_queue[--flood_queue_count];
+        uint8_t x1 = p_flood_queue[--flood_queue_count];
 
-        // Fill queue temp buffer is in SRAM
-        PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER);
+        uint8_t x = x1;
+        if (flood_check_fillable(x, y)) {
+            while (flood_check_fillable(x - 1, y)) {
+                plot_point(x - 1, y);
+                x = x - 1;
+            }
+            if (x < x1) {
+                flood_bounds_add(x, x1 - 1, y);
+                if (flood_queue_push(x, x1 - 1, y - dy, -dy) == FILL_OUT_OF_MEMORY) return;
+            }
+        }
+
+        while (x1 <= x2) {
+
+            uint8_t x_st = x1;
+            uint8_t x_end = 0;
+            while (flood_check_fillable(x1, y)) {
+                x_end = x1; // plot_point(x1, y);
+                x1 = x1 + 1;
+            }
+            // Speed up horizontal runs (tested in the above loop)
+            // by drawing them as a line instead of as a pixel
+            if (x_end) {
+                line(x_st, y, x_end, y);
+                flood_bounds_add(x_st, x_end, y);
+            }
+
+            if (x1     >  x) if (flood_queue_push(x, x1 - 1, y + dy, dy) == FILL_OUT_OF_MEMORY) return;
+            if (x1 - 1 > x2) if (flood_queue_push(x2 + 1, x1 - 1, y - dy, -dy) == FILL_OUT_OF_MEMORY) return;
+            x1 = x1 + 1;
+            while ((x1 <= x2) && (flood_check_fillable(x1, y) == false)) {
+                x1 = x1 + 1;
+            }
+            x = x1;
+        }
+    }
+   // EMU_printf("Fill Queue Max Depth = %u\n", (uint16_t)queue_fill_max);
+}
+#endif
+
+
+#if (FLOOD_FILL_SHADOW)
+// ===== Flood fill on an SRAM shadow =====
+//
+// The shadow is a copy of the drawing capture (1bpp rows, MSB = left pixel, see img_2_qrcode.c)
+// in image coordinates. Spans are scanned and filled a byte (8 pixels) at a time using
+// leading/trailing zero lookups, then the tiles which differ from the capture get
+// copied back to VRAM, and the capture takes on the result.
+
+#define FLOOD_ROW_SZ    (IMG_WIDTH_TILES)
+#define FLOOD_SHADOW    ((uint8_t *)SRAM_FLOOD_SHADOW)
+#define FLOOD_CAPTURE   ((const uint8_t *)SRAM_DRAWING_CAPTURE)
+
+// Leading (from MSB) and trailing zero bits of a nibble
+static const uint8_t flood_clz4[16] = { 4u, 3u, 2u, 2u, 1u, 1u, 1u, 1u, 0u, 0u, 0u, 0u, 0u, 0u, 0u, 0u };
+static const uint8_t flood_ctz4[16] = { 4u, 0u, 1u, 0u, 2u, 0u, 1u, 0u, 3u, 0u, 1u, 0u, 2u, 0u, 1u, 0u };
+
+static uint8_t flood_fillable_xor;  // Shadow byte ^ this = bits of fillable (background color) pixels
+static uint8_t flood_fill_set;      // Filling sets bits (main color black) or clears them
+static bool    flood_overflow;
+
+static inline uint8_t flood_clz8(uint8_t b) {
+    return (b & 0xF0u) ? flood_clz4[b >> 4] : (4u + flood_clz4[b]);
+}
+
+static inline uint8_t flood_ctz8(uint8_t b) {
+    return (b & 0x0Fu) ? flood_ctz4[b & 0x0Fu] : (4u + flood_ctz4[b >> 4]);
+}
+
+static inline uint8_t flood_fillable_bits(const uint8_t * p_row, uint8_t col) {
+    return p_row[col] ^ flood_fillable_xor;
+}
+
+
+static bool flood_shadow_fillable(uint8_t x, uint8_t y) {
+    if ((x >= IMG_WIDTH_PX) || (y >= IMG_HEIGHT_PX)) return false;
+    return (flood_fillable_bits(FLOOD_SHADOW + (y * FLOOD_ROW_SZ), x >> 3) & (0x80u >> (x & 0x07u)));
+}
+
+
+// Start of the fillable run that fillable pixel x is part of
+static uint8_t flood_span_left(const uint8_t * p_row, uint8_t x) {
+
+    uint8_t col = x >> 3;
+    uint8_t blocked = ~flood_fillable_bits(p_row, col) & (uint8_t)~(0xFFu >> (x & 0x07u));  // Pixels left of x in its byte
+
+    while (blocked == 0u) {
+        if (col == 0u) return 0u;
+        blocked = ~flood_fillable_bits(p_row, --col);
+    }
+    return (col * 8u) + (8u - flood_ctz8(blocked));
+}
+
+
+// End of the fillable run that fillable pixel x is part of
+static uint8_t flood_span_right(const uint8_t * p_row, uint8_t x) {
+
+    uint8_t col = x >> 3;
+    uint8_t blocked = ~flood_fillable_bits(p_row, col) & (uint8_t)(0x7Fu >> (x & 0x07u));  // Pixels right of x in its byte
+
+    while (blocked == 0u) {
+        if (++col == FLOOD_ROW_SZ) return IMG_WIDTH_PX - 1u;
+        blocked = ~flood_fillable_bits(p_row, col);
+    }
+    return (col * 8u) + flood_clz8(blocked) - 1u;
+}
+
+
+// First fillable pixel from x to x_end, or x_end + 1 if none
+static uint8_t flood_span_next(const uint8_t * p_row, uint8_t x, uint8_t x_end) {
+
+    if (x > x_end) return x;
+    uint8_t col = x >> 3;
+    uint8_t fillable = flood_fillable_bits(p_row, col) & (uint8_t)(0xFFu >> (x & 0x07u));
+
+    while (fillable == 0u) {
+        if ((++col * 8u) > x_end) return x_end + 1u;
+        fillable = flood_fillable_bits(p_row, col);
+    }
+    x = (col * 8u) + flood_clz8(fillable);
+    return (x > x_end) ? (x_end + 1u) : x;
+}
+
+
+static void flood_span_fill(uint8_t * p_row, uint8_t x1, uint8_t x2) {
+
+    uint8_t col     = x1 >> 3;
+    uint8_t col_end = x2 >> 3;
+    uint8_t mask    = 0xFFu >> (x1 & 0x07u);
+
+    for (; col <= col_end; col++) {
+        if (col == col_end) mask &= (uint8_t)(0xFF00u >> ((x2 & 0x07u) + 1u));
+        if (flood_fill_set) p_row[col] |= mask;
+        else                p_row[col] &= ~mask;
+        mask = 0xFFu;
+    }
+}
 
-        if (flood_check_fillable(x,y) == false) return;
-        flood_queue_count = 0u;
-        // queue_fill_max = 0u;
 
-        flood_queue_push(x, x, y,      1);
-        flood_queue_push(x, x, y - 1, -1);
+static void flood_shadow_push(uint8_t x1, uint8_t x2, uint8_t y, int8_t dy) {
+    // A full queue drops the span, the rescan in floodfill_shadow() picks it back up
+    if (flood_queue_push(x1, x2, y, dy) == FILL_OUT_OF_MEMORY) flood_overflow = true;
+}
+
+
+// Same span filler as floodfill_run(), but on whole spans of the shadow at a time
+static void floodfill_shadow_run(uint8_t x, uint8_t y) {
+
+    if (flood_shadow_fillable(x,y) == false) return;
+
+    flood_shadow_push(x, x, y,      1);
+    flood_shadow_push(x, x, y - 1, -1);
 
-        while (flood_queue_count >= FLOOD_QUEUE_ENTRY_SIZE) {
+    while (flood_queue_count >= FLOOD_QUEUE_ENTRY_SIZE) {
 
-            // Pop an entry from the queue
-            uint8_t dy = p_flood_queue[--flood_queue_count]; // Last entry in is first out since it was last in (queue is LIFO)
-            uint8_t y  = p_flood_queue[--flood_queue_count];
-            uint8_t x2 = p_flood_queue[--flood_queue_count];
-            uint8_t x1 = p_flood_queue[--flood_queue_count];
+        // Pop an entry from the queue
+        int8_t  dy = p_flood_queue[--flood_queue_count]; // Last entry in is first out since it was last in (queue is LIFO)
+        uint8_t y  = p_flood_queue[--flood_queue_count];
+        uint8_t x2 = p_flood_queue[--flood_queue_count];
+        uint8_t x1 = p_flood_queue[--flood_queue_count];
 
-            uint8_t x = x1;
-            if (flood_check_fillable(x, y)) {
-                while (flood_check_fillable(x - 1, y)) {
-                    plot_point(x - 1, y);
-                    x = x - 1;
-                }
-                if (x < x1) if (flood_queue_push(x, x1 - 1, y - dy, -dy) == FILL_OUT_OF_MEMORY) return;
+        if (y >= IMG_HEIGHT_PX) continue;
+        uint8_t * p_row = FLOOD_SHADOW + (y * FLOOD_ROW_SZ);
+
+        uint8_t x = x1;
+        if (flood_shadow_fillable(x, y)) {
+            x = flood_span_left(p_row, x1);
+            if (x < x1) {
+                flood_span_fill(p_row, x, x1 - 1u);
+                flood_shadow_push(x, x1 - 1u, y - dy, -dy);
             }
+        }
 
-            while (x1 <= x2) {
+        while (x1 <= x2) {
 
-                uint8_t x_st = x1;
-                uint8_t x_end = 0;
-                while (flood_check_fillable(x1, y)) {
-                    x_end = x1; // plot_point(x1, y);
-                    x1 = x1 + 1;
-                }
-                // Speed up horizontal runs (tested in the above loop)
-                // by drawing them as a line instead of as a pixel
-                if (x_end) line(x_st, y, x_end, y);
+            if (flood_shadow_fillable(x1, y)) {
+                uint8_t x_end = flood_span_right(p_row, x1);
+                flood_span_fill(p_row, x1, x_end);
+                x1 = x_end + 1u;
+            }
 
-                if (x1     >  x) if (flood_queue_push(x, x1 - 1, y + dy, dy) == FILL_OUT_OF_MEMORY) return;
-                if (x1 - 1 > x2) if (flood_queue_push(x2 + 1, x1 - 1, y - dy, -dy) == FILL_OUT_OF_MEMORY) return;
-                x1 = x1 + 1;
-                while ((x1 <= x2) && (flood_check_fillable(x1, y) == false)) {
-                    x1 = x1 + 1;
-                }
-                x = x1;
+            if (x1 > x)                  flood_shadow_push(x, x1 - 1u, y + dy, dy);
+            if ((int16_t)x1 - 1 > x2)    flood_shadow_push(x2 + 1u, x1 - 1u, y - dy, -dy);
+            x = x1 = flood_span_next(p_row, x1 + 1u, x2);
+        }
+    }
+}
+
+
+// Fillable pixels next to filled ones (shadow differs from capture) in the rows above or below,
+// from where spans dropped on queue overflow would have continued. Returns false if there are none
+static bool flood_shadow_rescan(void) {
+
+    bool found = false;
+    uint8_t * p_row = FLOOD_SHADOW;
+    const uint8_t * p_cap = FLOOD_CAPTURE;
+
+    for (uint8_t y = 0u; y < IMG_HEIGHT_PX; y++) {
+        for (uint8_t col = 0u; col < FLOOD_ROW_SZ; col++) {
+            uint8_t filled_near = 0u;
+            if (y > 0u)                      filled_near |= *(p_row + col - FLOOD_ROW_SZ) ^ *(p_cap + col - FLOOD_ROW_SZ);
+            if (y < (IMG_HEIGHT_PX - 1u))    filled_near |= *(p_row + col + FLOOD_ROW_SZ) ^ *(p_cap + col + FLOOD_ROW_SZ);
+
+            // Each run fills the seed's whole span, so re-check for seeds left in other spans
+            uint8_t seeds;
+            while ((seeds = flood_fillable_bits(p_row, col) & filled_near)) {
+                floodfill_shadow_run((col * 8u) + flood_clz8(seeds), y);
+                found = true;
+            }
+        }
+        p_row += FLOOD_ROW_SZ;
+        p_cap += FLOOD_ROW_SZ;
+    }
+    return found;
+}
+
+
+// Copies tiles changed by the fill back into VRAM
+static void flood_shadow_blit(void) {
+
+    uint8_t tile_buf[TILE_SZ_BYTES];
+
+    for (uint8_t tile_y = 0u; tile_y < IMG_HEIGHT_TILES; tile_y++) {
+        for (uint8_t tile_x = 0u; tile_x < IMG_WIDTH_TILES; tile_x++) {
+
+            uint16_t offset = (tile_y * TILE_SZ_PX * FLOOD_ROW_SZ) + tile_x;
+            const uint8_t * p_row = FLOOD_SHADOW  + offset;
+            const uint8_t * p_cap = FLOOD_CAPTURE + offset;
+
+            uint8_t changed = 0u;
+            for (uint8_t row = 0u; row < TILE_SZ_PX; row++)
+                changed |= p_row[row * FLOOD_ROW_SZ] ^ p_cap[row * FLOOD_ROW_SZ];
+            if (changed == 0u) continue;
+
+            // Both bitplanes match for the drawing's black and white
+            uint8_t * p_vram = (uint8_t *)DRAWING_VRAM_START + (tile_y * SCREEN_ROW_SZ) + (tile_x * TILE_SZ_BYTES);
+            for (uint8_t row = 0u; row < TILE_SZ_PX; row++) {
+                tile_buf[row * 2u] = tile_buf[(row * 2u) + 1u] = p_row[row * FLOOD_ROW_SZ];
             }
+            vmemcpy(p_vram, tile_buf, TILE_SZ_BYTES);
+
+            // The capture gets the result below, only the undo snapshot needs to know
+            draw_dirty_rows[DRAW_DIRTY_UNDO][tile_y] |= (1u << tile_x);
         }
-       // EMU_printf("Fill Queue Max Depth = %u\n", (uint16_t)queue_fill_max);
+    }
+    memcpy((uint8_t *)SRAM_DRAWING_CAPTURE, FLOOD_SHADOW, SRAM_FLOOD_SHADOW_SZ);
+}
+
+
+static void floodfill_shadow(uint8_t x, uint8_t y) {
+
+    // Changed tiles get read into the capture during VBlank, then it's used as the starting point
+    drawing_capture_update();
+    memcpy(FLOOD_SHADOW, FLOOD_CAPTURE, SRAM_FLOOD_SHADOW_SZ);
+
+    // Drawing colors are black or white, which is bit set or clear in the shadow
+    flood_fill_set     = (app_state.draw_color_main == BLACK);
+    flood_fillable_xor = (app_state.draw_color_bg == BLACK) ? 0x00u : 0xFFu;
+
+    flood_queue_count = 0u;
+    flood_overflow    = false;
+    floodfill_shadow_run(x - IMG_X_START, y - IMG_Y_START);
+
+    // If spans got dropped, keep filling out from the edges of what's filled until nothing's left
+    while (flood_overflow) {
+        flood_overflow = false;
+        if (!flood_shadow_rescan()) break;
+    }
+
+    flood_shadow_blit();
+}
+#endif
+
+
+static void draw_tool_floodfill(uint8_t x, uint8_t y) {
+
+    if (KEY_TICKED(DRAW_MAIN_BUTTON)) {
+
+        drawing_take_undo_snapshot();
+
+        drawing_set_to_main_colors();
+
+        // EMU_printf("Start: %hu, %hu\n", (uint8_t)x, (uint8_t)y);
+
+        // Fill queue temp buffer is in SRAM, shared with the QR Code template cache
+        PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER);
+        qrcodegen_invalidate_template_cache();
+
+        #if (FLOOD_FILL_SHADOW)
+            floodfill_shadow(x, y);
+        #else
+            flood_min_x = IMG_X_END;   flood_max_x = IMG_X_START;
+            flood_min_y = IMG_Y_END;   flood_max_y = IMG_Y_START;
+
+            floodfill_run(x, y);
+
+            // Nothing plotted leaves the box inside out
+            if ((flood_min_x <= flood_max_x) && (flood_min_y <= flood_max_y))
+                drawing_dirty_mark(flood_min_x, flood_min_y, flood_max_x, flood_max_y, 0u);
+        #endif
     }
 }
 
@@ -980,7 +1346,7 @@ static void draw_tool_spray(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
     if (KEY_TICKED(DRAW_MAIN_BUTTON)) {
         // Take a undo snapshot only at the start of a drawing segment
         if (tool_undo_snapshot_taken == false) {
-            drawing_take_undo_snapshot();
+            drawing_take_undo_snapshot_lazy();
             tool_undo_snapshot_taken = true;
             spray_rate_count = 0u;
 
@@ -1003,6 +1369,7 @@ static void draw_tool_spray(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
         // End Drawing
         tool_undo_snapshot_taken = false;
         app_state.tool_currently_drawing = false;
+        drawing_undo_lazy_commit();
     }
 
     // Draw if active
@@ -1053,6 +1420,7 @@ static void draw_tool_spray(uint8_t cursor_8u_x, uint8_t cursor_8u_y) {
             // Clip and draw
             if ((x >= IMG_X_START) && (x <= IMG_X_END) &&
                 (y >= IMG_Y_START) && (y <= IMG_Y_END)) {
+                drawing_dirty_mark(x, y, x, y, 0u);
                 plot_point(x, y);
             }
         }
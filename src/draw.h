@@ -1,6 +1,14 @@
 #ifndef DRAW_H
 #define DRAW_H
 
+#include "common.h"
+
+// Flood fill works on a 1bpp SRAM shadow of the drawing and then copies the changed tiles back to VRAM.
+// Set to 0 for the slower original fill directly in VRAM (with its queue overflow limit), fun to watch
+#ifndef FLOOD_FILL_SHADOW
+    #define FLOOD_FILL_SHADOW 1
+#endif
+
 void drawing_set_to_main_colors(void) BANKED;
 void drawing_set_to_alt_colors(void) BANKED;
 
@@ -10,4 +18,24 @@ void draw_init(void) BANKED;
 void draw_update(uint8_t cursor_8u_x, uint8_t cursor_8u_y) BANKED;
 void draw_tools_cancel_and_reset(void) BANKED;
 
+
+// Dirty tile tracking for the drawing area (IMG_WIDTH_TILES x IMG_HEIGHT_TILES tiles)
+//
+// The draw tools mark the tiles they change, clipped to the drawing area. Each consumer
+// has its own map (bit N of a row = tile column N) which it clears once it has caught up,
+// so it only needs to process the tiles that changed since then.
+enum {
+    DRAW_DIRTY_UNDO,     // Since the drawing last matched the undo history head (see save_and_undo.c)
+    DRAW_DIRTY_CAPTURE,  // Since the QR Code export last captured it (see img_2_qrcode.c)
+    DRAW_DIRTY_COUNT
+};
+
+#define DRAW_DIRTY_ROW_ALL ((uint16_t)((1u << IMG_WIDTH_TILES) - 1u))
+
+extern uint16_t draw_dirty_rows[DRAW_DIRTY_COUNT][IMG_HEIGHT_TILES];
+
+// For changes made outside the draw tools (whole drawing replaced, UI redrawn over it, etc)
+void drawing_dirty_mark_all(void) BANKED;
+void drawing_dirty_clear(uint8_t consumer) BANKED;
+
 #endif // DRAW_H
\ No newline at end of file
@@ -51,36 +51,48 @@ static bool print_send_command_and_buffer_delay_1msec_10x_retry(uint8_t command)
 //  represents the byte 0x80               represents the byte 0xF0
 
 
+// Transposes the 8x8 bit matrix in p_buf (one byte per row, MSB = left pixel)
+// in place, which is the flip + rotate above. Done in three passes that swap
+// the off-diagonal 4x4, then 2x2, then 1x1 blocks instead of moving single bits
+static void duck_printer_transpose_tile(uint8_t * p_buf) {
+
+    uint8_t t;
+
+    // 4x4 blocks: low nibble of rows 0-3 <-> high nibble of rows 4-7
+    for (uint8_t c = 0u; c < 4u; c++) {
+        t = (p_buf[c] ^ (p_buf[c + 4u] >> 4)) & 0x0Fu;
+        p_buf[c]      ^= t;
+        p_buf[c + 4u] ^= (uint8_t)(t << 4);
+    }
+
+    // 2x2 blocks within each 4x4 quadrant: rows (0,2) (1,3) (4,6) (5,7)
+    for (uint8_t c = 0u; c < TILE_HEIGHT; c += (c & 0x01u) ? 3u : 1u) {
+        t = (p_buf[c] ^ (p_buf[c + 2u] >> 2)) & 0x33u;
+        p_buf[c]      ^= t;
+        p_buf[c + 2u] ^= (uint8_t)(t << 2);
+    }
+
+    // Single bits within each 2x2 block: rows (0,1) (2,3) (4,5) (6,7)
+    for (uint8_t c = 0u; c < TILE_HEIGHT; c += 2u) {
+        t = (p_buf[c] ^ (p_buf[c + 1u] >> 1)) & 0x55u;
+        p_buf[c]      ^= t;
+        p_buf[c + 1u] ^= (uint8_t)(t << 1);
+    }
+}
+
+
 // Converts one plane (i.e. monochrome, not 4 shades of grey) of
 // an 8x8 Game Boy format tile for printing on the Mega Duck Printer. 
 void duck_printer_convert_tile(uint8_t * p_out_buf, uint8_t * p_tile_buf) {
 
-    // Clear printer tile
+    // Gather the tile rows, note the +2 increment for tile row, skipping the interleaved higher bit plane
     for (uint8_t c = 0u; c < BYTES_PER_PRINTER_TILE; c++) {
-        p_out_buf[c] = 0u;
+        p_out_buf[c] = *p_tile_buf;
+        p_tile_buf += 2u;
     }
 
-    // Transform tile bytes into printable row buffer bytes
     // Tile must get flipped horizontally and rotated -90 degrees
-    // 
-    // Note the +2 increment for tile row, skipping the interleaved higher bit plane
-    //
-    // For each tile row byte take the X axis bits representing pixels
-    // and transform them into column oriented bits spread across 8 bytes
-    //
-    uint8_t out_bit = 0x80u;  // X axis bit to set in the output for corresponding input
-    for (uint8_t tile_row = 0u; tile_row < BYTES_PER_VRAM_TILE; tile_row += 2u) {
-        uint8_t tile_byte = p_tile_buf[tile_row];
-
-        // Scan X axis of tile Left to right
-        uint8_t tile_bit = 0x80u;
-        for (uint8_t out_col = 0; out_col < TILE_HEIGHT; out_col++) {
-
-            if (tile_byte & tile_bit) p_out_buf[out_col] |= out_bit;
-            tile_bit >>= 1;
-        }
-        out_bit >>= 1;
-    }
+    duck_printer_transpose_tile(p_out_buf);
 }
 
 
@@ -92,39 +104,18 @@ void duck_printer_convert_tile(uint8_t * p_out_buf, uint8_t * p_tile_buf) {
 // Color 2 or 3: always black
 void duck_printer_convert_tile_dithered(uint8_t * p_out_buf, uint8_t * p_tile_buf) {
 
-    // Clear printer tile
+    // Reduce each tile row to 1bpp first, with the dither pattern as a mask on color 1
+    uint8_t dither = 0xAAu;  // Dither pattern
     for (uint8_t c = 0u; c < BYTES_PER_PRINTER_TILE; c++) {
-        p_out_buf[c] = 0u;
-    }
+        p_out_buf[c] = p_tile_buf[1] | (p_tile_buf[0] & dither);  // Color 2 or 3 = always on
+        p_tile_buf += 2u;
 
-    // Transform tile bytes into printable row buffer bytes
-    // Tile must get flipped horizontally and rotated -90 degrees
-    //
-    // For each tile row byte take the X axis bits representing pixels
-    // and transform them into column oriented bits spread across 8 bytes
-    //
-    uint8_t out_bit = 0x80u;  // X axis bit to set in the output for corresponding input
-    uint8_t dither  = 0xAAu;  // Dither pattern
-    for (uint8_t tile_row = 0u; tile_row < BYTES_PER_VRAM_TILE; tile_row += 2u) {
-        uint8_t tile_byte0 = p_tile_buf[tile_row];
-        uint8_t tile_byte1 = p_tile_buf[tile_row+1];
-
-        // LSByte first, Scan X axis Left to right
-        uint8_t tile_bit = 0x80u;
-        for (uint8_t out_col = 0; out_col < TILE_HEIGHT; out_col++) {
-
-            if (tile_byte1 & tile_bit) {
-                p_out_buf[out_col] |= out_bit;; // Color 2 or 3 = always on
-            } else if ((tile_byte0 & dither) & tile_bit) {
-                p_out_buf[out_col] |= out_bit; // Color 1 enabled based on checkerboard dither pattern
-            }
-
-            tile_bit >>= 1;
-        }
         // Flip dither pattern for next source tile row
         dither = ~dither;
-        out_bit >>= 1;
     }
+
+    // Tile must get flipped horizontally and rotated -90 degrees
+    duck_printer_transpose_tile(p_out_buf);
 }
 
 
@@ -7,14 +7,13 @@
 
 #include "../save_and_undo.h"
 #include "../common.h"
+#include "../print_tiles.h"
 
 #include "megaduck_printer.h"
 #include "megaduck_printscreen.h"
 
 static void printscreen_prepare_tile_row(uint8_t row, uint8_t tile_bitplane_offset);
 
-uint8_t * p_undo_tile_data;
-
 // Currently unknown:
 // - Single pass printer probably does not support variable image width
 // - Double pass printer might, since it has explicit Carriage Return and Line Feed commands, but it's not verified
@@ -40,10 +39,10 @@ uint8_t * p_undo_tile_data;
 // the last tile row, then the peripheral controller seems to
 // trigger a cpu reset.
 //
-bool duck_print_rect_from_undo(void) {
+// Prints the full screen area, with the print tile source (see print_tiles.h) at its screen position
+bool duck_print_tiles(void) {
 
     bool return_status = true;
-    p_undo_tile_data = undo_get_last_snapshot_addr();  // Gets incremented in printscreen_prepare_tile_row()
 
     // Check for printer connectivity
     uint8_t printer_type = duck_io_printer_query();
@@ -98,36 +97,21 @@ bool duck_print_blank_row(void) {
 }
 
 
-// Prepares a tile row from the contents of screen vram
+// Prepares a tile row from the print tile source, tiles outside it are blank
 static void printscreen_prepare_tile_row(uint8_t row, uint8_t tile_bitplane_offset) {
     
     uint8_t tile_buffer[BYTES_PER_VRAM_TILE];
     uint8_t * p_row_buffer = tile_row_buffer;
 
-    bool    use_win_data = (((row * TILE_HEIGHT) >= WY_REG) && ( LCDC_REG & LCDCF_WINON));
-    uint8_t col = 0;
-
-    if (!use_win_data) {
-        // Add Scroll offset to closest tile (if rendering BG instead of Window)
-        row += (SCY_REG / TILE_HEIGHT);
-        col += (SCX_REG / TILE_WIDTH);
-    }
+    bool row_in_source = (row >= print_tiles_y) && (row < (print_tiles_y + print_tiles_height));
 
     // Loop through tile columns for the current tile row
     for (uint8_t tile = 0u; tile < DEVICE_SCREEN_WIDTH; tile++) {
 
-        // If tile is within the active drawing area copy it from the undo snapshot
-        if ((row >= IMG_TILE_Y_START) && (row <= IMG_TILE_Y_END) &&
-            (tile >= IMG_TILE_X_START) && (tile <= IMG_TILE_X_END)) {
-
-                // Since the undo snapshot contains Only and All of
-                // the tiles we want, in sequential order, they can
-                // be iterated through serially instead of checking
-                // the map and then looking them up based on that
-                memcpy(tile_buffer, p_undo_tile_data, TILE_SZ_BYTES);
-                p_undo_tile_data += TILE_SZ_BYTES;
-
-            } else memset(tile_buffer, 0x00, TILE_SZ_BYTES);
+        // Tiles get pulled from the source one at a time as the row is built
+        if (row_in_source && (tile >= print_tiles_x) && (tile < (print_tiles_x + print_tiles_width)))
+            print_tiles_get(tile_buffer, tile - print_tiles_x, row - print_tiles_y);
+        else memset(tile_buffer, 0x00, TILE_SZ_BYTES);
 
         // Mirror, Rotate -90 degrees and reduce tile to 1bpp
         if (tile_bitplane_offset == BITPLANE_BOTH)
@@ -12,7 +12,7 @@
 #define BITPLANE_1    1
 #define BITPLANE_BOTH 2
 
-bool duck_print_rect_from_undo(void);
+bool duck_print_tiles(void);
 bool duck_print_blank_row(void);
 
 #endif // _MEGADUCK_PRINTSCREEN_H
@@ -5,6 +5,7 @@
 
 #include "../save_and_undo.h"
 #include "../common.h"
+#include "../print_tiles.h"
 
 #include "gbprinter.h"
 
@@ -14,14 +15,10 @@
 
 #define RET_ERR_IF_FAIL(CMD)  if ((error = CMD) & PRN_STATUS_MASK_ERRORS_AND_SUM) return error
 
+// 0b10000001 - start, internal clock
 #define START_TRANSFER 0x81
-#if (CGB_FAST_TRANSFER==1)
-    // 0b10000011 - start, CGB double speed, internal clock
-    #define START_TRANSFER_FAST 0x83
-#else
-    // 0b10000001 - start, internal clock
-    #define START_TRANSFER_FAST 0x81
-#endif
+// 0b10000011 - start, CGB fast clock (x32, ~262KHz or ~524KHz in double speed), internal clock
+#define START_TRANSFER_FAST 0x83
 #define PRN_BUSY_TIMEOUT        PRN_SECONDS(2)
 #define PRN_COMPLETION_TIMEOUT  PRN_SECONDS(20)
 #define PRN_SEIKO_RESET_TIMEOUT 10
@@ -30,6 +27,22 @@
 #define PRN_FINAL_MARGIN        0x03
 #define PRN_STATUS_MASK_ERRORS_AND_SUM (PRN_STATUS_MASK_ERRORS | PRN_STATUS_SUM)
 
+// Results of the fast link probe are kept per console (CGB, or GBA in CGB mode) in SRAM.
+// After the fast clock fails the probe is skipped for a few prints before trying it again
+#define PRN_LINK_SIGNATURE      0x4C50u  // "PL"
+#define PRN_LINK_DEVICE_CGB     0u
+#define PRN_LINK_DEVICE_GBA     1u
+#define PRN_LINK_DEVICE_COUNT   2u
+#define PRN_LINK_FAST_RETRY     8u
+#define PRN_LINK_FALLBACK_WAIT  10u  // Frames for the printer to drop a garbled packet (> 150 msec)
+
+typedef struct printer_link_rec_t {
+    uint16_t signature;
+    uint8_t  probe_skip[PRN_LINK_DEVICE_COUNT];
+} printer_link_rec_t;
+
+#define PRN_LINK_REC ((printer_link_rec_t *)SRAM_PRINTER_LINK)
+
 static const uint8_t PRN_PKT_INIT[]    = { PRN_LE(PRN_MAGIC), PRN_LE(PRN_CMD_INIT),   PRN_LE(0), PRN_LE(0x01), PRN_LE(0) };
 static const uint8_t PRN_PKT_STATUS[]  = { PRN_LE(PRN_MAGIC), PRN_LE(PRN_CMD_STATUS), PRN_LE(0), PRN_LE(0x0F), PRN_LE(0) };
 static const uint8_t PRN_PKT_EOF[]     = { PRN_LE(PRN_MAGIC), PRN_LE(PRN_CMD_DATA),   PRN_LE(0), PRN_LE(0x04), PRN_LE(0) };
@@ -41,62 +54,239 @@ start_print_pkt_t PRN_PKT_START = {
     .crc = 0, .trail = 0
 };
 
-static uint16_t printer_status;
-static uint8_t printer_tile_num;
+// Bytes going out over the link port are queued and sent by the serial interrupt,
+// one byte each time the previous one completes. Size must be a power of 2
+#define PRN_TX_BUF_SZ           128u
+#define PRN_TX_IDX_MASK         (PRN_TX_BUF_SZ - 1u)
+
+static uint8_t prn_tx_data[PRN_TX_BUF_SZ];
+static uint8_t prn_tx_write_head;
+static uint8_t prn_tx_read_tail;
+static volatile uint8_t prn_tx_count;
+static volatile bool prn_tx_busy;
+
+// Last two bytes received from the printer, updated by the serial interrupt
+static volatile uint16_t printer_status;
+
+static uint8_t printer_sc_start = START_TRANSFER;
+static bool    printer_link_fast;
+static bool    printer_link_probed;
+
+static bool    printer_cancelled;
+static uint8_t printer_frame;
+static uint8_t printer_completion_shown;
 
 uint8_t printer_completion = 0;
-static uint8_t printer_send_receive(uint8_t b) {
-    SB_REG = b;
-    SC_REG = 0x81;
-    while (SC_REG & 0x80);
-    return SB_REG;
+
+extern bool printer_check_cancel(void) BANKED;
+extern void printer_show_progress(uint8_t progress) BANKED;
+
+
+// Sends the next queued byte. Caller makes sure there is one and that it's safe to touch the queue
+static void printer_tx_next(void) NONBANKED {
+    SB_REG = prn_tx_data[prn_tx_read_tail];
+    prn_tx_read_tail = (prn_tx_read_tail + 1u) & PRN_TX_IDX_MASK;
+    prn_tx_count--;
+    SC_REG = printer_sc_start;
+}
+
+
+static void printer_isr_sio(void) NONBANKED {
+    printer_status = (printer_status << 8) | SB_REG;
+
+    if (prn_tx_count) printer_tx_next();
+    else prn_tx_busy = false;
+}
+
+
+// Once a frame while waiting on the link port: poll for cancel and show progress
+static bool printer_poll_cancel(void) {
+    if (printer_check_cancel()) printer_cancelled = true;
+    return printer_cancelled;
+}
+
+static void printer_progress_update(void) {
+    if (printer_completion != printer_completion_shown) {
+        printer_completion_shown = printer_completion;
+        printer_show_progress(printer_completion);
+    }
+}
+
+static void printer_tx_idle(void) {
+    if ((uint8_t)sys_time != printer_frame) {
+        printer_frame = (uint8_t)sys_time;
+        printer_poll_cancel();
+        printer_progress_update();
+    }
+}
+
+
+static void printer_send_receive(uint8_t b) {
+    while (prn_tx_count == PRN_TX_BUF_SZ) printer_tx_idle();
+
+    prn_tx_data[prn_tx_write_head] = b;
+    prn_tx_write_head = (prn_tx_write_head + 1u) & PRN_TX_IDX_MASK;
+    CRITICAL {
+        prn_tx_count++;
+        // Kick off sending if the link port went idle
+        if (!prn_tx_busy) {
+            prn_tx_busy = true;
+            printer_tx_next();
+        }
+    }
 }
 
-static uint8_t printer_send_byte(uint8_t b) {
-    return (uint8_t)(printer_status = ((printer_status << 8) | printer_send_receive(b)));
+
+// Waits until everything queued has been sent and the replies received
+static void printer_tx_flush(void) {
+    while (prn_tx_busy) printer_tx_idle();
 }
 
+
 static uint8_t printer_send_command(const uint8_t *command, uint8_t length) {
     uint8_t index = 0;
-    while (index++ < length) printer_send_byte(*command++);
+    while (index++ < length) printer_send_receive(*command++);
+    printer_tx_flush();
     return ((uint8_t)(printer_status >> 8) == PRN_MAGIC_DETECT) ? (uint8_t)printer_status : PRN_STATUS_MASK_ERRORS;
 }
 #define PRINTER_SEND_COMMAND(CMD) printer_send_command((const uint8_t *)&(CMD), sizeof(CMD))
 
-static uint8_t printer_print_tile(const uint8_t *tiledata) {
-    static const uint8_t PRINT_TILE[] = { 0x88,0x33,0x04,0x00,0x80,0x02 };
-    static uint16_t printer_CRC;
-    if (printer_tile_num == 0) {
-        const uint8_t * data = PRINT_TILE;
-        for (uint8_t i = sizeof(PRINT_TILE); i != 0; i--) printer_send_receive(*data++);
-        printer_CRC = 0x04 + 0x80 + 0x02;
+#define TILE_BANK_0 _VRAM8800
+#define TILE_BANK_1 _VRAM8000
+
+#define TILE_BYTES_SZ              (16u)
+#define APA_TILE_SRC_TOGGLE_TILE_Y (72u / 8u)
+#define APA_TILE_NUM_UPPER_START   (128u)
+
+// Printer DATA packets carry one band of 40 tiles (2 printer tile rows)
+#define PRN_BAND_TILE_ROWS      2u
+#define PRN_BAND_ROW_SZ         (PRN_TILE_WIDTH * TILE_BYTES_SZ)
+#define PRN_BAND_SZ             (PRN_BAND_ROW_SZ * PRN_BAND_TILE_ROWS)
+
+// Printer RLE: control byte 0x80 | (count - 2) followed by one byte repeated count times (2..129),
+// or control byte (count - 1) followed by count literal bytes (1..128)
+#define PRN_RLE_RUN_FLAG        0x80u
+#define PRN_RLE_RUN_MIN         3u    // Shorter runs are cheaper to keep in a literal
+#define PRN_RLE_RUN_MAX         129u
+#define PRN_RLE_LITERAL_MAX     128u
+
+#define PRN_COMPRESSION_NONE    0x00u
+#define PRN_COMPRESSION_RLE     0x01u
+
+// The band being sent: rows of (sw) tiles pulled from the print tile source, placed at
+// tile column (x_ofs), everything else is blank paper. The last tile pulled is kept since
+// the encoder mostly walks forward through the band
+#define PRN_BAND_NO_TILE        0xFFu
+
+static uint8_t band_src_y;
+static uint8_t band_tile_rows;
+static uint8_t band_x_ofs;
+static uint8_t band_sw;
+static uint8_t band_tile[TILE_BYTES_SZ];
+static uint8_t band_tile_num;
+
+static uint16_t printer_CRC;
+
+static uint8_t band_byte(uint16_t pos) {
+    uint8_t row = 0u;
+    if (pos >= PRN_BAND_ROW_SZ) {
+        pos -= PRN_BAND_ROW_SZ;
+        row++;
     }
-    for(uint8_t i = 0x10; i != 0; i--, tiledata++) {
-        printer_CRC += *tiledata;
-        printer_send_receive(*tiledata);
+    uint8_t x = (uint8_t)(pos >> 4);
+    if ((row >= band_tile_rows) || (x < band_x_ofs) || (x >= (band_x_ofs + band_sw))) return 0x00u;
+
+    uint8_t tile_num = (row * PRN_TILE_WIDTH) + x;
+    if (tile_num != band_tile_num) {
+        band_tile_num = tile_num;
+        print_tiles_get(band_tile, x - band_x_ofs, band_src_y + row);
     }
-    if (++printer_tile_num == 40) {
-        printer_send_receive((uint8_t)printer_CRC);
-        printer_send_receive((uint8_t)(printer_CRC >> 8));
-        printer_send_receive(0x00);
-        printer_send_receive(0x00);
-        printer_CRC = printer_tile_num = 0;
-        return TRUE;
+    return band_tile[(uint8_t)pos & (TILE_BYTES_SZ - 1u)];
+}
+
+static uint8_t band_run_len(uint16_t pos) {
+    uint8_t value = band_byte(pos);
+    uint8_t len = 1u;
+    while ((++pos < PRN_BAND_SZ) && (len < PRN_RLE_RUN_MAX) && (band_byte(pos) == value)) len++;
+    return len;
+}
+
+static void printer_send_data(uint8_t b) {
+    printer_CRC += b;
+    printer_send_receive(b);
+}
+
+// Walks the band RLE encoded, sending it if requested. Returns the encoded size
+static uint16_t printer_band_rle(bool send) {
+    uint16_t size = 0u;
+    uint16_t pos = 0u;
+
+    while (pos < PRN_BAND_SZ) {
+        uint8_t run = band_run_len(pos);
+
+        if (run >= PRN_RLE_RUN_MIN) {
+            if (send) {
+                printer_send_data(PRN_RLE_RUN_FLAG | (run - 2u));
+                printer_send_data(band_byte(pos));
+            }
+            pos  += run;
+            size += 2u;
+        } else {
+            // Gather literal bytes up to the next worthwhile run
+            uint16_t start = pos;
+            uint8_t count = 0u;
+            do {
+                if (run > (PRN_RLE_LITERAL_MAX - count)) run = PRN_RLE_LITERAL_MAX - count;
+                pos   += run;
+                count += run;
+            } while ((pos < PRN_BAND_SZ) && (count < PRN_RLE_LITERAL_MAX) && ((run = band_run_len(pos)) < PRN_RLE_RUN_MIN));
+
+            if (send) {
+                printer_send_data(count - 1u);
+                while (start != pos) printer_send_data(band_byte(start++));
+            }
+            size += count + 1u;
+        }
     }
-    return FALSE;
+    return size;
+}
+
+// Sends the current band as one DATA packet, RLE compressed unless that doesn't make it smaller
+static void printer_send_band(void) {
+    #if (GBPRINTER_RLE)
+        uint16_t length = printer_band_rle(false);
+        uint8_t compression = (length < PRN_BAND_SZ) ? PRN_COMPRESSION_RLE : PRN_COMPRESSION_NONE;
+    #else
+        uint16_t length = PRN_BAND_SZ;
+        uint8_t compression = PRN_COMPRESSION_NONE;
+    #endif
+    if (compression == PRN_COMPRESSION_NONE) length = PRN_BAND_SZ;
+
+    printer_send_receive(PRN_LOW(PRN_MAGIC));
+    printer_send_receive(PRN_HIGH(PRN_MAGIC));
+    printer_CRC = 0u;
+    printer_send_data(PRN_CMD_DATA);
+    printer_send_data(compression);
+    printer_send_data(PRN_LOW(length));
+    printer_send_data(PRN_HIGH(length));
+
+    if (compression == PRN_COMPRESSION_RLE) printer_band_rle(true);
+    else for (uint16_t pos = 0u; pos != PRN_BAND_SZ; pos++) printer_send_data(band_byte(pos));
+
+    printer_send_receive((uint8_t)printer_CRC);
+    printer_send_receive((uint8_t)(printer_CRC >> 8));
+    printer_send_receive(0x00);
+    printer_send_receive(0x00);
 }
 
 inline void printer_init(void) {
-    printer_tile_num = 0;
     PRINTER_SEND_COMMAND(PRN_PKT_INIT);
 }
 
-extern bool printer_check_cancel(void) BANKED;
-
 static uint8_t printer_wait(uint16_t timeout, uint8_t mask, uint8_t value) {
     uint8_t error;
     while (((error = PRINTER_SEND_COMMAND(PRN_PKT_STATUS)) & mask) != value) {
-        if (printer_check_cancel()) {
+        if (printer_poll_cancel()) {
             PRINTER_SEND_COMMAND(PRN_PKT_CANCEL);
             return PRN_STATUS_CANCELLED;
         }
@@ -107,99 +297,188 @@ static uint8_t printer_wait(uint16_t timeout, uint8_t mask, uint8_t value) {
     return error;
 }
 
-uint8_t gbprinter_detect(uint8_t delay) BANKED {
-    printer_init();
-    return printer_wait(delay, PRN_STATUS_MASK_ANY, PRN_STATUS_OK);
+// Printer link transfers are interrupt driven while installed
+void gbprinter_install(void) BANKED {
+
+    CRITICAL {
+        prn_tx_write_head = 0u;
+        prn_tx_read_tail  = 0u;
+        prn_tx_count      = 0u;
+        prn_tx_busy       = false;
+
+        // Remove first to avoid accidentally double-adding it
+        remove_SIO(printer_isr_sio);
+        add_SIO(printer_isr_sio);
+    }
+    printer_cancelled = false;
+    printer_completion = printer_completion_shown = 0u;
+
+    // Enable Serial interrupt
+    set_interrupts(IE_REG | SIO_IFLAG);
 }
 
 
-#define TILE_BANK_0 _VRAM8800
-#define TILE_BANK_1 _VRAM8000
+void gbprinter_remove(void) BANKED {
+
+    printer_tx_flush();
+    CRITICAL {
+        remove_SIO(printer_isr_sio);
+    }
+    set_interrupts(IE_REG & ~SIO_IFLAG);
+}
+
+
+#if (CGB_FAST_TRANSFER)
+static uint8_t printer_link_device(void) {
+    return (_is_GBA) ? PRN_LINK_DEVICE_GBA : PRN_LINK_DEVICE_CGB;
+}
+
+
+// Returns the SRAM record of link probe results, (re)initialized if it isn't valid
+static printer_link_rec_t * printer_link_rec(void) {
+    PLAT_SWITCH_RAM(SRAM_BANK_PRINTER_LINK);
+    printer_link_rec_t * p_rec = PRN_LINK_REC;
+    if (p_rec->signature != PRN_LINK_SIGNATURE) {
+        memset(p_rec, 0x00u, sizeof(printer_link_rec_t));
+        p_rec->signature = PRN_LINK_SIGNATURE;
+    }
+    return p_rec;
+}
+
+
+static void printer_link_record(bool fast_ok) {
+    printer_link_rec_t * p_rec = printer_link_rec();
+    uint8_t device = printer_link_device();
+    p_rec->probe_skip[device] = (fast_ok) ? 0u : PRN_LINK_FAST_RETRY;
+}
+
+
+// Back to the normal link speed, after letting the printer time out whatever it made of the fast clock
+static void printer_link_fallback(void) {
+    printer_sc_start = START_TRANSFER;
+    for (uint8_t c = 0u; c < PRN_LINK_FALLBACK_WAIT; c++) vsync();
+}
 
-#define TILE_BYTES_SZ              (16u)
-#define APA_TILE_SRC_TOGGLE_TILE_Y (72u / 8u)
-#define APA_TILE_NUM_UPPER_START   (128u)
 
-// Prints the requested tile region of the screen in APA mode, tiles outside the screen are printed WHITE
-// uint8_t gbprinter_print_screen_rect_from_undo(uint8_t sx, uint8_t sy, uint8_t sw, uint8_t sh, uint8_t centered) BANKED {
-uint8_t gbprinter_print_screen_rect_from_undo(void) BANKED {
+// Sends INIT and then STATUS on the CGB fast clock. The printer has to echo its magic
+// byte for both, without errors or a checksum error from a garbled packet
+static bool printer_link_probe_fast(void) {
+
+    printer_link_rec_t * p_rec = printer_link_rec();
+    uint8_t device = printer_link_device();
+    if (p_rec->probe_skip[device]) {
+        p_rec->probe_skip[device]--;
+        return false;
+    }
+
+    printer_link_probed = true;
+    printer_sc_start = START_TRANSFER_FAST;
+    if (((PRINTER_SEND_COMMAND(PRN_PKT_INIT)   & PRN_STATUS_MASK_ERRORS_AND_SUM) == 0u) &&
+        ((PRINTER_SEND_COMMAND(PRN_PKT_STATUS) & PRN_STATUS_MASK_ERRORS_AND_SUM) == 0u)) {
+        printer_link_record(true);
+        return true;
+    }
+
+    printer_link_fallback();
+    return false;
+}
+#endif
+
+
+// On CGB this tries the fast link clock first and keeps it for the whole print if the
+// printer handles it. Otherwise it's the DMG link speed the printer was made for
+uint8_t gbprinter_detect(uint8_t delay) BANKED {
+
+    printer_link_fast   = false;
+    printer_link_probed = false;
+    printer_sc_start    = START_TRANSFER;
+
+    #if (CGB_FAST_TRANSFER)
+        if ((_cpu == CGB_TYPE) && printer_link_probe_fast()) {
+            // Still has to get to idle (not busy, full or with untransferred data) on the fast clock
+            uint8_t status = printer_wait(delay, PRN_STATUS_MASK_ANY, PRN_STATUS_OK);
+            if ((status == PRN_STATUS_OK) || printer_cancelled) {
+                printer_link_fast = (status == PRN_STATUS_OK);
+                return status;
+            }
+            printer_link_fallback();
+        }
+    #endif
+
+    // Printing may be more reliable at DMG link speed
+    if (_cpu == CGB_TYPE) cpu_slow();
+
+    printer_init();
+    uint8_t status = printer_wait(delay, PRN_STATUS_MASK_ANY, PRN_STATUS_OK);
+
+    #if (CGB_FAST_TRANSFER)
+        // Only a printer that answers at the normal speed means the fast clock didn't work with it,
+        // otherwise there may just be no printer connected
+        if (printer_link_probed && (status == PRN_STATUS_OK)) printer_link_record(false);
+    #endif
+    return status;
+}
+
+
+// Prints the area of the print tile source, centered, tiles outside it are printed WHITE
+static uint8_t printer_print_tiles(void) {
     static uint8_t error;
 
-    // Printing from an undo snapshot means the size of the image is fixed
-    const uint8_t sx = IMG_TILE_X_START;
-    const uint8_t sy = IMG_TILE_Y_START;
-    const uint8_t sw = IMG_WIDTH_TILES;
-    const uint8_t sh = IMG_HEIGHT_TILES;
+    const uint8_t sw = print_tiles_width;
+    const uint8_t sh = print_tiles_height;
     const uint8_t centered = true;
 
-    uint8_t * p_undo_tile_data = undo_get_last_snapshot_addr();
-
     // call printer progress: zero progress
     printer_completion = 0; // call_far(&printer_progress_handler);
 
-    uint8_t tile_data[0x10], rows = ((sh & 0x01) ? (sh + 1) : sh), pkt_count = 0, x_ofs = (centered) ? ((PRN_TILE_WIDTH - sw) >> 1) : 0;
-
-    printer_tile_num = 0;
+    uint8_t rows = ((sh & 0x01) ? (sh + 1) : sh), pkt_count = 0, x_ofs = (centered) ? ((PRN_TILE_WIDTH - sw) >> 1) : 0;
 
     // Return early if the area to print is zero
     // if ((sw == 0u) || (sh == 0u)) return PRN_STATUS_OK;
 
-    for (uint8_t y = 0; y != rows; y++) {
-        // uint8_t * map_addr = get_bkg_xy_addr(sx, y + sy);
-        for (uint8_t x = 0; x != PRN_TILE_WIDTH; x++) {
-            if ((x >= x_ofs) && (x < (x_ofs + sw)) && (y < sh))  {
-
-                // uint8_t tile = get_vram_byte(map_addr++);
-                // uint8_t * source = (((y + sy) >= APA_TILE_SRC_TOGGLE_TILE_Y) && (tile < APA_TILE_NUM_UPPER_START)) ? _VRAM9000 : _VRAM8000;
-                // vmemcpy(tile_data, source + ((uint16_t)tile << 4), sizeof(tile_data));
-
-                // Since the undo snapshot contains Only and All of
-                // the tiles we want, in sequential order, they can
-                // be iterated through serially instead of checking
-                // the map and then looking them up based on that
-                memcpy(tile_data, p_undo_tile_data, sizeof(tile_data));
-                p_undo_tile_data += TILE_BYTES_SZ;
-
-            } else memset(tile_data, 0x00, sizeof(tile_data));
-
-            // Send tile to printer
-            // On first tile, a packet header is emitted beforehand
-            // On last tile (40 tiles, 2 screen tile rows) it completes the packet (and the call returns true)
-            if (printer_print_tile(tile_data)) {
-                pkt_count++;
-                if (printer_check_cancel()) {
-                    PRINTER_SEND_COMMAND(PRN_PKT_CANCEL);
-                    return PRN_STATUS_CANCELLED;
-                }
-            }
+    band_x_ofs = x_ofs;
+    band_sw    = sw;
 
-            // Once 18 tile rows have been printed (9 x 2 per print packet)
-            // Send the EOF and then Print commands
-            if (pkt_count == 9) {
-                pkt_count = 0;
-                RET_ERR_IF_FAIL(PRINTER_SEND_COMMAND(PRN_PKT_EOF));
-                // Some emulators don't set PRN_STATUS_FULL bit until PRN_PKT_START, so this may fail on them.
-                // It also seems optional since some OEM games skip this check and call print immediately.
-                // RET_ERR_IF_FAIL(printer_wait(PRN_FULL_TIMEOUT, PRN_STATUS_FULL, PRN_STATUS_FULL));
-
-                gbprinter_set_print_params((y == (rows - 1)) ? PRN_FINAL_MARGIN : PRN_NO_MARGINS, PRN_PALETTE_NORMAL, PRN_EXPOSURE_DARK);
-                RET_ERR_IF_FAIL(PRINTER_SEND_COMMAND(PRN_PKT_START));
-                // query printer status
-                RET_ERR_IF_FAIL(printer_wait(PRN_BUSY_TIMEOUT, PRN_STATUS_BUSY, PRN_STATUS_BUSY));
-                RET_ERR_IF_FAIL(printer_wait(PRN_COMPLETION_TIMEOUT, PRN_STATUS_BUSY, 0));
+    for (uint8_t y = 0; y != rows; y += PRN_BAND_TILE_ROWS) {
+
+        band_src_y     = y;
+        band_tile_rows = ((sh - y) >= PRN_BAND_TILE_ROWS) ? PRN_BAND_TILE_ROWS : (sh - y);
+        band_tile_num  = PRN_BAND_NO_TILE;
+
+        // Progress gets shown once a frame while waiting on the link port
+        printer_completion = (((uint16_t)y * PRN_MAX_PROGRESS) / rows);
+
+        // Send band of 40 tiles (2 screen tile rows) to the printer as one data packet,
+        // it goes out over the link port while the next band gets encoded
+        printer_send_band();
+        pkt_count++;
+        printer_tx_idle();
+        if (printer_cancelled) {
+            PRINTER_SEND_COMMAND(PRN_PKT_CANCEL);
+            return PRN_STATUS_CANCELLED;
+        }
+
+        // Once 18 tile rows have been printed (9 x 2 per print packet)
+        // Send the EOF and then Print commands
+        if (pkt_count == 9) {
+            pkt_count = 0;
+            RET_ERR_IF_FAIL(PRINTER_SEND_COMMAND(PRN_PKT_EOF));
+            // Some emulators don't set PRN_STATUS_FULL bit until PRN_PKT_START, so this may fail on them.
+            // It also seems optional since some OEM games skip this check and call print immediately.
+            // RET_ERR_IF_FAIL(printer_wait(PRN_FULL_TIMEOUT, PRN_STATUS_FULL, PRN_STATUS_FULL));
+
+            gbprinter_set_print_params(((y + PRN_BAND_TILE_ROWS) == rows) ? PRN_FINAL_MARGIN : PRN_NO_MARGINS, PRN_PALETTE_NORMAL, PRN_EXPOSURE_DARK);
+            RET_ERR_IF_FAIL(PRINTER_SEND_COMMAND(PRN_PKT_START));
+            // query printer status
+            RET_ERR_IF_FAIL(printer_wait(PRN_BUSY_TIMEOUT, PRN_STATUS_BUSY, PRN_STATUS_BUSY));
+            RET_ERR_IF_FAIL(printer_wait(PRN_COMPLETION_TIMEOUT, PRN_STATUS_BUSY, 0));
 #ifdef REINIT_SEIKO
-                // reinit printer (required by Seiko?)
-                if (y != (rows - 1)) {
-                    PRINTER_SEND_COMMAND(PRN_PKT_INIT);
-                    RET_ERR_IF_FAIL(printer_wait(PRN_SEIKO_RESET_TIMEOUT, PRN_STATUS_MASK_ANY, PRN_STATUS_OK));
-                }
-#endif
-                // call printer progress callback
-                uint8_t current_progress = (((uint16_t)y * PRN_MAX_PROGRESS) / rows);
-                if (printer_completion != current_progress) {
-                    printer_completion = current_progress; //, call_far(&printer_progress_handler);
-                }
+            // reinit printer (required by Seiko?)
+            if ((y + PRN_BAND_TILE_ROWS) != rows) {
+                PRINTER_SEND_COMMAND(PRN_PKT_INIT);
+                RET_ERR_IF_FAIL(printer_wait(PRN_SEIKO_RESET_TIMEOUT, PRN_STATUS_MASK_ANY, PRN_STATUS_OK));
             }
+#endif
         }
     }
 
@@ -218,6 +497,19 @@ uint8_t gbprinter_print_screen_rect_from_undo(void) BANKED {
 
         // indicate 100% completion
         printer_completion = PRN_MAX_PROGRESS; //, call_far(&printer_progress_handler);
+        printer_progress_update();
     }
     return PRINTER_SEND_COMMAND(PRN_PKT_STATUS);
 }
+
+
+uint8_t gbprinter_print_tiles(void) BANKED {
+
+    uint8_t status = printer_print_tiles();
+
+    #if (CGB_FAST_TRANSFER)
+        // A printer that got through the probe but not the print can't keep up with the fast clock either
+        if (printer_link_fast && (status & PRN_STATUS_MASK_ERRORS) && !printer_cancelled) printer_link_record(false);
+    #endif
+    return status;
+}
@@ -4,6 +4,20 @@
 #include <gbdk/platform.h>
 #include <stdint.h>
 
+/** Set to 0 to always send printer data packets uncompressed
+    instead of RLE compressed (when that makes them smaller)
+*/
+#ifndef GBPRINTER_RLE
+    #define GBPRINTER_RLE 1
+#endif
+
+/** Set to 0 to always print at the DMG link speed on CGB
+    instead of trying the fast serial clock first
+*/
+#ifndef CGB_FAST_TRANSFER
+    #define CGB_FAST_TRANSFER 1
+#endif
+
 /** Width of the printed image in tiles
 */
 #define PRN_TILE_WIDTH          20
@@ -138,9 +152,11 @@ inline void gbprinter_set_print_params(uint8_t margins, uint8_t palette, uint8_t
     PRN_PKT_START.crc = ((PRN_CMD_PRINT + 0x04u + 0x01u) + (PRN_PKT_START.margins = margins) + (PRN_PKT_START.palette = palette) + (PRN_PKT_START.exposure = exposure));
 }
 
+void gbprinter_install(void) BANKED;
+void gbprinter_remove(void) BANKED;
 uint8_t gbprinter_detect(uint8_t delay) BANKED;
 // uint8_t gbprinter_print_image(const uint8_t * image_map, const uint8_t * image, int8_t pos_x, uint8_t width, uint8_t height) BANKED;
-// uint8_t gbprinter_print_screen_rect_from_undo(uint8_t sx, uint8_t sy, uint8_t sw, uint8_t sh, uint8_t centered) BANKED;
-uint8_t gbprinter_print_screen_rect_from_undo(void) BANKED;
+// Prints the current print tile source (see print_tiles.h)
+uint8_t gbprinter_print_tiles(void) BANKED;
 
 #endif
@@ -15,10 +15,25 @@
 #include "png_indexed.h"
 #include "png_palettes.h"
 #include "base64.h"
+#include "base32.h"
 #include "qr_wrapper.h"
+#include "qrcodegen.h"
+#include "img_2_qrcode.h"
+#include "input.h"
+#include "draw.h"
+#include "save_and_undo.h"
+#include "profiler.h"
 
 
 
+#if (QR_URL_FORMAT == QR_URL_FORMAT_BASE32)
+    #ifndef QR_URL_BASE32_PREFIX
+        #error "QR_URL_FORMAT_BASE32 needs QR_URL_BASE32_PREFIX, the url of the decoder page ending in '#' (make URL_BASE32=<prefix>)"
+    #endif
+    static const uint8_t url_base32_prefix[] = QR_URL_BASE32_PREFIX;
+#endif
+
+
 // ===== START PNG TEST IMAGE =====
 #define IMG_8X8_4_COLORS_8BPP_ENCODED_WIDTH  8u
 #define IMG_8X8_4_COLORS_8BPP_ENCODED_HEIGHT 8u
@@ -45,98 +60,328 @@
 // Note: Optimized display capture/read -> png relies:
 // - Image being aligned to tiles horizontally
 // - Display tiles arranged for APA mode
-static uint16_t copy_1bpp_image_from_vram(uint8_t * p_out_buf) {
+//
+// The drawing is captured into an SRAM buffer as 1bpp rows (what the PNG encoder takes).
+// The buffer is kept between exports, so only tiles changed since the last capture (see draw.h) get read.
 
-    DISPLAY_OFF;
-    const uint8_t * p_out_buf_start = p_out_buf;
+// Copies one drawing tile from VRAM into the capture buffer. Caller makes sure VRAM is accessible
+static void capture_copy_tile(uint8_t tile_x, uint8_t tile_y) {
 
-    // Start at first tile in vram
-    // APA mode layout is 20 tiles wide x 18 tiles tall, starting at 0x8100
-    uint8_t *   p_vram = APA_MODE_VRAM_START + (((IMG_TILE_Y_START * DEVICE_SCREEN_WIDTH) + IMG_TILE_X_START) * TILE_SZ_BYTES);
+    const uint8_t * p_vram = (const uint8_t *)DRAWING_VRAM_START + (tile_y * SCREEN_ROW_SZ) + (tile_x * TILE_SZ_BYTES);
+    uint8_t * p_buf = (uint8_t *)SRAM_DRAWING_CAPTURE + ((tile_y * TILE_SZ_PX) * IMG_WIDTH_TILES) + tile_x;
 
-    // The -2 is to rewind but then step down to the next 2bpp row in the tile
-    const uint16_t next_line_row_rewind = (IMG_WIDTH_TILES * TILE_SZ_BYTES) - 2u;
+    // First 1bpp byte of each 2bpp tile row
+    for (uint8_t row = 0u; row < TILE_SZ_PX; row++) {
+        *p_buf = *p_vram;
+        p_vram += 2u;
+        p_buf  += IMG_WIDTH_TILES;
+    }
+}
 
-    // +2 is to wrap to the first bpp row of the next tile from the 1bpp end of the last tile in the row
-    // -1 tiles is for after the end of a tile row it will be pointing one tile into the rowstride area (and so 1 needs to be skipped)
-    const uint16_t next_row_of_tiles    = (((DEVICE_SCREEN_WIDTH - IMG_WIDTH_TILES) -1u) * TILE_SZ_BYTES) + 2u;
 
+// Reads the changed tiles into the capture buffer. Returns true once there are none left.
+// With vblank_only (display on) it stops when the current VBlank is about to end, otherwise the display must be off
+static bool capture_dirty_tiles(bool vblank_only) {
 
-    for (uint8_t tile_y = 0; tile_y < IMG_WIDTH_TILES; tile_y++) {
+    for (uint8_t tile_y = 0u; tile_y < IMG_HEIGHT_TILES; tile_y++) {
+        uint16_t * p_dirty = &draw_dirty_rows[DRAW_DIRTY_CAPTURE][tile_y];
 
-        // Step through a row of tiles (i.e. N tiles wide x 8 pixels tall)
-        uint8_t tile_height;
-        for (tile_height = 0; tile_height < TILE_SZ_PX; tile_height++) {
+        for (uint8_t tile_x = 0u; *p_dirty; tile_x++) {
+            uint16_t tile_bit = (1u << tile_x);
+            if (!(*p_dirty & tile_bit)) continue;
 
-            // Steps across row N of each adjacent tile, picking off the first 1bpp byte
-            uint8_t tile_x;
-            for (tile_x = 0; tile_x < IMG_WIDTH_TILES; tile_x++) {
-                *p_out_buf++ = *p_vram;
-                p_vram += TILE_SZ_BYTES;
-            }
-            // Go to start of next scanline within the 8 pixel tall tile row
-            // except on the very last tile row (to make calc to next tile row easier)
-            if (tile_height != (TILE_SZ_PX - 1u))
-                p_vram -= next_line_row_rewind;
+            if (vblank_only && ((LY_REG < DEVICE_SCREEN_PX_HEIGHT) || (LY_REG > QR_PREGEN_CAPTURE_LY_LAST))) return false;
+
+            capture_copy_tile(tile_x, tile_y);
+            *p_dirty &= ~tile_bit;
         }
-        // Wrap around to start of next line in current row of tiles
-        p_vram += next_row_of_tiles;
     }
-
-    DISPLAY_ON;
-
-    uint16_t len = p_out_buf - p_out_buf_start;
-    EMU_printf(" Image: len=%u, end=%x\n", (uint16_t)len, (uint16_t)p_out_buf);
-
-    return len;
+    return true;
 }
 
 
-void image_to_png_qrcode_url(void) BANKED {
+// Brings the whole capture up to date, a few tiles per VBlank with the display on
+void drawing_capture_update(void) BANKED {
 
     PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER);
+    while (!capture_dirty_tiles(true)) vsync();
+}
 
-    // Output buffers in Cart SRAM, no need to allocate them
-    uint8_t * p_img_1bpp_buf       = (uint8_t *)SRAM_UPPER_B000; // Gets overwritten by Base64 encoded image
-    uint8_t * p_png_buf            = (uint8_t *)SRAM_BASE_A000;
-    uint8_t * p_base64_png_url_str = (uint8_t *)SRAM_UPPER_B000;
-
-    // ===== Prepare image buffer =====
-    EMU_printf("Generating Image\n");
-    // Read image from screen apa graphics
-    // The img_1bpp_sz result is not used right now, it's assumed it matches ((width * height) packed at 1bpp) 
-    uint16_t img_1bpp_sz = copy_1bpp_image_from_vram(p_img_1bpp_buf);
 
+// Sets up the PNG encoder for the captured drawing, built at the start of SRAM. Returns false if it wouldn't fit
+static bool capture_png_setup(void) {
 
-    // ===== Conversion to PNG =====
-    // printf("Generating PNG\n");
-    EMU_printf("Generating PNG\n");
     // uint16_t png_buf_sz = png_indexed_init(IMG_8X8_4_COLORS_8BPP_ENCODED_WIDTH,
     //                                        IMG_8X8_4_COLORS_8BPP_ENCODED_HEIGHT,
     //                                        // PNG_BPP_8,     // Current build works, to match  test_8x8_indexed_nocomp_2bpp-encoded.png use 8BPP
     //                                        PNG_BPP_2,        // Output passes pngcheck and imports to GIMP ok
     //                                        ARRAY_LEN(img_8x8_4_colors_8bpp_encoded_pal));
-    uint16_t png_buf_sz = png_indexed_init(IMG_WIDTH_PX, IMG_HEIGHT_PX, SRC_BPP_1, PNG_BPP_1, pal_1bpp_white_black_sz);
-    png_indexed_set_buffers(pal_1bpp_white_black, p_img_1bpp_buf, p_png_buf);
+    // Compression makes the PNG (and so the QR Code) much smaller for typical line art drawings.
+    // The compressed PNG + its staging area fit in the calc buffer SRAM bank, before the capture buffer
+    //
+    // No row filtering: for 1bpp drawings DEFLATE's row stride matches already get what the Up filter
+    // would, and filtered rows measured larger on the host-bench corpus (try with: -f 1 / -f 2)
+    uint16_t png_buf_sz = png_indexed_init(IMG_WIDTH_PX, IMG_HEIGHT_PX, SRC_BPP_1, PNG_BPP_1, pal_1bpp_white_black_sz,
+                                           PNG_COMPRESSION_FIXED_HUFFMAN, PNG_FILTER_MODE_NONE);
+    if (png_buf_sz > (SRAM_DRAWING_CAPTURE - SRAM_BASE_A000)) return false;
+
+    png_indexed_set_buffers(pal_1bpp_white_black, (uint8_t *)SRAM_DRAWING_CAPTURE, (uint8_t *)SRAM_BASE_A000);
+    return true;
+}
+
+
+// Encodes the captured drawing as a PNG at the start of SRAM. Returns its size, 0 if it wouldn't fit
+static uint16_t capture_to_png(void) {
+
+    return (capture_png_setup()) ? png_indexed_encode() : 0u;
+}
+
+
+// ===== Multi QR Code export =====
+// The url gets split into parts which each fit in a QR Code of the requested version or lower,
+// joined by structured append headers. Parts are generated again from the PNG when shown.
+static uint16_t png_size;
+static uint16_t qr_part_offset[QR_STRUCTURED_APPEND_MAX + 1u];  // Url offsets, last one is the end
+static uint8_t  qr_part_count;
+static uint8_t  qr_parity;
+
+
+// Copies up to max_len chars of the url from url_offset onward. Returns how many, 0 past the end
+static uint16_t url_read_part(uint8_t * p_dest, uint16_t url_offset, uint16_t max_len) {
+
+    #if (QR_URL_FORMAT == QR_URL_FORMAT_BASE32)
+        return base32_encode_url_part(p_dest, url_base32_prefix, ARRAY_LEN(url_base32_prefix) - 1u,
+                                      (const uint8_t *)SRAM_BASE_A000, png_size, url_offset, max_len);
+    #else
+        return base64_encode_url_part(p_dest, (const uint8_t *)SRAM_BASE_A000, png_size, url_offset, max_len);
+    #endif
+}
+
+
+// Returns the number of parts, or 0 if the url needs more than QR_STRUCTURED_APPEND_MAX
+static uint8_t qr_parts_plan(uint8_t version_max) {
+
+    static qr_segment_t segments[QR_SEGMENTS_MAX];
+    uint8_t * p_text = (uint8_t *)SRAM_QR_PART_TEXT;
+    uint16_t  url_offset = 0u;
+
+    qr_part_count = 0u;
+    qr_parity     = 0u;
+
+    // Header size is the same for any position and total, so the part sizes come out right
+    qrcodegen_set_structured_append(0u, QR_STRUCTURED_APPEND_MAX, 0u);
+
+    while (true) {
+        uint16_t len = url_read_part(p_text, url_offset, SRAM_QR_PART_TEXT_SZ);
+        if (len == 0u) break;
+        if (qr_part_count == QR_STRUCTURED_APPEND_MAX) return 0u;
+
+        // Keep as much of the text as fits
+        uint8_t seg_count = qrcodegen_make_segments(p_text, len, segments, QR_SEGMENTS_MAX);
+        len = qrcodegen_fit_segments(segments, &seg_count, version_max);
+        if (len == 0u) return 0u;
+
+        // Parity is over the whole url
+        for (uint16_t c = 0u; c < len; c++) qr_parity ^= p_text[c];
+
+        qr_part_offset[qr_part_count++] = url_offset;
+        url_offset += len;
+    }
+    qr_part_offset[qr_part_count] = url_offset;
+
+    EMU_printf("QR parts=%hu, parity=%hx\n", (uint8_t)qr_part_count, (uint8_t)qr_parity);
+    return qr_part_count;
+}
+
+
+bool qrcode_show_part(uint8_t part) BANKED {
+
+    PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER);
+    uint8_t * p_text = (uint8_t *)SRAM_QR_PART_TEXT;
+
+    uint16_t len = url_read_part(p_text, qr_part_offset[part], qr_part_offset[part + 1u] - qr_part_offset[part]);
+    qrcodegen_set_structured_append(part, qr_part_count, qr_parity);
+    if (!qr_generate((const char *)p_text, len)) {
+        EMU_printf("QR Code gen Error\n");
+        return false;
+    }
+
+    PROF_BEGIN(PROF_STAGE_RENDER);
+    qr_render();
+    PROF_END(PROF_STAGE_RENDER);
+
+    // Which QR Code this is, if there is room above it
+    if (qr_size <= QR_PART_LABEL_SIZE_MAX) {
+        color(BLACK, WHITE, SOLID);
+        gotogxy(0u, 0u);
+        gprintf("%u/%u", (uint16_t)part + 1u, (uint16_t)qr_part_count);
+    }
+    return true;
+}
+
 
-    uint16_t png_file_output_sz = png_indexed_encode();
-    EMU_printf("PNG out sz=%u\n", png_file_output_sz);
+// ===== Idle QR Code pre-generation =====
+// While the drawing sits unchanged the single QR Code export gets made in the background, one
+// bounded slice of work per frame, so START can show it right away:
+// drawing rows read in VBlank -> PNG a few rows at a time -> url appended in chunks -> QR Code finished a step at a time
+enum {
+    PREGEN_STALE,    // Drawing changed, waiting for the user to be idle
+    PREGEN_CAPTURE,
+    PREGEN_PNG,
+    PREGEN_PNG_END,
+    PREGEN_URL,
+    PREGEN_QR,
+    PREGEN_READY,    // QRCODE holds the single QR Code of the current drawing
+    PREGEN_FAILED    // Doesn't fit in a single QR Code, no point trying again until the drawing changes
+};
+
+static uint8_t  pregen_state = PREGEN_STALE;
+static uint8_t  pregen_idle_frames;
+static uint16_t pregen_url_offset;
+static uint16_t pregen_url_len;
+static uint8_t  pregen_url_chunk[QR_PREGEN_URL_CHARS_PER_FRAME];
+
+
+void qrcode_pregen_invalidate(void) BANKED {
+
+    pregen_state       = PREGEN_STALE;
+    pregen_idle_frames = 0u;
+}
+
+
+void qrcode_pregen_set_ready(void) BANKED {
+
+    pregen_state = PREGEN_READY;
+}
+
+
+bool qrcode_pregen_is_ready(void) BANKED {
+
+    return (pregen_state == PREGEN_READY);
+}
+
+
+uint8_t qrcode_pregen_show(void) BANKED {
+
+    #ifdef ENABLE_PROFILER
+        profiler_run_begin(PROF_FLAG_PREGENERATED);
+    #endif
+
+    qr_render();
+    HIDE_SPRITES;
+
+    #ifdef ENABLE_PROFILER
+        profiler_run_end();
+    #endif
+    return 1u;
+}
+
+
+void qrcode_pregen_update(void) BANKED {
+
+    if ((pregen_state == PREGEN_READY) || (pregen_state == PREGEN_FAILED)) return;
+
+    // Only while idle: nothing held and no tool partway through drawing (previews are on screen then).
+    // Any input stops the work right away, it carries on from where it was once the user is idle again
+    if (KEYS() || app_state.tool_currently_drawing) {
+        pregen_idle_frames = 0u;
+        return;
+    }
+    if (pregen_idle_frames < QR_PREGEN_IDLE_FRAMES) {
+        pregen_idle_frames++;
+        return;
+    }
+
+    PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER);
+
+    switch (pregen_state) {
+
+        case PREGEN_STALE:
+            pregen_state = PREGEN_CAPTURE;
+            break;
 
+        case PREGEN_CAPTURE:
+            // The display stays on, so only a few tiles fit in the VBlank this gets called at the start of
+            if (capture_dirty_tiles(true))
+                pregen_state = (capture_png_setup() && png_indexed_encode_begin()) ? PREGEN_PNG : PREGEN_FAILED;
+            break;
 
-    // ===== PNG encoding to Base64 URL =====
-    // printf("Base 64 Encode PNG\n");
-    uint16_t b64_enc_len = base64_encode_to_url(p_base64_png_url_str, p_png_buf, png_file_output_sz);
+        case PREGEN_PNG:
+            if (png_indexed_encode_rows(QR_PREGEN_PNG_ROWS_PER_FRAME)) pregen_state = PREGEN_PNG_END;
+            break;
 
-    EMU_printf("B64 out sz=%u\n", (uint16_t)b64_enc_len);
-    EMU_printf("B64 out:%s\n", p_base64_png_url_str);
+        case PREGEN_PNG_END:
+            png_size = png_indexed_encode_end();
+            if (png_size == 0u) {
+                pregen_state = PREGEN_FAILED;
+                break;
+            }
+
+            qrcodegen_set_structured_append(0u, 0u, 0u);
+            #if (QR_URL_FORMAT == QR_URL_FORMAT_BASE32)
+                pregen_url_len = base32_qr_url_begin(url_base32_prefix, ARRAY_LEN(url_base32_prefix) - 1u, png_size);
+            #else
+                pregen_url_len = base64_qr_url_begin(png_size);
+            #endif
+            pregen_url_offset = 0u;
+            pregen_state = (pregen_url_len) ? PREGEN_URL : PREGEN_FAILED;
+            break;
+
+        case PREGEN_URL: {
+            uint16_t len = url_read_part(pregen_url_chunk, pregen_url_offset, QR_PREGEN_URL_CHARS_PER_FRAME);
+            qrcodegen_stream_append(pregen_url_chunk, len);
+            pregen_url_offset += len;
+            if ((len == 0u) || (pregen_url_offset >= pregen_url_len)) pregen_state = PREGEN_QR;
+            break;
+        }
+
+        case PREGEN_QR:
+            switch (qrcodegen_stream_end_step()) {
+                case QR_STEP_DONE:  pregen_state = PREGEN_READY;
+                                    EMU_printf("QR Code pre-generated\n");
+                                    break;
+                case QR_STEP_ERROR: pregen_state = PREGEN_FAILED;
+                                    break;
+            }
+            break;
+    }
+}
+
+
+uint8_t image_to_png_qrcode_url(uint8_t version_max) BANKED {
+
+    #ifdef ENABLE_PROFILER
+        profiler_run_begin(0u);
+    #endif
+
+    PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER);
+
+    // Output buffer in Cart SRAM, no need to allocate it
+    //
+    // The export is streamed: the PNG is encoded from the capture buffer (only changed tiles
+    // get read from VRAM), and the Base64 url of the PNG is encoded straight into the QR Code data bits.
+    // So the PNG (and its compression staging area) and the capture are the only buffers
+    uint8_t * p_png_buf = (uint8_t *)SRAM_BASE_A000;
 
+    // ===== Drawing to PNG =====
+    // printf("Generating PNG\n");
+    EMU_printf("Generating PNG\n");
+    PROF_BEGIN(PROF_STAGE_CAPTURE);
+    DISPLAY_OFF;
+    capture_dirty_tiles(false);
+    DISPLAY_ON;
+    PROF_END(PROF_STAGE_CAPTURE);
+
+    PROF_BEGIN(PROF_STAGE_PNG);
+    png_size = capture_to_png();
+    PROF_END(PROF_STAGE_PNG);
+    EMU_printf("PNG out sz=%u\n", png_size);
 
-    // TODO: move buffer to SRAM? Possibly overwrite previously generated PNG file output
 
-    // ===== PNG encoding to Base64 URL =====
-    // QR Code is generated in byte mode because:
-    // - Ported C implementation doesn't support other modes
-    // - Alphanumeric mode character set doesn't include all chars needed for base64 encoded strings and mime header chars (;)
+    // ===== PNG encoding to URL, into QR Code =====
+    // The default Base64 data url is generated in byte mode since the alphanumeric mode
+    // character set doesn't include lower case base64 chars or the mime header chars (;).
+    // The Base32 url format is alphanumeric after its prefix (see QR_URL_FORMAT in base32.h)
     //
     color(WHITE, BLACK, SOLID);
     gotogxy(5u,4u);
@@ -145,11 +390,44 @@ void image_to_png_qrcode_url(void) BANKED {
     gprintf("QR Code");
 
     EMU_printf("Generating QR Code\n");
-    if (qr_generate(p_base64_png_url_str, b64_enc_len) ) {
-        EMU_printf("Rendering QR Code\n");
-        qr_render();
-    } else {
-        EMU_printf("QR Code gen Error\n");
+    uint8_t qr_count = 0u;
+
+    // A single QR Code if allowed, and if the url fits
+    if (version_max >= QR_VERSION_MAX) {
+        qrcodegen_set_structured_append(0u, 0u, 0u);
+
+        PROF_BEGIN(PROF_STAGE_BASE64);
+        #if (QR_URL_FORMAT == QR_URL_FORMAT_BASE32)
+            uint16_t b64_enc_len = base32_encode_to_qr_url(url_base32_prefix, ARRAY_LEN(url_base32_prefix) - 1u, p_png_buf, png_size);
+        #else
+            uint16_t b64_enc_len = base64_encode_to_qr_url(p_png_buf, png_size);
+        #endif
+        PROF_END(PROF_STAGE_BASE64);
+        EMU_printf("B64 out sz=%u\n", (uint16_t)b64_enc_len);
+
+        if (b64_enc_len && qr_generate_stream_end()) {
+            EMU_printf("Rendering QR Code\n");
+            PROF_BEGIN(PROF_STAGE_RENDER);
+            qr_render();
+            PROF_END(PROF_STAGE_RENDER);
+            qr_count = 1u;
+        }
+    }
+
+    // Otherwise spread across several smaller QR Codes
+    if (qr_count == 0u) {
+        PROF_BEGIN(PROF_STAGE_BASE64);
+        uint8_t part_count = qr_parts_plan(version_max);
+        PROF_END(PROF_STAGE_BASE64);
+
+        if (part_count && qrcode_show_part(0u)) qr_count = part_count;
+        else EMU_printf("QR Code gen Error\n");
     }
     HIDE_SPRITES;
+
+    #ifdef ENABLE_PROFILER
+        profiler_run_end();
+    #endif
+
+    return qr_count;
 }
@@ -1,6 +1,48 @@
 #ifndef IMG_2_QRCODE_H
 #define IMG_2_QRCODE_H
 
-void image_to_png_qrcode_url(void) BANKED ;
+// Multi QR Code export (SELECT + START): the url is split across QR Codes of at most this version,
+// which are smaller, faster to generate and easier to scan (scanner needs structured append support)
+#ifndef QR_SPLIT_VERSION_MAX
+    #define QR_SPLIT_VERSION_MAX 10u
+#endif
 
-#endif // IMG_2_QRCODE_H
\ No newline at end of file
+// Frames each QR Code of a multi QR Code export is shown before flipping to the next one
+#define QR_CAROUSEL_FRAMES 120u
+
+// Largest QR Code size with room for the "n/N" label in the corner above it
+#define QR_PART_LABEL_SIZE_MAX (DEVICE_SCREEN_PX_WIDTH - (2u * 5u * 8u))
+
+// Idle QR Code pre-generation: frames without input before it starts (or carries on), PNG rows encoded
+// and url chars appended per frame, and the last VBlank line to start reading a tile of the drawing on
+#ifndef QR_PREGEN_IDLE_FRAMES
+    #define QR_PREGEN_IDLE_FRAMES 30u
+#endif
+#define QR_PREGEN_PNG_ROWS_PER_FRAME  8u
+#define QR_PREGEN_URL_CHARS_PER_FRAME 128u
+#define QR_PREGEN_CAPTURE_LY_LAST     151u
+
+// Drawing capture (SRAM_DRAWING_CAPTURE, 1bpp rows) brought up to date with any changed tiles,
+// waits for VBlank as needed. Also the flood fill shadow source, see draw.c
+void drawing_capture_update(void) BANKED;
+
+// Exports the drawing as a PNG url in QR Codes of version_max or lower (QR_VERSION_MAX for a single one
+// when it fits) and shows the first. Returns the number of QR Codes, 0 on error
+uint8_t image_to_png_qrcode_url(uint8_t version_max) BANKED;
+
+// Generates and shows QR Code number part (0 based) of the last multi QR Code export
+bool qrcode_show_part(uint8_t part) BANKED;
+
+// Idle pre-generation of the single QR Code export
+// - qrcode_pregen_update():     call once per frame right after vsync(), does a slice of work while the user is idle
+// - qrcode_pregen_invalidate(): the drawing changed, start over once idle again
+// - qrcode_pregen_is_ready():   the single QR Code of the current drawing is done (in QRCODE)
+// - qrcode_pregen_show():       renders it, returns the QR Code count like image_to_png_qrcode_url()
+// - qrcode_pregen_set_ready():  QRCODE holds the current drawing's single QR Code from a regular export
+void qrcode_pregen_update(void) BANKED;
+void qrcode_pregen_invalidate(void) BANKED;
+bool qrcode_pregen_is_ready(void) BANKED;
+uint8_t qrcode_pregen_show(void) BANKED;
+void qrcode_pregen_set_ready(void) BANKED;
+
+#endif // IMG_2_QRCODE_H
@@ -10,6 +10,8 @@
 #include "ui_main.h"
 #include "save_and_undo.h"
 #include "help_screen.h"
+#include "qrcodegen.h"
+#include "print.h"
 
 #if defined(GAMEBOY) || defined(ANALOGUEPOCKET)
     #include "gb/sgb_features.h"
@@ -24,25 +26,87 @@
     #include "usb_mouse/usb_mouse.h"
 #endif
 
+#ifdef ENABLE_PROFILER
+    #include "profiler.h"
+#endif
+
 
-void make_and_show_qrcode(void);
+void make_and_show_qrcode(uint8_t version_max);
 void sgb_check_and_init(void);
 
 
-void make_and_show_qrcode(void) {
+// Flips through the QR Codes of a multi QR Code export with Left / Right, or on a timer.
+// SELECT prints them all. Returns when any other button is pressed
+static void show_qrcode_carousel(uint8_t qr_count) {
+
+    uint8_t part   = 0u;
+    uint8_t frames = 0u;
+
+    waitpadup_lowcpu(J_ANY);
+    while (1) {
+        vsync(); // yield CPU
+        UPDATE_KEYS();
+
+        if (KEY_TICKED(QR_PRINT_BUTTON)) {
+            print_qrcode(qr_count, part);
+            frames = 0u;
+            continue;
+        }
+        if (GET_KEYS_TICKED(J_ANY & ~J_DPAD)) break;
+
+        if (KEY_TICKED(J_LEFT))
+            part = (part) ? (part - 1u) : (qr_count - 1u);
+        else if (KEY_TICKED(J_RIGHT) || (++frames == QR_CAROUSEL_FRAMES))
+            part = (part + 1u) % qr_count;
+        else continue;
+
+        frames = 0u;
+        qrcode_show_part(part);
+    }
+}
+
+
+// Returns when any button other than SELECT (which prints the QR Code) is pressed
+static void show_qrcode_single(void) {
+
+    waitpadup_lowcpu(J_ANY);
+    while (1) {
+        vsync(); // yield CPU
+        UPDATE_KEYS();
+
+        if (KEY_TICKED(QR_PRINT_BUTTON)) print_qrcode(1u, 0u);
+        else if (GET_KEYS_TICKED(J_ANY)) break;
+    }
+}
+
+
+void make_and_show_qrcode(uint8_t version_max) {
 
     // Cancel any pending tool use
     draw_tools_cancel_and_reset();
 
+    // Checked before the undo snapshot, which marks the drawing as changed
+    bool pregenerated = (version_max >= QR_VERSION_MAX) && qrcode_pregen_is_ready();
+
     drawing_take_undo_snapshot();  // This means generating a QRCode clears out any Redo queue entries that might be present
-    image_to_png_qrcode_url();
+    uint8_t qr_count = (pregenerated) ? qrcode_pregen_show() : image_to_png_qrcode_url(version_max);
     set_pal_qrmode();
 
         // Much more efficient than making a white border by shifting the tile-aligned QRCode output
         scroll_bkg(0,-1);
 
         // Wait for the user to press a button before clearing QRCode
-        waitpadticked_lowcpu(J_ANY);
+        if (qr_count > 1u) show_qrcode_carousel(qr_count);
+        else               show_qrcode_single();
+
+        #ifdef ENABLE_PROFILER
+            // Dismissing with B shows the export stage timings before returning to the drawing
+            if (KEYS() & J_B) {
+                profiler_overlay_show();
+                waitpadup_lowcpu(J_ANY);
+                waitpadticked_lowcpu(J_ANY);
+            }
+        #endif
         waitpadup_lowcpu(J_ANY);
 
         scroll_bkg(0,1);  // Restore default scroll
@@ -51,6 +115,9 @@ void make_and_show_qrcode(void) {
     ui_redraw_full();
     drawing_restore_undo_snapshot(UNDO_RESTORE_WITHOUT_REDO_SNAPSHOT);  // Don't create a Redo snapshot since it would be of the QRCode overlay on the drawing image
 
+    // The drawing is back as it was, so a single QR Code of it is still good for next time
+    if ((version_max >= QR_VERSION_MAX) && (qr_count == 1u)) qrcode_pregen_set_ready();
+
     SHOW_SPRITES;
 }
 
@@ -72,15 +139,22 @@ void main(void)
     PLAT_ENABLE_SRAM;
     PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER); // RAM bank 0
 
+    // QR Code function patterns for the last used version are kept in SRAM between exports (and power cycles)
+    qrcodegen_set_template_cache((uint8_t *)SRAM_QR_TEMPLATE_CACHE, SRAM_QR_TEMPLATE_CACHE_SZ);
+
     if (_cpu == CGB_TYPE) {
         cpu_fast();
     }
+    #ifdef ENABLE_PROFILER
+        profiler_init();
+    #endif
     update_cursor_style_to_draw();
     set_pal_normal();
 
     UPDATE_KEYS();
 
     app_state_reset();
+    undo_init();
     ui_init();
     draw_init();
 
@@ -99,10 +173,12 @@ void main(void)
         ui_update();
 
         if (KEYS() & J_START) {
-            make_and_show_qrcode();
+            // Holding SELECT splits it across several smaller QR Codes
+            make_and_show_qrcode((KEYS() & UI_SHORTCUT_BUTTON) ? QR_SPLIT_VERSION_MAX : QR_VERSION_MAX);
         }
 
         vsync();
+        qrcode_pregen_update();  // Right after vsync() so it starts in VBlank
     }
 }
 
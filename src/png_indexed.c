@@ -9,10 +9,12 @@
 
 #include "common.h"
 #include "png_indexed.h"
+#include "deflate.h"
+#include "profiler.h"
 
 #pragma bank 255  // Autobanked
 
-// == Uncompressed Indexed PNG Export ==
+// == Indexed PNG Export (Uncompressed or Fixed Huffman DEFLATE) ==
 
 
 // The PNG uncompressed indexed color file structure in this implementation:
@@ -28,13 +30,17 @@
 //    - IDAT Payload
 //      - Zlib header (2 bytes)
 //      - Deflate chunks [Now: Only one chunk for the entire image, so max image pixel data payload is 65,535 bytes]
-//        - Final/Non-final indicator (1 byte)
-//        - Deflate Length            (2 bytes)
-//        - Deflate Length xor FF     (2 bytes)
-//          - ALL PNG Scanlines of Row data
-//            - Row start filter[0 for none] (1 bytes)
-//            - Indexed Pixel Row Data       (width's worth of bytes)
-//      - Zlib Adler checksum (4 bytes)
+//        - PNG_COMPRESSION_NONE: Stored block
+//          - Final/Non-final indicator (1 byte)
+//          - Deflate Length            (2 bytes)
+//          - Deflate Length xor FF     (2 bytes)
+//            - ALL PNG Scanlines of Row data
+//              - Row start filter[0 for none] (1 bytes)
+//              - Indexed Pixel Row Data       (width's worth of bytes)
+//        - PNG_COMPRESSION_FIXED_HUFFMAN: Fixed Huffman block (see deflate.c)
+//          - Same Scanline data as above, but LZ77 + Huffman coded into a bitstream
+//          - If that turns out larger than a Stored block then a Stored block is used instead
+//      - Zlib Adler checksum (4 bytes) [Calculated on the uncompressed Scanline data]
 //    - IDAT CRC-32 of chunk type and payload (4 bytes)
 //  - IEND chunk
 
@@ -60,6 +66,10 @@
 
 #define PNG_ROW_FILTER_TYPE_SZ              1u
 #define PNG_ROW_FILTER_TYPE_NONE            0u
+#define PNG_ROW_FILTER_TYPE_SUB             1u
+#define PNG_ROW_FILTER_TYPE_UP              2u
+#define PNG_ROW_FILTER_TYPE_AVERAGE         3u  // Not used
+#define PNG_ROW_FILTER_TYPE_PAETH           4u
 
 // #define PNG_EXPORT_SUPPORTED_MAX_WIDTH      65535u
 
@@ -76,6 +86,8 @@
 
 const uint8_t png_signature[] = {0x89u, 0x50u, 0x4Eu, 0x47u, 0x0Du, 0x0Au, 0x1Au, 0x0Au};
 
+#if (PNG_CRC_ENGINE == PNG_CRC_ENGINE_TABLE32)
+
 static const uint32_t crc32Table[256] = {
     0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3,
     0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988, 0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91,
@@ -111,16 +123,181 @@ static const uint32_t crc32Table[256] = {
     0xb3667a2e, 0xc4614ab8, 0x5d681b02, 0x2a6f2b94, 0xb40bbe37, 0xc30c8ea1, 0x5a05df1b, 0x2d02ef8d
 };
 
+#elif (PNG_CRC_ENGINE == PNG_CRC_ENGINE_BYTE_PLANES)
+
+// Same as the standard 256 x uint32_t CRC-32 table, split into one table per byte of
+// each entry (plane 0 = least significant byte). Uses the same 1K of ROM, but each
+// update is four 8 bit table reads + xors instead of a 32 bit shift and xor
+static const uint8_t crc32_plane_0[256] = {
+    0x00u, 0x96u, 0x2cu, 0xbau, 0x19u, 0x8fu, 0x35u, 0xa3u, 0x32u, 0xa4u, 0x1eu, 0x88u, 0x2bu, 0xbdu, 0x07u, 0x91u,
+    0x64u, 0xf2u, 0x48u, 0xdeu, 0x7du, 0xebu, 0x51u, 0xc7u, 0x56u, 0xc0u, 0x7au, 0xecu, 0x4fu, 0xd9u, 0x63u, 0xf5u,
+    0xc8u, 0x5eu, 0xe4u, 0x72u, 0xd1u, 0x47u, 0xfdu, 0x6bu, 0xfau, 0x6cu, 0xd6u, 0x40u, 0xe3u, 0x75u, 0xcfu, 0x59u,
+    0xacu, 0x3au, 0x80u, 0x16u, 0xb5u, 0x23u, 0x99u, 0x0fu, 0x9eu, 0x08u, 0xb2u, 0x24u, 0x87u, 0x11u, 0xabu, 0x3du,
+    0x90u, 0x06u, 0xbcu, 0x2au, 0x89u, 0x1fu, 0xa5u, 0x33u, 0xa2u, 0x34u, 0x8eu, 0x18u, 0xbbu, 0x2du, 0x97u, 0x01u,
+    0xf4u, 0x62u, 0xd8u, 0x4eu, 0xedu, 0x7bu, 0xc1u, 0x57u, 0xc6u, 0x50u, 0xeau, 0x7cu, 0xdfu, 0x49u, 0xf3u, 0x65u,
+    0x58u, 0xceu, 0x74u, 0xe2u, 0x41u, 0xd7u, 0x6du, 0xfbu, 0x6au, 0xfcu, 0x46u, 0xd0u, 0x73u, 0xe5u, 0x5fu, 0xc9u,
+    0x3cu, 0xaau, 0x10u, 0x86u, 0x25u, 0xb3u, 0x09u, 0x9fu, 0x0eu, 0x98u, 0x22u, 0xb4u, 0x17u, 0x81u, 0x3bu, 0xadu,
+    0x20u, 0xb6u, 0x0cu, 0x9au, 0x39u, 0xafu, 0x15u, 0x83u, 0x12u, 0x84u, 0x3eu, 0xa8u, 0x0bu, 0x9du, 0x27u, 0xb1u,
+    0x44u, 0xd2u, 0x68u, 0xfeu, 0x5du, 0xcbu, 0x71u, 0xe7u, 0x76u, 0xe0u, 0x5au, 0xccu, 0x6fu, 0xf9u, 0x43u, 0xd5u,
+    0xe8u, 0x7eu, 0xc4u, 0x52u, 0xf1u, 0x67u, 0xddu, 0x4bu, 0xdau, 0x4cu, 0xf6u, 0x60u, 0xc3u, 0x55u, 0xefu, 0x79u,
+    0x8cu, 0x1au, 0xa0u, 0x36u, 0x95u, 0x03u, 0xb9u, 0x2fu, 0xbeu, 0x28u, 0x92u, 0x04u, 0xa7u, 0x31u, 0x8bu, 0x1du,
+    0xb0u, 0x26u, 0x9cu, 0x0au, 0xa9u, 0x3fu, 0x85u, 0x13u, 0x82u, 0x14u, 0xaeu, 0x38u, 0x9bu, 0x0du, 0xb7u, 0x21u,
+    0xd4u, 0x42u, 0xf8u, 0x6eu, 0xcdu, 0x5bu, 0xe1u, 0x77u, 0xe6u, 0x70u, 0xcau, 0x5cu, 0xffu, 0x69u, 0xd3u, 0x45u,
+    0x78u, 0xeeu, 0x54u, 0xc2u, 0x61u, 0xf7u, 0x4du, 0xdbu, 0x4au, 0xdcu, 0x66u, 0xf0u, 0x53u, 0xc5u, 0x7fu, 0xe9u,
+    0x1cu, 0x8au, 0x30u, 0xa6u, 0x05u, 0x93u, 0x29u, 0xbfu, 0x2eu, 0xb8u, 0x02u, 0x94u, 0x37u, 0xa1u, 0x1bu, 0x8du,
+};
 
+static const uint8_t crc32_plane_1[256] = {
+    0x00u, 0x30u, 0x61u, 0x51u, 0xc4u, 0xf4u, 0xa5u, 0x95u, 0x88u, 0xb8u, 0xe9u, 0xd9u, 0x4cu, 0x7cu, 0x2du, 0x1du,
+    0x10u, 0x20u, 0x71u, 0x41u, 0xd4u, 0xe4u, 0xb5u, 0x85u, 0x98u, 0xa8u, 0xf9u, 0xc9u, 0x5cu, 0x6cu, 0x3du, 0x0du,
+    0x20u, 0x10u, 0x41u, 0x71u, 0xe4u, 0xd4u, 0x85u, 0xb5u, 0xa8u, 0x98u, 0xc9u, 0xf9u, 0x6cu, 0x5cu, 0x0du, 0x3du,
+    0x30u, 0x00u, 0x51u, 0x61u, 0xf4u, 0xc4u, 0x95u, 0xa5u, 0xb8u, 0x88u, 0xd9u, 0xe9u, 0x7cu, 0x4cu, 0x1du, 0x2du,
+    0x41u, 0x71u, 0x20u, 0x10u, 0x85u, 0xb5u, 0xe4u, 0xd4u, 0xc9u, 0xf9u, 0xa8u, 0x98u, 0x0du, 0x3du, 0x6cu, 0x5cu,
+    0x51u, 0x61u, 0x30u, 0x00u, 0x95u, 0xa5u, 0xf4u, 0xc4u, 0xd9u, 0xe9u, 0xb8u, 0x88u, 0x1du, 0x2du, 0x7cu, 0x4cu,
+    0x61u, 0x51u, 0x00u, 0x30u, 0xa5u, 0x95u, 0xc4u, 0xf4u, 0xe9u, 0xd9u, 0x88u, 0xb8u, 0x2du, 0x1du, 0x4cu, 0x7cu,
+    0x71u, 0x41u, 0x10u, 0x20u, 0xb5u, 0x85u, 0xd4u, 0xe4u, 0xf9u, 0xc9u, 0x98u, 0xa8u, 0x3du, 0x0du, 0x5cu, 0x6cu,
+    0x83u, 0xb3u, 0xe2u, 0xd2u, 0x47u, 0x77u, 0x26u, 0x16u, 0x0bu, 0x3bu, 0x6au, 0x5au, 0xcfu, 0xffu, 0xaeu, 0x9eu,
+    0x93u, 0xa3u, 0xf2u, 0xc2u, 0x57u, 0x67u, 0x36u, 0x06u, 0x1bu, 0x2bu, 0x7au, 0x4au, 0xdfu, 0xefu, 0xbeu, 0x8eu,
+    0xa3u, 0x93u, 0xc2u, 0xf2u, 0x67u, 0x57u, 0x06u, 0x36u, 0x2bu, 0x1bu, 0x4au, 0x7au, 0xefu, 0xdfu, 0x8eu, 0xbeu,
+    0xb3u, 0x83u, 0xd2u, 0xe2u, 0x77u, 0x47u, 0x16u, 0x26u, 0x3bu, 0x0bu, 0x5au, 0x6au, 0xffu, 0xcfu, 0x9eu, 0xaeu,
+    0xc2u, 0xf2u, 0xa3u, 0x93u, 0x06u, 0x36u, 0x67u, 0x57u, 0x4au, 0x7au, 0x2bu, 0x1bu, 0x8eu, 0xbeu, 0xefu, 0xdfu,
+    0xd2u, 0xe2u, 0xb3u, 0x83u, 0x16u, 0x26u, 0x77u, 0x47u, 0x5au, 0x6au, 0x3bu, 0x0bu, 0x9eu, 0xaeu, 0xffu, 0xcfu,
+    0xe2u, 0xd2u, 0x83u, 0xb3u, 0x26u, 0x16u, 0x47u, 0x77u, 0x6au, 0x5au, 0x0bu, 0x3bu, 0xaeu, 0x9eu, 0xcfu, 0xffu,
+    0xf2u, 0xc2u, 0x93u, 0xa3u, 0x36u, 0x06u, 0x57u, 0x67u, 0x7au, 0x4au, 0x1bu, 0x2bu, 0xbeu, 0x8eu, 0xdfu, 0xefu,
+};
 
-static png_data_t png;
+static const uint8_t crc32_plane_2[256] = {
+    0x00u, 0x07u, 0x0eu, 0x09u, 0x6du, 0x6au, 0x63u, 0x64u, 0xdbu, 0xdcu, 0xd5u, 0xd2u, 0xb6u, 0xb1u, 0xb8u, 0xbfu,
+    0xb7u, 0xb0u, 0xb9u, 0xbeu, 0xdau, 0xddu, 0xd4u, 0xd3u, 0x6cu, 0x6bu, 0x62u, 0x65u, 0x01u, 0x06u, 0x0fu, 0x08u,
+    0x6eu, 0x69u, 0x60u, 0x67u, 0x03u, 0x04u, 0x0du, 0x0au, 0xb5u, 0xb2u, 0xbbu, 0xbcu, 0xd8u, 0xdfu, 0xd6u, 0xd1u,
+    0xd9u, 0xdeu, 0xd7u, 0xd0u, 0xb4u, 0xb3u, 0xbau, 0xbdu, 0x02u, 0x05u, 0x0cu, 0x0bu, 0x6fu, 0x68u, 0x61u, 0x66u,
+    0xdcu, 0xdbu, 0xd2u, 0xd5u, 0xb1u, 0xb6u, 0xbfu, 0xb8u, 0x07u, 0x00u, 0x09u, 0x0eu, 0x6au, 0x6du, 0x64u, 0x63u,
+    0x6bu, 0x6cu, 0x65u, 0x62u, 0x06u, 0x01u, 0x08u, 0x0fu, 0xb0u, 0xb7u, 0xbeu, 0xb9u, 0xddu, 0xdau, 0xd3u, 0xd4u,
+    0xb2u, 0xb5u, 0xbcu, 0xbbu, 0xdfu, 0xd8u, 0xd1u, 0xd6u, 0x69u, 0x6eu, 0x67u, 0x60u, 0x04u, 0x03u, 0x0au, 0x0du,
+    0x05u, 0x02u, 0x0bu, 0x0cu, 0x68u, 0x6fu, 0x66u, 0x61u, 0xdeu, 0xd9u, 0xd0u, 0xd7u, 0xb3u, 0xb4u, 0xbdu, 0xbau,
+    0xb8u, 0xbfu, 0xb6u, 0xb1u, 0xd5u, 0xd2u, 0xdbu, 0xdcu, 0x63u, 0x64u, 0x6du, 0x6au, 0x0eu, 0x09u, 0x00u, 0x07u,
+    0x0fu, 0x08u, 0x01u, 0x06u, 0x62u, 0x65u, 0x6cu, 0x6bu, 0xd4u, 0xd3u, 0xdau, 0xddu, 0xb9u, 0xbeu, 0xb7u, 0xb0u,
+    0xd6u, 0xd1u, 0xd8u, 0xdfu, 0xbbu, 0xbcu, 0xb5u, 0xb2u, 0x0du, 0x0au, 0x03u, 0x04u, 0x60u, 0x67u, 0x6eu, 0x69u,
+    0x61u, 0x66u, 0x6fu, 0x68u, 0x0cu, 0x0bu, 0x02u, 0x05u, 0xbau, 0xbdu, 0xb4u, 0xb3u, 0xd7u, 0xd0u, 0xd9u, 0xdeu,
+    0x64u, 0x63u, 0x6au, 0x6du, 0x09u, 0x0eu, 0x07u, 0x00u, 0xbfu, 0xb8u, 0xb1u, 0xb6u, 0xd2u, 0xd5u, 0xdcu, 0xdbu,
+    0xd3u, 0xd4u, 0xddu, 0xdau, 0xbeu, 0xb9u, 0xb0u, 0xb7u, 0x08u, 0x0fu, 0x06u, 0x01u, 0x65u, 0x62u, 0x6bu, 0x6cu,
+    0x0au, 0x0du, 0x04u, 0x03u, 0x67u, 0x60u, 0x69u, 0x6eu, 0xd1u, 0xd6u, 0xdfu, 0xd8u, 0xbcu, 0xbbu, 0xb2u, 0xb5u,
+    0xbdu, 0xbau, 0xb3u, 0xb4u, 0xd0u, 0xd7u, 0xdeu, 0xd9u, 0x66u, 0x61u, 0x68u, 0x6fu, 0x0bu, 0x0cu, 0x05u, 0x02u,
+};
+
+static const uint8_t crc32_plane_3[256] = {
+    0x00u, 0x77u, 0xeeu, 0x99u, 0x07u, 0x70u, 0xe9u, 0x9eu, 0x0eu, 0x79u, 0xe0u, 0x97u, 0x09u, 0x7eu, 0xe7u, 0x90u,
+    0x1du, 0x6au, 0xf3u, 0x84u, 0x1au, 0x6du, 0xf4u, 0x83u, 0x13u, 0x64u, 0xfdu, 0x8au, 0x14u, 0x63u, 0xfau, 0x8du,
+    0x3bu, 0x4cu, 0xd5u, 0xa2u, 0x3cu, 0x4bu, 0xd2u, 0xa5u, 0x35u, 0x42u, 0xdbu, 0xacu, 0x32u, 0x45u, 0xdcu, 0xabu,
+    0x26u, 0x51u, 0xc8u, 0xbfu, 0x21u, 0x56u, 0xcfu, 0xb8u, 0x28u, 0x5fu, 0xc6u, 0xb1u, 0x2fu, 0x58u, 0xc1u, 0xb6u,
+    0x76u, 0x01u, 0x98u, 0xefu, 0x71u, 0x06u, 0x9fu, 0xe8u, 0x78u, 0x0fu, 0x96u, 0xe1u, 0x7fu, 0x08u, 0x91u, 0xe6u,
+    0x6bu, 0x1cu, 0x85u, 0xf2u, 0x6cu, 0x1bu, 0x82u, 0xf5u, 0x65u, 0x12u, 0x8bu, 0xfcu, 0x62u, 0x15u, 0x8cu, 0xfbu,
+    0x4du, 0x3au, 0xa3u, 0xd4u, 0x4au, 0x3du, 0xa4u, 0xd3u, 0x43u, 0x34u, 0xadu, 0xdau, 0x44u, 0x33u, 0xaau, 0xddu,
+    0x50u, 0x27u, 0xbeu, 0xc9u, 0x57u, 0x20u, 0xb9u, 0xceu, 0x5eu, 0x29u, 0xb0u, 0xc7u, 0x59u, 0x2eu, 0xb7u, 0xc0u,
+    0xedu, 0x9au, 0x03u, 0x74u, 0xeau, 0x9du, 0x04u, 0x73u, 0xe3u, 0x94u, 0x0du, 0x7au, 0xe4u, 0x93u, 0x0au, 0x7du,
+    0xf0u, 0x87u, 0x1eu, 0x69u, 0xf7u, 0x80u, 0x19u, 0x6eu, 0xfeu, 0x89u, 0x10u, 0x67u, 0xf9u, 0x8eu, 0x17u, 0x60u,
+    0xd6u, 0xa1u, 0x38u, 0x4fu, 0xd1u, 0xa6u, 0x3fu, 0x48u, 0xd8u, 0xafu, 0x36u, 0x41u, 0xdfu, 0xa8u, 0x31u, 0x46u,
+    0xcbu, 0xbcu, 0x25u, 0x52u, 0xccu, 0xbbu, 0x22u, 0x55u, 0xc5u, 0xb2u, 0x2bu, 0x5cu, 0xc2u, 0xb5u, 0x2cu, 0x5bu,
+    0x9bu, 0xecu, 0x75u, 0x02u, 0x9cu, 0xebu, 0x72u, 0x05u, 0x95u, 0xe2u, 0x7bu, 0x0cu, 0x92u, 0xe5u, 0x7cu, 0x0bu,
+    0x86u, 0xf1u, 0x68u, 0x1fu, 0x81u, 0xf6u, 0x6fu, 0x18u, 0x88u, 0xffu, 0x66u, 0x11u, 0x8fu, 0xf8u, 0x61u, 0x16u,
+    0xa0u, 0xd7u, 0x4eu, 0x39u, 0xa7u, 0xd0u, 0x49u, 0x3eu, 0xaeu, 0xd9u, 0x40u, 0x37u, 0xa9u, 0xdeu, 0x47u, 0x30u,
+    0xbdu, 0xcau, 0x53u, 0x24u, 0xbau, 0xcdu, 0x54u, 0x23u, 0xb3u, 0xc4u, 0x5du, 0x2au, 0xb4u, 0xc3u, 0x5au, 0x2du,
+};
+
+#elif (PNG_CRC_ENGINE == PNG_CRC_ENGINE_NIBBLE)
+
+// CRC-32 of the 16 possible 4 bit values, two lookups per byte
+static const uint32_t crc32_nibble_table[16] = {
+    0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac,
+    0x76dc4190, 0x6b6b51f4, 0x4db26158, 0x5005713c,
+    0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+    0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c,
+};
 
-static uint32_t zlib_adler_a;
-static uint32_t zlib_adler_b;
+#else
+    #error "Unknown PNG_CRC_ENGINE"
+#endif
 
 
 
-static uint16_t calc_zlib_pixel_data_size(uint8_t width, uint8_t height, const uint8_t bpp);
+static png_data_t png;
+
+// The row above the first one, all zeros (filters need the row above)
+static uint8_t png_row_zero[PNG_ROW_BUF_SZ_MAX];
+
+// Where the encoding is at between png_indexed_encode_rows() calls
+static struct {
+    uint8_t       * p_zlib_out_buf;
+    const uint8_t * p_zlib_out_buf_start;
+    const uint8_t * p_zlib_adler_start;     // Start of the scanlines
+    uint8_t       * p_scanlines;            // Next scanline byte
+    const uint8_t * p_src_image_pixels;     // Next source row
+    const uint8_t * p_row_prev;
+    uint8_t         pack_width;
+    uint8_t         filter_type;
+    uint8_t         y;
+    bool            crc_inline;
+} png_enc;
+// Filtered row output (not used for filter type None)
+static uint8_t png_row_filtered[PNG_ROW_BUF_SZ_MAX];
+
+// Adler-32 with deferred modulo
+//
+// Bytes get summed into 16 bit block sums (s1 = sum of bytes, s2 = sum of the running s1)
+// which are only folded into the (always reduced) a and b sums once per block:
+//   b = b + (block_len * a) + s2
+//   a = a + s1
+// s2 is the one that limits the block size, worst case is 255 * n(n+1)/2 <= 65535 -> n <= 22
+#define ADLER_MOD           65521u
+#define ADLER_BLOCK_LEN_MAX 22u
+
+static uint16_t zlib_adler_a;
+static uint16_t zlib_adler_b;
+
+static uint16_t adler_block_s1;
+static uint16_t adler_block_s2;
+static uint8_t  adler_block_len;
+
+// Used inline by the scanline packing so each byte is only touched once
+#define ADLER_ADD_BYTE(value) do { \
+    adler_block_s1 += (value); \
+    adler_block_s2 += adler_block_s1; \
+    if (++adler_block_len == ADLER_BLOCK_LEN_MAX) adler_fold_block(); \
+} while (0)
+
+
+// Running CRC-32 (before the final inversion)
+// BYTE_PLANES keeps it as separate bytes (crc_b0 = least significant) so there are no 32 bit shifts
+#if (PNG_CRC_ENGINE == PNG_CRC_ENGINE_BYTE_PLANES)
+    static uint8_t crc_b0, crc_b1, crc_b2, crc_b3;
+
+    #define CRC32_ADD_BYTE(value) do { \
+        uint8_t crc_idx = crc_b0 ^ (value); \
+        crc_b0 = crc_b1 ^ crc32_plane_0[crc_idx]; \
+        crc_b1 = crc_b2 ^ crc32_plane_1[crc_idx]; \
+        crc_b2 = crc_b3 ^ crc32_plane_2[crc_idx]; \
+        crc_b3 =          crc32_plane_3[crc_idx]; \
+    } while (0)
+#else
+    static uint32_t crc_value;
+
+    #if (PNG_CRC_ENGINE == PNG_CRC_ENGINE_TABLE32)
+        #define CRC32_ADD_BYTE(value) \
+            crc_value = (crc_value >> 8) ^ crc32Table[(uint8_t)crc_value ^ (value)]
+    #else
+        // Low nibble first, same as shifting the byte in one bit at a time LSB first
+        #define CRC32_ADD_BYTE(value) do { \
+            uint8_t crc_in = (value); \
+            crc_value = (crc_value >> 4) ^ crc32_nibble_table[((uint8_t)crc_value ^ crc_in) & 0x0Fu]; \
+            crc_value = (crc_value >> 4) ^ crc32_nibble_table[((uint8_t)crc_value ^ (crc_in >> 4)) & 0x0Fu]; \
+        } while (0)
+    #endif
+#endif
+
+
+
+static uint16_t calc_scanlines_size(uint8_t width, uint8_t height, const uint8_t bpp);
+static uint16_t calc_zlib_pixel_data_size(uint16_t scanlines_size);
 static uint16_t calc_idat_payload_start_offset(uint8_t palette_data_byte_len);
 static uint16_t calc_max_file_size(uint8_t palette_data_byte_len, uint16_t zlibPixelRows_maxSize);
 
@@ -129,12 +306,22 @@ static uint8_t * write_u16_be(uint8_t * outBuffer, uint16_t value);
 static uint8_t * write_u32_be(uint8_t * outBuffer, uint32_t value);
 
 static void adler_reset(void);
-static void adler_crc_update(uint8_t * buffer, uint16_t buffer_sz);
+static void adler_fold_block(void);
+static void adler_finish(void);
 
+static void crc32_reset(void);
+static void crc32_update(const uint8_t * p_buffer, uint16_t buffer_sz);
+static uint32_t crc32_result(void);
 static uint32_t crc32(const uint8_t * p_buffer, uint16_t buffer_sz);
 static uint8_t * png_write_chunk(uint8_t * p_out_buf, const char * type, const uint8_t * p_payload, const uint16_t payload_sz);
+static uint8_t * png_write_chunk_crc_ready(uint8_t * p_out_buf, const char * type, const uint16_t payload_sz, const uint32_t checksum);
 
-static uint16_t prepare_pixel_data_1bpp_src_and_1bpp_out(void);
+static uint8_t png_filter_select(const uint8_t * p_row, const uint8_t * p_row_prev, uint8_t row_len);
+static const uint8_t * png_filter_apply(uint8_t filter_type, const uint8_t * p_row, const uint8_t * p_row_prev, uint8_t row_len);
+
+static bool     prepare_pixel_data_1bpp_src_and_1bpp_out_begin(void);
+static bool     prepare_pixel_data_1bpp_src_and_1bpp_out_rows(uint8_t row_count);
+static uint16_t prepare_pixel_data_1bpp_src_and_1bpp_out_end(void);
 static uint16_t prepare_pixel_data_8bpp_src(void);
 
 
@@ -153,22 +340,31 @@ static uint16_t prepare_pixel_data_8bpp_src(void);
 // - palette_data_byte_len: size of palette data array in RGB888 format (so, 4 colors = 4 * 3 = 12)
 // - bpp:                Must be 1, 2, 4 or 8
 // - width & height:     8 bit only for now
-uint16_t png_indexed_init(uint8_t width, uint8_t height, uint8_t in_bpp, uint8_t out_bpp, uint16_t palette_data_byte_len) BANKED {
+// - compression:        PNG_COMPRESSION_NONE or PNG_COMPRESSION_FIXED_HUFFMAN
+uint16_t png_indexed_init(uint8_t width, uint8_t height, uint8_t in_bpp, uint8_t out_bpp, uint16_t palette_data_byte_len, uint8_t compression, uint8_t filter_mode) BANKED {
 
     // Clamp to max colors allowed by bpp
-    png.width   = width;
-    png.height  = height;
-    png.in_bpp  = in_bpp;
-    png.out_bpp = out_bpp;
+    png.width       = width;
+    png.height      = height;
+    png.in_bpp      = in_bpp;
+    png.out_bpp     = out_bpp;
+    png.compression = compression;
+    png.filter_mode = filter_mode;
 
     uint16_t bpp_palette_len_max = (1 << out_bpp) * PNG_PAL_RGB888_SZ;
     if (palette_data_byte_len > bpp_palette_len_max) palette_data_byte_len = bpp_palette_len_max;
     png.palette_data_byte_len = palette_data_byte_len;
 
     // Calc max sizes
-    png.zlib_pixel_rows_max_size = calc_zlib_pixel_data_size(width, height, out_bpp);
+    // Compressed output is never allowed to grow past the Stored block size (it falls back to Stored instead)
+    png.scanlines_size           = calc_scanlines_size(width, height, out_bpp);
+    png.zlib_pixel_rows_max_size = calc_zlib_pixel_data_size(png.scanlines_size);
     png.file_max_size            = calc_max_file_size(png.palette_data_byte_len, png.zlib_pixel_rows_max_size);
 
+    // When compressing the uncompressed scanlines are staged at the end of the output buffer
+    if (compression != PNG_COMPRESSION_NONE)
+        png.file_max_size += png.scanlines_size;
+
     png.calc_initialized = true;
 
     return png.file_max_size;
@@ -192,23 +388,23 @@ void png_indexed_set_buffers(uint8_t * p_img_palette_data, uint8_t * p_img_pixel
 
 
 
-// Pre-calc the max size for zlib encapsulated pixel data
-static uint16_t calc_zlib_pixel_data_size(uint8_t width, uint8_t height, const uint8_t bpp) {
-    // For Indexed Pixel data, encode each scanline row as a separate
-    // zlib chunk which makes it easier to pack it all together.
-    // Tuck the PNG row data into that
+// Size of all PNG scanlines: row filter type bytes + bit packed pixel data
+static uint16_t calc_scanlines_size(uint8_t width, uint8_t height, const uint8_t bpp) {
+
     const uint8_t pixels_per_byte = 8 / bpp;
 
-    const uint16_t deflate_chunk_sz  = height * (PNG_ROW_FILTER_TYPE_SZ + ((width + (pixels_per_byte - 1)) / pixels_per_byte));  // Needs to be rounded up in case it's not an even multiple of pixels_per_byte
-    const uint16_t zlib_row_chunk_sz = DEFLATE_HEADER_SZ + deflate_chunk_sz;
-    const uint16_t zlib_total_size   = ZLIB_HEADER_SZ + (zlib_row_chunk_sz * height) + ZLIB_FOOTER_SZ;
+    // Needs to be rounded up in case it's not an even multiple of pixels_per_byte
+    return height * (PNG_ROW_FILTER_TYPE_SZ + ((width + (pixels_per_byte - 1)) / pixels_per_byte));
+}
+
 
-    // DEBUG: printf("fmax_dfz=%u\n"
-       // "zck=%u, "
-       // "zts=%u\n\n",
-       // (uint16_t)deflate_chunk_sz,
-       // (uint16_t)zlib_row_chunk_sz,
-       // (uint16_t)zlib_total_size);
+// Pre-calc the max size for zlib encapsulated pixel data
+static uint16_t calc_zlib_pixel_data_size(uint16_t scanlines_size) {
+    // All scanline rows are packed into a single Stored DEFLATE block,
+    // which is also the upper bound for compressed output
+    const uint16_t zlib_total_size = ZLIB_HEADER_SZ + DEFLATE_HEADER_SZ + scanlines_size + ZLIB_FOOTER_SZ;
+
+    // DEBUG: printf("zts=%u\n\n", (uint16_t)zlib_total_size);
 
     return zlib_total_size;
 }
@@ -263,21 +459,40 @@ static uint8_t * write_u32_be(uint8_t * outBuffer, uint32_t value) {
     return outBuffer;
 }
 
-// Look into Alternate delayed modulo version?
 static void adler_reset(void) {
     zlib_adler_a = 1u, zlib_adler_b = 0u;
+    adler_block_s1 = 0u, adler_block_s2 = 0u, adler_block_len = 0u;
 }
 
-// TODO: OPTIMIZE: 32 bit modulo is going to be brutal (optimizations for this?)
-static void adler_crc_update(uint8_t * buffer, uint16_t buffer_sz) {
 
-    // DEBUG: printf("ssz->%u:,", buffer_sz);
-    for (uint16_t i = 0u; i < buffer_sz; i++ ) {
-         zlib_adler_a = (zlib_adler_a + buffer[i]) % 65521u;
-         zlib_adler_b = (zlib_adler_b + zlib_adler_a) % 65521u;
-         // DEBUG: printf("%hu,", (uint8_t)buffer[i]);
-    }
-    // DEBUG: printf("==\n");
+// Reduce modulo 65521 without a 32 bit divide: 65536 == 15 (mod 65521),
+// so the upper 16 bits can be folded down as (upper * 15) until nothing is left there
+static uint16_t adler_mod(uint32_t value) {
+
+    while (value >> 16)
+        value = ((uint16_t)(value >> 16) * 15u) + (uint16_t)value;
+
+    if ((uint16_t)value >= ADLER_MOD) value -= ADLER_MOD;
+    return (uint16_t)value;
+}
+
+
+// Fold the current block sums into the Adler a and b sums
+static void adler_fold_block(void) {
+
+    zlib_adler_b = adler_mod(((uint32_t)zlib_adler_a * adler_block_len) + zlib_adler_b + adler_block_s2);
+    zlib_adler_a = adler_mod((uint32_t)zlib_adler_a + adler_block_s1);
+
+    adler_block_s1 = 0u, adler_block_s2 = 0u, adler_block_len = 0u;
+}
+
+
+// Folds in any partial block, must be called before using zlib_adler_a/b
+static void adler_finish(void) {
+
+    PROF_BEGIN(PROF_STAGE_ADLER);
+    if (adler_block_len) adler_fold_block();
+    PROF_END(PROF_STAGE_ADLER);
 }
 
 
@@ -286,15 +501,41 @@ static void adler_crc_update(uint8_t * buffer, uint16_t buffer_sz) {
 // Posted by Denys Séguret, modified by community. See post 'Timeline' for change history
 // Retrieved 2026-01-01, License - CC BY-SA 3.0
 //
-uint32_t crc32(const uint8_t * p_buffer, uint16_t buffer_sz) {
+// Incremental version: crc32_reset(), then any mix of crc32_update() / CRC32_ADD_BYTE(), then crc32_result()
+static void crc32_reset(void) {
+    #if (PNG_CRC_ENGINE == PNG_CRC_ENGINE_BYTE_PLANES)
+        crc_b0 = crc_b1 = crc_b2 = crc_b3 = 0xFFu;
+    #else
+        crc_value = 0xFFFFFFFF;
+    #endif
+}
 
-    uint32_t crc =  0xFFFFFFFF;
 
-    for (uint16_t i = 0u; i < buffer_sz; i++ ) {
-        crc = (crc >> 8) ^ crc32Table[(crc ^ p_buffer[i]) & 0xFFu];
+static void crc32_update(const uint8_t * p_buffer, uint16_t buffer_sz) {
+
+    PROF_BEGIN(PROF_STAGE_CRC);
+    while (buffer_sz--) {
+        CRC32_ADD_BYTE(*p_buffer++);
     }
+    PROF_END(PROF_STAGE_CRC);
+}
+
 
-    return (crc ^ 0xFFFFFFFF);
+static uint32_t crc32_result(void) {
+    #if (PNG_CRC_ENGINE == PNG_CRC_ENGINE_BYTE_PLANES)
+        return ((uint32_t)(crc_b3 ^ 0xFFu) << 24) | ((uint32_t)(crc_b2 ^ 0xFFu) << 16)
+               | ((uint16_t)(crc_b1 ^ 0xFFu) << 8) | (uint8_t)(crc_b0 ^ 0xFFu);
+    #else
+        return (crc_value ^ 0xFFFFFFFF);
+    #endif
+}
+
+
+static uint32_t crc32(const uint8_t * p_buffer, uint16_t buffer_sz) {
+
+    crc32_reset();
+    crc32_update(p_buffer, buffer_sz);
+    return crc32_result();
 }
 
 
@@ -321,6 +562,19 @@ static uint8_t * png_write_chunk(uint8_t * p_out_buf, const char * type, const u
 }
 
 
+// For a payload that's already in place and had its checksum (of type + payload)
+// calculated while it was being written, so it doesn't get read a second time
+static uint8_t * png_write_chunk_crc_ready(uint8_t * p_out_buf, const char * type, const uint16_t payload_sz, const uint32_t checksum) {
+
+    p_out_buf = write_u32_be(p_out_buf, payload_sz);
+    memcpy(p_out_buf, type, PNG_CHUNK_TYPE_SZ);
+    p_out_buf += PNG_CHUNK_TYPE_SZ + payload_sz;
+    p_out_buf = write_u32_be(p_out_buf, checksum);
+
+    return p_out_buf;
+}
+
+
 
 /*
 
@@ -434,7 +688,10 @@ static uint16_t prepare_pixel_data_8bpp_src(void) {
     // (uint16_t)(p_zlib_out_buf - p_zlib_adler_start));
 
     // Adler checksum for all DEFLATE payload data (excluding last chunk indicators and size headers)
-    adler_crc_update(p_zlib_adler_start, (p_zlib_out_buf - p_zlib_adler_start)); // Length calc is not +1 since pointer is already at byte after end of adler range
+    for (const uint8_t * p_adler = p_zlib_adler_start; p_adler < p_zlib_out_buf; p_adler++) {
+        ADLER_ADD_BYTE(*p_adler);
+    }
+    adler_finish();
 
     // printf("ad a=%x,b=%x\n",
     //        (uint16_t)zlib_adler_a,
@@ -455,14 +712,117 @@ static uint16_t prepare_pixel_data_8bpp_src(void) {
 */
 
 
+// Writes the Stored block header for the scanline data, it immediately follows
+static uint8_t * write_deflate_stored_header(uint8_t * p_zlib_out_buf, uint16_t deflate_chunk_sz) {
+
+    // To save space this now uses a single DEFLATE block for all pixel data, so the limit is 65,535 bytes
+    // Deflate Header
+    *p_zlib_out_buf++ = DEFLATE_HEADER_FINAL_YES;
+    //
+    p_zlib_out_buf = write_u16_le(p_zlib_out_buf, deflate_chunk_sz);
+    p_zlib_out_buf = write_u16_le(p_zlib_out_buf, deflate_chunk_sz ^ 0xFFFFu);
+
+    return p_zlib_out_buf;
+}
+
+
+// PNG row filters work on whole bytes when bpp < 8, so for packed 1bpp rows:
+// a = byte to the left, b = byte above, c = byte above and to the left (0 when outside the image)
+static uint8_t paeth_predictor(uint8_t a, uint8_t b, uint8_t c) {
+
+    // p = a + b - c, distances are then: |p - a| = |b - c|, |p - b| = |a - c|, |p - c| = |(b - c) + (a - c)|
+    int16_t dist_b_c = (int16_t)b - c;
+    int16_t dist_a_c = (int16_t)a - c;
+    int16_t pc = dist_b_c + dist_a_c;
+
+    uint16_t pa = (dist_b_c < 0) ? -dist_b_c : dist_b_c;
+    uint16_t pb = (dist_a_c < 0) ? -dist_a_c : dist_a_c;
+    if (pc < 0) pc = -pc;
+
+    if ((pa <= pb) && (pa <= (uint16_t)pc)) return a;
+    else if (pb <= (uint16_t)pc)            return b;
+    else                                    return c;
+}
+
+
+// Picks the filter that produces the most zero bytes for the row,
+// cheap to score and zero runs are what DEFLATE's LZ77 matches best
+static uint8_t png_filter_select(const uint8_t * p_row, const uint8_t * p_row_prev, uint8_t row_len) {
+
+    uint8_t zeros_none = 0u, zeros_sub = 0u, zeros_up = 0u, zeros_paeth = 0u;
+    uint8_t a = 0u, c = 0u;
+
+    while (row_len--) {
+        uint8_t x = *p_row++;
+        uint8_t b = *p_row_prev++;
+
+        if (x == 0u)                           zeros_none++;
+        if (x == a)                            zeros_sub++;
+        if (x == b)                            zeros_up++;
+        if (x == paeth_predictor(a, b, c))     zeros_paeth++;
+
+        a = x;
+        c = b;
+    }
+
+    // Ties go to the simpler filter
+    uint8_t filter_type = PNG_ROW_FILTER_TYPE_NONE;
+    uint8_t best = zeros_none;
+    if (zeros_sub   > best) { best = zeros_sub;   filter_type = PNG_ROW_FILTER_TYPE_SUB; }
+    if (zeros_up    > best) { best = zeros_up;    filter_type = PNG_ROW_FILTER_TYPE_UP; }
+    if (zeros_paeth > best) {                     filter_type = PNG_ROW_FILTER_TYPE_PAETH; }
+
+    return filter_type;
+}
+
+
+// Returns the filtered row, which is either p_row (None) or png_row_filtered
+static const uint8_t * png_filter_apply(uint8_t filter_type, const uint8_t * p_row, const uint8_t * p_row_prev, uint8_t row_len) {
+
+    uint8_t * p_out = png_row_filtered;
+    uint8_t a = 0u, c = 0u;
+
+    switch (filter_type) {
+        case PNG_ROW_FILTER_TYPE_SUB:
+            while (row_len--) {
+                uint8_t x = *p_row++;
+                *p_out++ = x - a;
+                a = x;
+            }
+            break;
+
+        case PNG_ROW_FILTER_TYPE_UP:
+            while (row_len--) {
+                *p_out++ = *p_row++ - *p_row_prev++;
+            }
+            break;
+
+        case PNG_ROW_FILTER_TYPE_PAETH:
+            while (row_len--) {
+                uint8_t x = *p_row++;
+                uint8_t b = *p_row_prev++;
+                *p_out++ = x - paeth_predictor(a, b, c);
+                a = x;
+                c = b;
+            }
+            break;
+
+        default: return p_row;
+    }
+    return png_row_filtered;
+}
+
+
 // TODO: FEATURE: Accept data in gb tile format? (1 or 2bpp, repack the bytes into the output buffer)
 //
-// Mainly a clone of the 8bpp but with a bunch of things stripped out
-static uint16_t prepare_pixel_data_1bpp_src_and_1bpp_out(void) {
+// Mainly a clone of the 8bpp but with a bunch of things stripped out.
+// Split into begin / rows / end so the encoding can be spread out, see png_indexed_encode_rows()
+static bool prepare_pixel_data_1bpp_src_and_1bpp_out_begin(void) {
 
     // zlib/Deflate Adler checksum is only on the
     // Size of block in little endian and its 1's complement (4 bytes)
     adler_reset();
+    png.idat_crc_ready = false;
 
     // To reduce memory the zlib encapsulated image data is written
     // directly intothe expected location of the IDAT chunk data field
@@ -470,72 +830,168 @@ static uint16_t prepare_pixel_data_1bpp_src_and_1bpp_out(void) {
 
     const uint16_t  png_z_lib_data_start = calc_idat_payload_start_offset(png.palette_data_byte_len);
     uint8_t *       p_zlib_out_buf       = png.p_png_out_buf +  png_z_lib_data_start;
-    const uint8_t * p_zlib_out_buf_start = p_zlib_out_buf;
+    png_enc.p_zlib_out_buf_start = p_zlib_out_buf;
 
-    const uint8_t * p_src_image_pixels   = png.p_pixel_color_indexes;
+    png_enc.p_src_image_pixels = png.p_pixel_color_indexes;
     const uint8_t width  = png.width;
-    const uint8_t height = png.height;
+
+    // When the scanlines go straight into a Stored block the IDAT CRC is calculated
+    // as they're written, starting with the chunk type and the zlib + Stored block headers
+    png_enc.crc_inline = (png.compression == PNG_COMPRESSION_NONE);
 
 
     // TODO: Currently requires width to be an even multiple of 8
     if ((width % 8u) != 0)
-        return 0;
+        return false;
 
     const uint8_t pixels_per_byte = 8 / PNG_BPP_1;
-    const uint8_t pack_width = width / pixels_per_byte;
-    const uint16_t deflate_chunk_sz  = height * (PNG_ROW_FILTER_TYPE_SZ + ((width + (pixels_per_byte - 1)) / pixels_per_byte));  // Needs to be rounded up in case it's not an even multiple of pixels_per_byte
+    png_enc.pack_width = width / pixels_per_byte;
+    if (png_enc.pack_width > PNG_ROW_BUF_SZ_MAX)
+        return false;
+
+    // The row above the first one counts as all zeros for filtering
+    png_enc.p_row_prev  = png_row_zero;
+    png_enc.filter_type = PNG_ROW_FILTER_TYPE_NONE;
+    png_enc.y           = 0u;
+    const uint16_t deflate_chunk_sz  = png.scanlines_size;
 
     // Write zlib header bytes
     *p_zlib_out_buf++ = ZLIB_HEADER_CMF;
     *p_zlib_out_buf++ = ZLIB_HEADER_FLG;
 
-    // To save space this now uses a single DEFLATE block for all pixel data, so the limit is 65,535 bytes
-    // Deflate Header
-    *p_zlib_out_buf++ = DEFLATE_HEADER_FINAL_YES;
-    //
-    p_zlib_out_buf = write_u16_le(p_zlib_out_buf, deflate_chunk_sz);
-    p_zlib_out_buf = write_u16_le(p_zlib_out_buf, deflate_chunk_sz ^ 0xFFFFu);
+    // Uncompressed: Scanlines get written directly into the Stored block
+    // Compressed:   Scanlines get staged at the end of the output buffer, then DEFLATE reads from there
+    //               (catching up with them as they get written)
+    if (png.compression == PNG_COMPRESSION_NONE) {
+        p_zlib_out_buf = write_deflate_stored_header(p_zlib_out_buf, deflate_chunk_sz);
+        png_enc.p_scanlines = p_zlib_out_buf;
+
+        crc32_reset();
+        crc32_update((const uint8_t *)"IDAT", PNG_CHUNK_TYPE_SZ);
+        crc32_update(png_enc.p_zlib_out_buf_start, p_zlib_out_buf - png_enc.p_zlib_out_buf_start);
+    } else {
+        png_enc.p_scanlines = png.p_png_out_buf + (png.file_max_size - png.scanlines_size);
+        if (!deflate_fixed_begin(p_zlib_out_buf, DEFLATE_HEADER_SZ + deflate_chunk_sz,
+                                 png_enc.p_scanlines, deflate_chunk_sz,
+                                 PNG_ROW_FILTER_TYPE_SZ + png_enc.pack_width))
+            return false;
+    }
+    png_enc.p_zlib_out_buf = p_zlib_out_buf;
 
     // PNG Row filter header + row data
-    uint8_t * p_zlib_adler_start = p_zlib_out_buf;
+    png_enc.p_zlib_adler_start = png_enc.p_scanlines;
+    return true;
+}
+
+
+// Returns true once all the rows are written
+static bool prepare_pixel_data_1bpp_src_and_1bpp_out_rows(uint8_t row_count) {
+
+    const uint8_t   pack_width         = png_enc.pack_width;
+    const bool      crc_inline         = png_enc.crc_inline;
+    const uint8_t * p_src_image_pixels = png_enc.p_src_image_pixels;
+    const uint8_t * p_row_prev         = png_enc.p_row_prev;
+    uint8_t *       p_scanlines        = png_enc.p_scanlines;
+    uint8_t         filter_type        = png_enc.filter_type;
+    uint8_t         y                  = png_enc.y;
+
+    uint8_t y_end = png.height;
+    if ((y_end - y) > row_count) y_end = y + row_count;
 
     // Write out the scanline pixel index rows
-    for (uint8_t y = 0u; y < height; y++) {
+    // The Adler checksum for all DEFLATE payload data (excluding last chunk indicators and size headers)
+    // is summed as the bytes get written instead of re-reading all the scanlines afterward
+    for (; y < y_end; y++) {
+
+        // Spec:
+        // Pixels are always packed into scanlines with no wasted bits between pixels.
+        // Pixels smaller than a byte never cross byte boundaries; they are packed into bytes
+        // **with the leftmost pixel in the high-order bits of a byte**, the rightmost in the low-order bits.
+        const uint8_t * p_row = p_src_image_pixels;
+        p_src_image_pixels += pack_width;
+
+        if (png.filter_mode != PNG_FILTER_MODE_NONE) {
+            if ((png.filter_mode == PNG_FILTER_MODE_HEURISTIC) || ((y % PNG_FILTER_REUSE_ROWS) == 0u))
+                filter_type = png_filter_select(p_row, p_row_prev, pack_width);
+        }
+        const uint8_t * p_row_out = png_filter_apply(filter_type, p_row, p_row_prev, pack_width);
+        p_row_prev = p_row;
 
         // Start of each PNG row has a Row Filter Type byte
-        *p_zlib_out_buf++ = PNG_ROW_FILTER_TYPE_NONE;
+        *p_scanlines++ = filter_type;
+        ADLER_ADD_BYTE(filter_type);
+        if (crc_inline) CRC32_ADD_BYTE(filter_type);
 
         for (uint8_t x = 0u; x < pack_width; x++) {
-            // Spec:
-            // Pixels are always packed into scanlines with no wasted bits between pixels.
-            // Pixels smaller than a byte never cross byte boundaries; they are packed into bytes
-            // **with the leftmost pixel in the high-order bits of a byte**, the rightmost in the low-order bits.
+            uint8_t packed = *p_row_out++;
+            *p_scanlines++ = packed;
+            ADLER_ADD_BYTE(packed);
+            if (crc_inline) CRC32_ADD_BYTE(packed);
+        }
+    }
+
+    png_enc.p_src_image_pixels = p_src_image_pixels;
+    png_enc.p_row_prev         = p_row_prev;
+    png_enc.p_scanlines        = p_scanlines;
+    png_enc.filter_type        = filter_type;
+    png_enc.y                  = y;
 
-            // Read next pixel color index and clamp (via mask, dropping bits) the pixel to max bpp allowed value
-            *p_zlib_out_buf++ = *p_src_image_pixels++;
+    if (png.compression != PNG_COMPRESSION_NONE) {
+        PROF_BEGIN(PROF_STAGE_DEFLATE);
+        deflate_fixed_step(p_scanlines - png_enc.p_zlib_adler_start);
+        PROF_END(PROF_STAGE_DEFLATE);
+    }
+    return (y == png.height);
+}
+
+
+// Returns the zlib data size
+static uint16_t prepare_pixel_data_1bpp_src_and_1bpp_out_end(void) {
+
+    uint8_t * p_zlib_out_buf = png_enc.p_zlib_out_buf;
+    const uint16_t deflate_chunk_sz = png.scanlines_size;
+
+    adler_finish();
+
+    if (png.compression == PNG_COMPRESSION_NONE) {
+        p_zlib_out_buf = png_enc.p_scanlines;
+    } else {
+        // Compressed output must fit where the Stored block would have gone, otherwise use a Stored block
+        PROF_BEGIN(PROF_STAGE_DEFLATE);
+        uint16_t deflate_sz = deflate_fixed_end();
+        PROF_END(PROF_STAGE_DEFLATE);
+        if (deflate_sz) {
+            p_zlib_out_buf += deflate_sz;
+        } else {
+            EMU_printf("DEFLATE larger than stored, using stored\n");
+            p_zlib_out_buf = write_deflate_stored_header(p_zlib_out_buf, deflate_chunk_sz);
+            // Staging area is always past the end of the Stored block, so no overlap
+            memcpy(p_zlib_out_buf, png_enc.p_zlib_adler_start, deflate_chunk_sz);
+            p_zlib_out_buf += deflate_chunk_sz;
         }
     }
-    // Adler checksum for all DEFLATE payload data (excluding last chunk indicators and size headers)
-    adler_crc_update(p_zlib_adler_start, (p_zlib_out_buf - p_zlib_adler_start)); // Length calc is not +1 since pointer is already at byte after end of adler range
 
     // Write zlib Adler crc
     p_zlib_out_buf = write_u16_be(p_zlib_out_buf, zlib_adler_b);
     p_zlib_out_buf = write_u16_be(p_zlib_out_buf, zlib_adler_a);
 
+    if (png_enc.crc_inline) {
+        crc32_update(p_zlib_out_buf - ZLIB_FOOTER_SZ, ZLIB_FOOTER_SZ);
+        png.idat_crc = crc32_result();
+        png.idat_crc_ready = true;
+    }
 
-    EMU_printf("zfinsz=%u\n", (uint16_t)(p_zlib_out_buf - p_zlib_out_buf_start));
+    EMU_printf("zfinsz=%u\n", (uint16_t)(p_zlib_out_buf - png_enc.p_zlib_out_buf_start));
 
-    // Return resulting size (may be smaller than max size if compression is used) // Note: no compression yet :)
-    return (p_zlib_out_buf - p_zlib_out_buf_start);
+    // Return resulting size (may be smaller than max size if compression is used)
+    return (p_zlib_out_buf - png_enc.p_zlib_out_buf_start);
 }
 
 
-uint16_t png_indexed_encode(void) BANKED {
+bool png_indexed_encode_begin(void) BANKED {
 
     if (!png.calc_initialized && !png.buffers_initialized)
-        return 0;
-
-    EMU_PROFILE_BEGIN(" PNG prof start ");
+        return false;
 
     // TODO: error handling
 
@@ -552,16 +1008,26 @@ uint16_t png_indexed_encode(void) BANKED {
         // Warn that total colors exceeds limit
 
     // == Process PNG Data ==
-    uint16_t zlib_packed_size;
     switch (png.in_bpp) {
         case SRC_BPP_1:
-            if (png.out_bpp == PNG_BPP_1) zlib_packed_size = prepare_pixel_data_1bpp_src_and_1bpp_out();
-            else return 0;
-            break;
+            if (png.out_bpp == PNG_BPP_1) return prepare_pixel_data_1bpp_src_and_1bpp_out_begin();
+            else return false;
         // case SRC_BPP_8: zlib_packed_size = prepare_pixel_data_8bpp_src();
         //     break;
-        default: return 0;
+        default: return false;
     }
+}
+
+
+bool png_indexed_encode_rows(uint8_t row_count) BANKED {
+
+    return prepare_pixel_data_1bpp_src_and_1bpp_out_rows(row_count);
+}
+
+
+uint16_t png_indexed_encode_end(void) BANKED {
+
+    uint16_t zlib_packed_size = prepare_pixel_data_1bpp_src_and_1bpp_out_end();
 
     // == Now build the PNG output ==
     uint8_t  * p_pngbuf = png.p_png_out_buf;
@@ -595,14 +1061,30 @@ uint16_t png_indexed_encode(void) BANKED {
     // p_pngbuf = png_write_chunk(p_pngbuf, "IDAT", zlibPixelRows, zlibPixelRows_sz);
     // Don't actually write the pixel data since it's already been assembled in place
     // DEBUG: printf("\npchk=%x, %u\n", (uint16_t)p_pngbuf, (uint16_t)zlib_packed_size);
-    p_pngbuf = png_write_chunk(p_pngbuf, "IDAT", NO_DATA_COPY, zlib_packed_size);
+    if (png.idat_crc_ready)
+        p_pngbuf = png_write_chunk_crc_ready(p_pngbuf, "IDAT", zlib_packed_size, png.idat_crc);
+    else
+        p_pngbuf = png_write_chunk(p_pngbuf, "IDAT", NO_DATA_COPY, zlib_packed_size);
     // DEBUG:  printf("\npchk=%x\n", (uint16_t)p_pngbuf);
 
     // PNG End of data
     p_pngbuf = png_write_chunk(p_pngbuf, "IEND", NO_DATA_COPY, 0);
 
-    EMU_PROFILE_END(" PNG prof end: ");
-
     const uint16_t pngfile_final_size = p_pngbuf - png.p_png_out_buf;
     return pngfile_final_size;  // Return size of completed PNG image, NULL for error
 }
+
+
+uint16_t png_indexed_encode(void) BANKED {
+
+    if (!png_indexed_encode_begin())
+        return 0;
+
+    EMU_PROFILE_BEGIN(" PNG prof start ");
+
+    png_indexed_encode_rows(png.height);
+    const uint16_t pngfile_final_size = png_indexed_encode_end();
+
+    EMU_PROFILE_END(" PNG prof end: ");
+    return pngfile_final_size;
+}
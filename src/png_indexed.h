@@ -14,6 +14,32 @@
 #define SRC_BPP_4  4u
 #define SRC_BPP_8  8u
 
+// Selects how the IDAT pixel data gets DEFLATE encoded
+#define PNG_COMPRESSION_NONE           0u  // Single Stored (uncompressed) DEFLATE block
+#define PNG_COMPRESSION_FIXED_HUFFMAN  1u  // Single Fixed Huffman + LZ77 DEFLATE block (falls back to stored if larger)
+
+// Selects the PNG row filter for each scanline (applied to the packed bytes, pixels are never unpacked)
+#define PNG_FILTER_MODE_NONE            0u  // Always filter type None
+#define PNG_FILTER_MODE_HEURISTIC       1u  // Each row uses whichever of None, Sub, Up, Paeth gives the most zero bytes
+#define PNG_FILTER_MODE_HEURISTIC_REUSE 2u  // Same, but only picked every PNG_FILTER_REUSE_ROWS rows, rows in between reuse it
+
+#define PNG_FILTER_REUSE_ROWS  8u
+
+// Selects the CRC-32 implementation used for PNG chunk checksums
+// - TABLE32:     256 x uint32_t table, a 32 bit shift + xor per byte (1K ROM)
+// - BYTE_PLANES: Same table split into four 256 byte tables (one per CRC byte), only 8 bit ops per byte (1K ROM)
+// - NIBBLE:      16 x uint32_t table, two lookups with 4 bit shifts per byte (64 bytes ROM) for ROM constrained builds
+#define PNG_CRC_ENGINE_TABLE32      0
+#define PNG_CRC_ENGINE_BYTE_PLANES  1
+#define PNG_CRC_ENGINE_NIBBLE       2
+
+#ifndef PNG_CRC_ENGINE
+    #define PNG_CRC_ENGINE PNG_CRC_ENGINE_BYTE_PLANES
+#endif
+
+
+#define PNG_ROW_BUF_SZ_MAX  32u  // Packed 1bpp row for the max 8 bit width (255 -> 32 bytes)
+
 
 typedef struct png_data_t {
 
@@ -22,6 +48,8 @@ typedef struct png_data_t {
     uint8_t   height;
     uint8_t   in_bpp;
     uint8_t   out_bpp;
+    uint8_t   compression;
+    uint8_t   filter_mode;
 
     const uint8_t * p_palette_data;
     const uint8_t * p_pixel_color_indexes;  // TODO: RENAME: rename p_pixelColorIndexes -> todo done?
@@ -29,9 +57,14 @@ typedef struct png_data_t {
 
     // Computed vars
     uint16_t        zlib_pixel_rows_max_size;
+    uint16_t        scanlines_size;         // Size of all PNG scanlines (row filter bytes + pixel data) before DEFLATE
     uint16_t        file_max_size;
     bool            calc_initialized;
 
+    // Set when the IDAT chunk CRC was calculated while its payload was written (Stored block output)
+    uint32_t        idat_crc;
+    bool            idat_crc_ready;
+
     // This var gets set after Computed vars are returned and a buffer is allocated
     uint8_t       * p_png_out_buf;
     bool            buffers_initialized;
@@ -39,13 +72,25 @@ typedef struct png_data_t {
 
 
 // Call this first to initialize, use the returned value to allocate a buffer to build the png inside of
-uint16_t png_indexed_init(uint8_t width, uint8_t height, uint8_t in_bpp, uint8_t out_bpp, uint16_t palette_data_byte_len) BANKED;
+// - compression: PNG_COMPRESSION_*. When compressing the end of the buffer is used as a work area
+//                for the uncompressed scanlines, so the returned size will be larger than the final PNG
+// - filter_mode: PNG_FILTER_MODE_*
+uint16_t png_indexed_init(uint8_t width, uint8_t height, uint8_t in_bpp, uint8_t out_bpp, uint16_t palette_data_byte_len, uint8_t compression, uint8_t filter_mode) BANKED;
 
 // Sets the working buffers (note lack of size checking)
 void png_indexed_set_buffers(uint8_t * p_img_palette_data, uint8_t * p_img_pixel_color_indexes, uint8_t * p_png_out_buf) BANKED;
 
-// Builds the png file data into the provided buffer
+// Builds the png file data into the provided buffer, returns its size (0 on error)
 // png_indexed_init() and png_indexed_set_buffers() should be called first
 uint16_t png_indexed_encode(void) BANKED;
 
+// png_indexed_encode() in steps, for spreading the work across frames (the same PNG gets built).
+// The buffers must stay as they are in between
+// - png_indexed_encode_begin(): returns false on error
+// - png_indexed_encode_rows():  encodes up to row_count more rows, returns true once all of them are done
+// - png_indexed_encode_end():   returns the same as png_indexed_encode()
+bool png_indexed_encode_begin(void) BANKED;
+bool png_indexed_encode_rows(uint8_t row_count) BANKED;
+uint16_t png_indexed_encode_end(void) BANKED;
+
 #endif // PNG_INDEXED_H
\ No newline at end of file
@@ -7,6 +7,9 @@
 
 #include "ui_main.h"
 #include "save_and_undo.h"
+#include "img_2_qrcode.h"
+#include "print_tiles.h"
+#include "print.h"
 
 #if defined(GAMEBOY) || defined(ANALOGUEPOCKET)
     #include "gb/gbprinter.h"
@@ -16,11 +19,18 @@
     #include "duck/megaduck_printscreen.h"
 #endif
 
+#ifdef EXTRA_HW_USB_MOUSE
+    #include "usb_mouse/usb_mouse.h"
+#endif
+
 
 #pragma bank 255  // Autobanked
 
 static void display_result(char * str);
 
+// Off while printing from the screen, so nothing gets drawn over what's being printed
+static bool print_show_status;
+
 
 bool printer_check_cancel(void) BANKED {
     UPDATE_KEYS();
@@ -28,52 +38,99 @@ bool printer_check_cancel(void) BANKED {
 }
 
 
+#if defined(GAMEBOY) || defined(ANALOGUEPOCKET)
+    #define PRINT_PROGRESS_X      40u
+    #define PRINT_PROGRESS_Y      50u
+    #define PRINT_PROGRESS_STEP   6u
+    #define PRINT_PROGRESS_HEIGHT 5u
+
+    // Called by the printer code as the print moves along
+    void printer_show_progress(uint8_t progress) BANKED {
+        if ((progress == 0u) || !print_show_status) return;
+        color(WHITE, WHITE, SOLID);
+        box(PRINT_PROGRESS_X + 1u, PRINT_PROGRESS_Y + 1u,
+            PRINT_PROGRESS_X + (progress * PRINT_PROGRESS_STEP) - 1u, PRINT_PROGRESS_Y + PRINT_PROGRESS_HEIGHT - 2u, M_FILL);
+        color(WHITE, BLACK, SOLID);
+    }
+#endif
+
+
 static void display_result(char * str) {
     gotogxy(5u,5u);
     gprintf(str);
 }
 
 
-void print_drawing(void) BANKED {
+enum {
+    PRINT_RESULT_NOT_FOUND,
+    PRINT_RESULT_FAILED,
+    PRINT_RESULT_DONE,
+};
 
-    drawing_take_undo_snapshot();  // This clears out any Redo queue entries that might be present
+static char * const print_result_str[] = { "Not Found", "Failed", "Done" };
 
-    // Ok to print status on the screen before calling print
-    // now that print reads from the undo snapshot just taken above
-    color(WHITE, BLACK, SOLID);
-    gotogxy(5u,4u);
-    gprintf("Printing..");
 
+// Sends the print tile source to the printer
+static uint8_t print_send(void) {
+
+    uint8_t result = PRINT_RESULT_NOT_FOUND;
 
     #if defined(GAMEBOY) || defined(ANALOGUEPOCKET)
-        // Printing may be more reliable at DMG link speed
-        if (_cpu == CGB_TYPE) cpu_slow();
+        if (print_show_status) {
+            // Empty progress bar
+            color(WHITE, BLACK, SOLID);
+            box(PRINT_PROGRESS_X, PRINT_PROGRESS_Y,
+                PRINT_PROGRESS_X + (PRN_MAX_PROGRESS * PRINT_PROGRESS_STEP), PRINT_PROGRESS_Y + PRINT_PROGRESS_HEIGHT - 1u, M_FILL);
+        }
+
+        // The printer takes over the link port interrupt from the mouse
+        #ifdef EXTRA_HW_USB_MOUSE
+            usb_mouse_deinstall();
+        #endif
+        gbprinter_install();
 
+        // On CGB this picks the link speed (and drops to normal speed if needed)
         bool printer_found = gbprinter_detect(PRINTER_DETECT_TIMEOUT) == PRN_STATUS_OK;
         if (printer_found) {
-            // gbprinter_print_screen_apa(IMG_TILE_X_START, IMG_TILE_Y_START, IMG_TILE_X_END, IMG_TILE_Y_END);
-            // uint8_t status = gbprinter_print_screen_rect_from_undo(IMG_TILE_X_START, IMG_TILE_Y_START, IMG_WIDTH_TILES, IMG_HEIGHT_TILES, true);
-            uint8_t status = gbprinter_print_screen_rect_from_undo();
+            uint8_t status = gbprinter_print_tiles();
 
             // Treat only high-nibble printer error bits as fatal.
             // Some printers may report non-fatal low bits after a successful print.
-            if (status & PRN_STATUS_MASK_ERRORS) display_result("Failed");
-            else                                 display_result("Done");
-        } else {
-            display_result("Not Found");
+            result = (status & PRN_STATUS_MASK_ERRORS) ? PRINT_RESULT_FAILED : PRINT_RESULT_DONE;
         }
+
+        gbprinter_remove();
+        #ifdef EXTRA_HW_USB_MOUSE
+            usb_mouse_install();
+        #endif
         if (_cpu == CGB_TYPE) cpu_fast();
 
     #endif
 
     #if defined(MEGADUCK)
         if (megaduck_laptop_detected) {
-            if (duck_print_rect_from_undo()) display_result("Done");
-            else display_result("Not Found");
+            if (duck_print_tiles()) result = PRINT_RESULT_DONE;
         }
-        else display_result("Not Found");
     #endif
 
+    return result;
+}
+
+
+void print_drawing(void) BANKED {
+
+    drawing_take_undo_snapshot();  // This clears out any Redo queue entries that might be present
+    print_tiles_set_source(PRINT_TILES_UNDO);
+
+    // Ok to print status on the screen before calling print
+    // now that print reads from the undo snapshot just taken above
+    color(WHITE, BLACK, SOLID);
+    gotogxy(5u,4u);
+    gprintf("Printing..");
+
+    print_show_status = true;
+    display_result(print_result_str[print_send()]);
+
     waitpadup_lowcpu(J_ALL);
     waitpadticked_lowcpu(J_ANY);
     waitpadup_lowcpu(J_ALL);
@@ -81,3 +138,53 @@ void print_drawing(void) BANKED {
     ui_redraw_full();
     drawing_restore_undo_snapshot(UNDO_RESTORE_WITHOUT_REDO_SNAPSHOT);  // Don't create a Redo snapshot since it would be of the QRCode overlay on the drawing image
 }
+
+
+// Shows a failed QR Code print result over the QR Code for a moment (or until a button is pressed),
+// then puts back the screen tiles it covered
+#define PRINT_QR_RESULT_FRAMES    90u
+#define PRINT_QR_RESULT_TILE_X    5u
+#define PRINT_QR_RESULT_TILE_Y    5u
+#define PRINT_QR_RESULT_TILES     9u  // Longest result string: "Not Found"
+#define PRINT_QR_RESULT_VRAM_ADDR (APA_MODE_VRAM_START + (PRINT_QR_RESULT_TILE_Y * SCREEN_ROW_SZ) + (PRINT_QR_RESULT_TILE_X * TILE_SZ_BYTES))
+
+static void print_qrcode_show_result(uint8_t result) {
+
+    uint8_t saved_tiles[PRINT_QR_RESULT_TILES * TILE_SZ_BYTES];
+    vmemcpy(saved_tiles, (uint8_t *)PRINT_QR_RESULT_VRAM_ADDR, sizeof(saved_tiles));
+
+    // Any non-white color shows black with the QR palette
+    color(BLACK, WHITE, SOLID);
+    gotogxy(PRINT_QR_RESULT_TILE_X, PRINT_QR_RESULT_TILE_Y);
+    gprintf(print_result_str[result]);
+
+    waitpadup_lowcpu(J_ANY);
+    for (uint8_t frames = 0u; frames < PRINT_QR_RESULT_FRAMES; frames++) {
+        vsync(); // yield CPU
+        UPDATE_KEYS();
+        if (GET_KEYS_TICKED(J_ANY)) break;
+    }
+    waitpadup_lowcpu(J_ANY);
+
+    vmemcpy((uint8_t *)PRINT_QR_RESULT_VRAM_ADDR, saved_tiles, sizeof(saved_tiles));
+}
+
+
+// Prints the QR Code on screen straight from VRAM. For a multi QR Code export each one
+// gets shown and printed in turn, a page each, then the one that was showing is put back.
+// If the printer isn't found or the print fails that gets shown briefly over the QR Code
+void print_qrcode(uint8_t qr_count, uint8_t part_shown) BANKED {
+
+    uint8_t result = PRINT_RESULT_DONE;
+
+    print_tiles_set_source(PRINT_TILES_QRCODE);
+    print_show_status = false;
+
+    for (uint8_t part = 0u; part < qr_count; part++) {
+        if (qr_count > 1u) qrcode_show_part(part);
+        result = print_send();
+        if (result != PRINT_RESULT_DONE) break;
+    }
+    if (result != PRINT_RESULT_DONE) print_qrcode_show_result(result);
+    if (qr_count > 1u) qrcode_show_part(part_shown);
+}
@@ -2,5 +2,6 @@
 #define PRINT_H
 
 void print_drawing(void) BANKED;
+void print_qrcode(uint8_t qr_count, uint8_t part_shown) BANKED;
 
 #endif // PRINT_H
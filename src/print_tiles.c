@@ -0,0 +1,62 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "common.h"
+#include "save_and_undo.h"
+#include "print_tiles.h"
+
+#pragma bank 255  // Autobanked
+
+uint8_t print_tiles_x;
+uint8_t print_tiles_y;
+uint8_t print_tiles_width;
+uint8_t print_tiles_height;
+
+static uint8_t         tiles_source;
+static const uint8_t * p_tiles_base;
+static uint16_t        tiles_row_sz;
+
+
+void print_tiles_set_source(uint8_t source) BANKED {
+
+    tiles_source = source;
+
+    if (source == PRINT_TILES_UNDO) {
+        // The undo snapshot is Only and All of the drawing tiles, in sequential order
+        print_tiles_x      = IMG_TILE_X_START;
+        print_tiles_y      = IMG_TILE_Y_START;
+        print_tiles_width  = IMG_WIDTH_TILES;
+        print_tiles_height = IMG_HEIGHT_TILES;
+        tiles_row_sz       = DRAWING_ROW_OF_TILES_SZ;
+        p_tiles_base       = undo_get_last_snapshot_addr();
+    } else {
+        // In APA mode every screen tile has its own pattern, in sequential order starting at the top left,
+        // so no need to look them up through the map
+        print_tiles_x      = 0u;
+        print_tiles_y      = 0u;
+        print_tiles_width  = DEVICE_SCREEN_WIDTH;
+        print_tiles_height = DEVICE_SCREEN_HEIGHT;
+        tiles_row_sz       = SCREEN_ROW_SZ;
+        p_tiles_base       = (const uint8_t *)APA_MODE_VRAM_START;
+    }
+}
+
+
+void print_tiles_get(uint8_t * p_tile, uint8_t tile_x, uint8_t tile_y) BANKED {
+
+    const uint8_t * p_src = p_tiles_base + (tile_y * tiles_row_sz) + (tile_x * TILE_SZ_BYTES);
+
+    if (tiles_source == PRINT_TILES_UNDO) {
+        // Bank gets switched every time since the printer code may use other SRAM banks in between
+        PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+        memcpy(p_tile, p_src, TILE_SZ_BYTES);
+    } else {
+        vmemcpy(p_tile, p_src, TILE_SZ_BYTES);
+
+        // The QR Code is only rendered into bitplane 0 and shown black by the QR palette,
+        // copy it into bitplane 1 as well so it prints black
+        for (uint8_t c = 0u; c < TILE_SZ_BYTES; c += 2u) p_tile[c + 1u] = p_tile[c];
+    }
+}
@@ -0,0 +1,23 @@
+#ifndef PRINT_TILES_H
+#define PRINT_TILES_H
+
+#include <stdint.h>
+
+// Where the printer back ends pull tiles from, one at a time as they get sent
+enum {
+    PRINT_TILES_UNDO,       // The drawing, from the last undo snapshot
+    PRINT_TILES_QRCODE,     // The whole screen from VRAM with a QR Code on it (bitplane 0 only), printed black
+};
+
+// Area the current source covers, in screen tiles
+extern uint8_t print_tiles_x;
+extern uint8_t print_tiles_y;
+extern uint8_t print_tiles_width;
+extern uint8_t print_tiles_height;
+
+void print_tiles_set_source(uint8_t source) BANKED;
+
+// Copies one tile (at tile_x, tile_y within the source area) into p_tile
+void print_tiles_get(uint8_t * p_tile, uint8_t tile_x, uint8_t tile_y) BANKED;
+
+#endif // PRINT_TILES_H
@@ -0,0 +1,166 @@
+#include <gbdk/platform.h>
+#include <gb/drawing.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <gbdk/emu_debug.h>
+
+#pragma bank 255  // Autobanked
+
+#include "platform_cart_type.h"
+#include "common.h"
+#include "save_and_undo.h"
+#include "profiler.h"
+
+#ifdef ENABLE_PROFILER
+
+// Ring lives in the unused tail of the drawing saves SRAM bank: 0xA000 + (3 x 2304) = 0xBB00 -> 0xBE44
+// (the printer link record is at the very end of the bank)
+#define PROF_SRAM_BANK     (SRAM_BANK_DRAWING_SAVES)
+#define PROF_SRAM_RING     ((prof_ring_t *)(SRAM_BASE_A000 + (DRAW_SAVE_SLOT_SIZE * DRAW_SAVE_SLOT_COUNT)))
+
+#define PROF_TICKS_PER_OVERFLOW  256u
+#define PROF_TICKS_MASK          0x00FFFFFFu  // profiler_now() wraps around after 16 bits of overflows (64 sec, 32 in double speed)
+
+static uint16_t prof_overflow_count;
+static uint32_t prof_stage_start[PROF_STAGE_COUNT];
+static prof_record_t prof_current;
+static bool          prof_run_active;  // Stage hooks outside a run (background QR Code pre-generation) are ignored
+
+
+static void profiler_timer_isr(void) NONBANKED {
+    prof_overflow_count++;
+}
+
+
+// Ticks since profiler_init(). Re-reads if the timer overflowed
+// during the read so the two halves always match up
+static uint32_t profiler_now(void) NONBANKED {
+
+    uint16_t overflows;
+    uint8_t  tima;
+    do {
+        overflows = prof_overflow_count;
+        tima      = TIMA_REG;
+    } while (overflows != prof_overflow_count);
+
+    return ((uint32_t)overflows * PROF_TICKS_PER_OVERFLOW) + tima;
+}
+
+
+void profiler_stage_begin(uint8_t stage) NONBANKED {
+    if (!prof_run_active) return;
+    prof_stage_start[stage] = profiler_now();
+}
+
+
+// Masked so a stage running across the wrap around still gets the right duration
+void profiler_stage_end(uint8_t stage) NONBANKED {
+    if (!prof_run_active) return;
+    prof_current.ticks[stage] += (profiler_now() - prof_stage_start[stage]) & PROF_TICKS_MASK;
+}
+
+
+void profiler_init(void) BANKED {
+
+    CRITICAL {
+        prof_overflow_count = 0u;
+
+        // Remove first to avoid accidentally double-adding it
+        remove_TIM(profiler_timer_isr);
+        add_TIM(profiler_timer_isr);
+    }
+
+    TMA_REG  = 0u;  // Full 256 tick period between overflows
+    TIMA_REG = 0u;
+    TAC_REG  = TACF_START | TACF_262KHZ;
+
+    set_interrupts(IE_REG | TIM_IFLAG);
+}
+
+
+// flags: PROF_FLAG_PREGENERATED when only showing a QR Code pre-generated in the background
+void profiler_run_begin(uint8_t flags) BANKED {
+
+    memset(&prof_current, 0u, sizeof(prof_current));
+    prof_current.flags = flags;
+    #if defined(GAMEBOY) || defined(ANALOGUEPOCKET)
+        if ((_cpu == CGB_TYPE) && (KEY1_REG & KEY1F_DBLSPEED))
+            prof_current.flags |= PROF_FLAG_CPU_FAST;
+    #endif
+
+    prof_run_active = true;
+    PROF_BEGIN(PROF_STAGE_TOTAL);
+}
+
+
+// Stores the completed run in the SRAM ring, leaves the Calc buffer SRAM bank selected
+void profiler_run_end(void) BANKED {
+
+    PROF_END(PROF_STAGE_TOTAL);
+    prof_run_active = false;
+
+    PLAT_SWITCH_RAM(PROF_SRAM_BANK);
+    prof_ring_t * p_ring = PROF_SRAM_RING;
+
+    // Start a fresh ring if SRAM doesn't have one yet (or has garbage)
+    if (p_ring->signature != PROF_RING_SIGNATURE) {
+        memset(p_ring, 0u, sizeof(prof_ring_t));
+        p_ring->signature = PROF_RING_SIGNATURE;
+    }
+
+    prof_current.run_number = p_ring->run_count;
+    memcpy(&p_ring->records[p_ring->run_count % PROF_RING_RECORD_COUNT], &prof_current, sizeof(prof_current));
+    p_ring->run_count++;
+
+    PLAT_SWITCH_RAM(SRAM_BANK_CALC_BUFFER);
+
+    for (uint8_t stage = 0u; stage < PROF_STAGE_COUNT; stage++)
+        EMU_printf("PROF stage %hu: %lu ticks\n", (uint8_t)stage, (uint32_t)prof_current.ticks[stage]);
+}
+
+
+static const char * const prof_stage_names[PROF_STAGE_COUNT] = {
+    "Total",
+    "Capture",
+    "PNG",
+    " Deflate",
+    " Adler",
+    " CRC",
+    "Base64",
+    "QR Append",
+    "QR RS ECC",
+    "QR Place",
+    "QR Mask",
+    "Render",
+};
+
+
+// Shows the last run in milliseconds (ticks are 1/262144 sec, or half that in double speed)
+void profiler_overlay_show(void) BANKED {
+
+    const uint8_t ms_shift = (prof_current.flags & PROF_FLAG_CPU_FAST) ? 16u : 15u;
+
+    color(WHITE, WHITE, SOLID);
+    box(0u, 0u, DEVICE_SCREEN_PX_WIDTH - 1u, DEVICE_SCREEN_PX_HEIGHT - 1u, M_FILL);
+    color(BLACK, WHITE, SOLID);
+
+    gotogxy(1u, 1u);
+    gprintf("Export #%u %s", (uint16_t)prof_current.run_number, (prof_current.flags & PROF_FLAG_CPU_FAST) ? "2x" : "1x");
+    if (prof_current.flags & PROF_FLAG_PREGENERATED) {
+        gotogxy(1u, 2u);
+        gprintf("QR pre-generated");
+    }
+
+    for (uint8_t stage = 0u; stage < PROF_STAGE_COUNT; stage++) {
+        // ms = ticks * 1000 / 262144 = ticks * 125 / 32768
+        uint16_t ms = (uint16_t)(((uint32_t)prof_current.ticks[stage] * 125u) >> ms_shift);
+        gotogxy(1u, stage + 3u);
+        gprintf("%s", prof_stage_names[stage]);
+        gotogxy(12u, stage + 3u);
+        gprintf("%ums", ms);
+    }
+}
+
+#endif // ENABLE_PROFILER
@@ -0,0 +1,74 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// In-ROM export profiler
+//
+// Build with "make PROFILER=1" (defines ENABLE_PROFILER), otherwise all hooks compile out.
+//
+// - Timestamps come from TIMA running at 262144Hz (one tick per 16 CPU clocks in both
+//   DMG and CGB double speed mode) plus a 16 bit count of TIMA overflows from the timer ISR
+// - Each stage accumulates ticks between PROF_BEGIN() / PROF_END(), so stages called
+//   multiple times per export (CRC, Adler) get totaled. Stages may be nested.
+// - At the end of each export the stage totals are stored as a record in a ring in
+//   Cart SRAM, in the unused tail of the drawing save bank (after the save slots)
+// - Stages only count during a run, so background QR Code pre-generation isn't timed.
+//   Showing a pre-generated QR Code is its own run (render only) and is labeled that way
+// - Dismissing the QR Code with B shows the timings of the last export
+
+enum {
+    PROF_STAGE_TOTAL,
+    PROF_STAGE_CAPTURE,     // VRAM drawing capture (only changed tiles)
+    PROF_STAGE_PNG,         // All PNG encoding, includes DEFLATE, Adler and CRC
+    PROF_STAGE_DEFLATE,
+    PROF_STAGE_ADLER,       // Only the final fold, per byte sums are done during scanline packing (PNG)
+    PROF_STAGE_CRC,
+    PROF_STAGE_BASE64,      // Base64 url, streamed into the QR Code data so it includes part of QR Append
+    PROF_STAGE_QR_APPEND,   // QR Code segment bit appending and padding
+    PROF_STAGE_QR_RS,       // Reed-Solomon ECC and interleaving
+    PROF_STAGE_QR_PLACE,    // Function patterns and codeword placement
+    PROF_STAGE_QR_MASK,     // Mask selection, masking and format bits
+    PROF_STAGE_RENDER,      // QR Code render to VRAM
+
+    PROF_STAGE_COUNT
+};
+
+#define PROF_RING_RECORD_COUNT  16u
+#define PROF_RING_SIGNATURE     0x5052u  // "PR"
+
+#define PROF_FLAG_CPU_FAST      0x01u    // Export ran in CGB double speed mode
+#define PROF_FLAG_PREGENERATED  0x02u    // QR Code was pre-generated in the background, only the render is timed
+
+typedef struct prof_record_t {
+    uint16_t run_number;
+    uint8_t  flags;
+    uint8_t  reserved;
+    uint32_t ticks[PROF_STAGE_COUNT];    // TIMA ticks (x16 = CPU clocks)
+} prof_record_t;
+
+typedef struct prof_ring_t {
+    uint16_t      signature;
+    uint16_t      run_count;              // Total runs recorded, next record is (run_count % PROF_RING_RECORD_COUNT)
+    prof_record_t records[PROF_RING_RECORD_COUNT];
+} prof_ring_t;
+
+
+#ifdef ENABLE_PROFILER
+    void profiler_init(void) BANKED;
+    void profiler_run_begin(uint8_t flags) BANKED;
+    void profiler_run_end(void) BANKED;
+    void profiler_overlay_show(void) BANKED;
+
+    void profiler_stage_begin(uint8_t stage) NONBANKED;
+    void profiler_stage_end(uint8_t stage) NONBANKED;
+
+    #define PROF_BEGIN(stage) profiler_stage_begin(stage)
+    #define PROF_END(stage)   profiler_stage_end(stage)
+#else
+    #define PROF_BEGIN(stage)
+    #define PROF_END(stage)
+#endif
+
+#endif // PROFILER_H
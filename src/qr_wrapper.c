@@ -14,7 +14,8 @@
 #pragma bank 255  // Autobanked
 
 
-// See qrcodegen.h for setting the QR code version/capacity
+// See qrcodegen.h for the QR code version range/capacity,
+// the smallest version that fits the payload is selected at runtime
 
 #define SCALE 1  // pixel size multiplier for output rendering
 
@@ -27,11 +28,8 @@ static void qr_render_scale_1_1bpp_direct(void);
 
 bool qr_generate(const char * embed_str, uint16_t len) BANKED {
 
-    if (len > QR_MAX_PAYLOAD_BYTES) {
-        // Optionally emit an error here that size was too large
-        EMU_printf("Input size too large! %d > %d\n", (uint16_t)len, (uint16_t)QR_MAX_PAYLOAD_BYTES);
-        return false;
-    }
+    // No length check up front, how much fits depends on the segment modes.
+    // qrcodegen() returns NULL if it doesn't fit in QR_VERSION_MAX
 
     // Bank switching is needed for non-direct buffer access renders,
     // which allows this source file to be auto-banked.
@@ -43,12 +41,23 @@ bool qr_generate(const char * embed_str, uint16_t len) BANKED {
     // PLAT_SWITCH_ROM(BANK(qrcodegen));
 
     EMU_PROFILE_BEGIN(" QRCode Gen prof start ");
-    qrcodegen(embed_str, len);
+    const uint8_t * p_qrcode = qrcodegen(embed_str, len);
     EMU_PROFILE_END(" QRCode Gen prof end: ");
 
     // PLAT_SWITCH_ROM(save_bank);
 
-    return true;
+    return (p_qrcode != NULL);
+}
+
+
+// Finishes a QR Code whose data was streamed in with qrcodegen_stream_begin() / qrcodegen_stream_append()
+bool qr_generate_stream_end(void) BANKED {
+
+    EMU_PROFILE_BEGIN(" QRCode Gen prof start ");
+    const uint8_t * p_qrcode = qrcodegen_stream_end();
+    EMU_PROFILE_END(" QRCode Gen prof end: ");
+
+    return (p_qrcode != NULL);
 }
 
 
@@ -102,11 +111,10 @@ const uint8_t mirror_bits[256] = {
 };
 
 
-#define QR_TILE_X_START  1u
-#define QR_TILE_Y_START  0u
-
-#define QR_WIDTH_TILES      ((QRSIZE + (TILE_SZ_PX - 1u)) / TILE_SZ_PX)
-#define QR_HEIGHT_TILES     ((QRSIZE + (TILE_SZ_PX - 1u)) / TILE_SZ_PX)
+// QR Code size varies with the selected version, so it gets centered on the
+// screen at render time (version 31 fills 18 x 18 tiles at tile X:1, Y:0)
+#define QR_WIDTH_TILES      ((qr_size + (TILE_SZ_PX - 1u)) / TILE_SZ_PX)
+#define QR_HEIGHT_TILES     ((qr_size + (TILE_SZ_PX - 1u)) / TILE_SZ_PX)
 //
 // Profiling:
 //   Needs horizontal tile mirroring:  _qr_render       398658
@@ -123,41 +131,60 @@ static void qr_render_scale_1_1bpp_direct(void) {
     DISPLAY_OFF;
     const uint8_t * p_qr_src_buf = QRCODE;
 
+    const uint8_t width_tiles  = QR_WIDTH_TILES;
+    const uint8_t height_tiles = QR_HEIGHT_TILES;
+    const uint8_t tile_x_start = (DEVICE_SCREEN_WIDTH  - width_tiles) / 2u;
+    const uint8_t tile_y_start = (DEVICE_SCREEN_HEIGHT - height_tiles) / 2u;
+
     // Start at first tile in vram
     // APA mode layout is 20 tiles wide x 18 tiles tall, starting at 0x8100
     // Offset to the starting tile of where to draw the QRCode
-    uint8_t * p_vram = APA_MODE_VRAM_START + (((QR_TILE_Y_START * DEVICE_SCREEN_WIDTH) + QR_TILE_X_START) * TILE_SZ_BYTES);
+    uint8_t * p_vram = APA_MODE_VRAM_START + (((tile_y_start * DEVICE_SCREEN_WIDTH) + tile_x_start) * TILE_SZ_BYTES);
 
     // Clear VRAM, this render will only be writing very other byte due to 1bpp source format
     memset(APA_MODE_VRAM_START, 0u, APA_MODE_VRAM_SZ);
 
     // Calculate a tile mask to fix up stray pixels on the right edge of the QRcode when it's width isn't an even multiple of 8 (tile width)
-    const uint8_t right_edge_tile_row_mask = ~((1u << (8u - (QRSIZE % 8u))) - 1u);
+    // (QR Code sizes are always odd, so there is always a partial tile on the right edge)
+    const uint8_t right_edge_tile_row_mask = ~((1u << (8u - (qr_size % 8u))) - 1u);
+
+    // QRCode rows use a fixed stride sized for the largest version, skip the unused bytes at the end of each row
+    const uint8_t src_row_skip = QR_OUTPUT_ROW_SZ_BYTES - width_tiles;
 
     // The -2 is to rewind but then step down to the next 2bpp row in the tile
-    const uint16_t next_line_row_rewind = (QR_WIDTH_TILES * TILE_SZ_BYTES) - 2u;
+    const uint16_t next_line_row_rewind = (width_tiles * TILE_SZ_BYTES) - 2u;
 
     // +2 is to wrap to the first bpp row of the next tile from the 1bpp end of the last tile in the row
     // -1 tiles is for after the end of a tile row it will be pointing one tile into the rowstride area (and so 1 needs to be skipped)
-    const uint16_t next_row_of_tiles    = (((DEVICE_SCREEN_WIDTH - QR_WIDTH_TILES) -1u) * TILE_SZ_BYTES) + 2u;
+    const uint16_t next_row_of_tiles    = (((DEVICE_SCREEN_WIDTH - width_tiles) -1u) * TILE_SZ_BYTES) + 2u;
 
-    for (uint8_t tile_y = 0; tile_y < QR_WIDTH_TILES; tile_y++) {
+    // Rows past the bottom edge of the QRCode are left blank from the VRAM clear
+    uint8_t rows_left = qr_size;
+
+    for (uint8_t tile_y = 0; tile_y < height_tiles; tile_y++) {
 
         // Step through a row of tiles (i.e. N tiles wide x 8 pixels tall)
         uint8_t tile_height;
         for (tile_height = 0; tile_height < TILE_SZ_PX; tile_height++) {
 
-            // Steps across row N of each adjacent tile, picking off the first 1bpp byte
-            uint8_t tile_x;
-            for (tile_x = 0; tile_x < QR_WIDTH_TILES; tile_x++) {
+            if (rows_left) {
+                rows_left--;
+
+                // Steps across row N of each adjacent tile, picking off the first 1bpp byte
+                uint8_t tile_x;
+                for (tile_x = 0; tile_x < width_tiles; tile_x++) {
+
+                    // Need to horizontally mirror tile bits to convert QRCode format into to GB Tile format
+                    *p_vram = mirror_bits[*p_qr_src_buf++];
+                    p_vram += TILE_SZ_BYTES;
+                }
+                p_qr_src_buf += src_row_skip;
 
-                // Need to horizontally mirror tile bits to convert QRCode format into to GB Tile format
-                *p_vram = mirror_bits[*p_qr_src_buf++];
-                p_vram += TILE_SZ_BYTES;
+                // Fix up rightmost edge of QRCode when it's width isn't an even multiple of 8 (tile width size)
+                // Alternative to the box() version below that's apparently much slower
+                *(p_vram - TILE_SZ_BYTES) &= right_edge_tile_row_mask;
             }
-            // Fix up rightmost edge of QRCode when it's width isn't an even multiple of 8 (tile width size)
-            // Alternative to the box() version below that's apparently much slower
-            *(p_vram - TILE_SZ_BYTES) &= right_edge_tile_row_mask;
+            else p_vram += width_tiles * TILE_SZ_BYTES;
 
             // Go to start of next scanline within the 8 pixel tall tile row
             // except on the very last tile row (to make calc to next tile row easier)
@@ -172,11 +199,11 @@ static void qr_render_scale_1_1bpp_direct(void) {
     //
     // Slower alternative to the right_edge_tile_row_mask version above
     // color(WHITE,WHITE,SOLID);
-    // box(QRSIZE, 0, QRSIZE+2, QR_FINAL_PIXEL_HEIGHT, M_FILL);
+    // box(qr_size, 0, qr_size+2, QR_FINAL_PIXEL_HEIGHT, M_FILL);
     //
     // Lil' Hacky
     // Tile on screen to the left white border side of the screen outside of the QRCode
-    // at size 31 which should be blank
+    // which should be blank (the QRCode is at most 18 tiles wide and centered)
     const uint8_t white_tile_index = 16u;
     // Now fix up the -1,-1 screen scroll wraparound border area tiles with the white tile
     fill_bkg_rect(DEVICE_SCREEN_BUFFER_WIDTH - 1u, 0u,  1u,  DEVICE_SCREEN_BUFFER_HEIGHT, white_tile_index);
@@ -5,6 +5,7 @@
 #define _QR_WRAPPER_H
 
 bool qr_generate(const char * embed_str, uint16_t len) BANKED;
+bool qr_generate_stream_end(void) BANKED;
 void qr_render(void) BANKED;
 
 #endif // _QR_WRAPPER_H
\ No newline at end of file
@@ -0,0 +1,87 @@
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "qrcodegen.h"
+
+#pragma bank 255 // Autobanked
+
+BANKREF(qrcode_rs_generators)
+
+// Reed-Solomon divisor (generator) polynomials for degrees 1 - 30, packed one after another
+// so degree N starts at index (N * (N - 1)) / 2. Coefficients are highest to lowest power,
+// excluding the leading 1. Generated with: reedsolomon_mmul_lut gen
+
+#if (QR_RS_ENGINE == QR_RS_ENGINE_LOG_EXP)
+
+// In log form (base 0x02)
+const uint8_t rs_generators[] = {
+    0x00u, // 1
+    0x19u, 0x01u, // 2
+    0xC6u, 0xC7u, 0x03u, // 3
+    0x4Bu, 0xF9u, 0x4Eu, 0x06u, // 4
+    0x71u, 0xA4u, 0xA6u, 0x77u, 0x0Au, // 5
+    0xA6u, 0x00u, 0x86u, 0x05u, 0xB0u, 0x0Fu, // 6
+    0x57u, 0xE5u, 0x92u, 0x95u, 0xEEu, 0x66u, 0x15u, // 7
+    0xAFu, 0xEEu, 0xD0u, 0xF9u, 0xD7u, 0xFCu, 0xC4u, 0x1Cu, // 8
+    0x5Fu, 0xF6u, 0x89u, 0xE7u, 0xEBu, 0x95u, 0x0Bu, 0x7Bu, 0x24u, // 9
+    0xFBu, 0x43u, 0x2Eu, 0x3Du, 0x76u, 0x46u, 0x40u, 0x5Eu, 0x20u, 0x2Du, // 10
+    0xDCu, 0xC0u, 0x5Bu, 0xC2u, 0xACu, 0xB1u, 0xD1u, 0x74u, 0xE3u, 0x0Au, 0x37u, // 11
+    0x66u, 0x2Bu, 0x62u, 0x79u, 0xBBu, 0x71u, 0xC6u, 0x8Fu, 0x83u, 0x57u, 0x9Du, 0x42u, // 12
+    0x4Au, 0x98u, 0xB0u, 0x64u, 0x56u, 0x64u, 0x6Au, 0x68u, 0x82u, 0xDAu, 0xCEu, 0x8Cu, 0x4Eu, // 13
+    0xC7u, 0xF9u, 0x9Bu, 0x30u, 0xBEu, 0x7Cu, 0xDAu, 0x89u, 0xD8u, 0x57u, 0xCFu, 0x3Bu, 0x16u, 0x5Bu, // 14
+    0x08u, 0xB7u, 0x3Du, 0x5Bu, 0xCAu, 0x25u, 0x33u, 0x3Au, 0x3Au, 0xEDu, 0x8Cu, 0x7Cu, 0x05u, 0x63u, 0x69u, // 15
+    0x78u, 0x68u, 0x6Bu, 0x6Du, 0x66u, 0xA1u, 0x4Cu, 0x03u, 0x5Bu, 0xBFu, 0x93u, 0xA9u, 0xB6u, 0xC2u, 0xE1u, 0x78u, // 16
+    0x2Bu, 0x8Bu, 0xCEu, 0x4Eu, 0x2Bu, 0xEFu, 0x7Bu, 0xCEu, 0xD6u, 0x93u, 0x18u, 0x63u, 0x96u, 0x27u, 0xF3u, 0xA3u, 0x88u, // 17
+    0xD7u, 0xEAu, 0x9Eu, 0x5Eu, 0xB8u, 0x61u, 0x76u, 0xAAu, 0x4Fu, 0xBBu, 0x98u, 0x94u, 0xFCu, 0xB3u, 0x05u, 0x62u, 0x60u, 0x99u, // 18
+    0x43u, 0x03u, 0x69u, 0x99u, 0x34u, 0x5Au, 0x53u, 0x11u, 0x96u, 0x9Fu, 0x2Cu, 0x80u, 0x99u, 0x85u, 0xFCu, 0xDEu, 0x8Au, 0xDCu, 0xABu, // 19
+    0x11u, 0x3Cu, 0x4Fu, 0x32u, 0x3Du, 0xA3u, 0x1Au, 0xBBu, 0xCAu, 0xB4u, 0xDDu, 0xE1u, 0x53u, 0xEFu, 0x9Cu, 0xA4u, 0xD4u, 0xD4u, 0xBCu, 0xBEu, // 20
+    0xF0u, 0xE9u, 0x68u, 0xF7u, 0xB5u, 0x8Cu, 0x43u, 0x62u, 0x55u, 0xC8u, 0xD2u, 0x73u, 0x94u, 0x89u, 0xE6u, 0x24u, 0x7Au, 0xFEu, 0x94u, 0xAFu, 0xD2u, // 21
+    0xD2u, 0xABu, 0xF7u, 0xF2u, 0x5Du, 0xE6u, 0x0Eu, 0x6Du, 0xDDu, 0x35u, 0xC8u, 0x4Au, 0x08u, 0xACu, 0x62u, 0x50u, 0xDBu, 0x86u, 0xA0u, 0x69u, 0xA5u, 0xE7u, // 22
+    0xABu, 0x66u, 0x92u, 0x5Bu, 0x31u, 0x67u, 0x41u, 0x11u, 0xC1u, 0x96u, 0x0Eu, 0x19u, 0xB7u, 0xF8u, 0x5Eu, 0xA4u, 0xE0u, 0xC0u, 0x01u, 0x4Eu, 0x38u, 0x93u, 0xFDu, // 23
+    0xE5u, 0x79u, 0x87u, 0x30u, 0xD3u, 0x75u, 0xFBu, 0x7Eu, 0x9Fu, 0xB4u, 0xA9u, 0x98u, 0xC0u, 0xE2u, 0xE4u, 0xDAu, 0x6Fu, 0x00u, 0x75u, 0xE8u, 0x57u, 0x60u, 0xE3u, 0x15u, // 24
+    0xE7u, 0xB5u, 0x9Cu, 0x27u, 0xAAu, 0x1Au, 0x0Cu, 0x3Bu, 0x0Fu, 0x94u, 0xC9u, 0x36u, 0x42u, 0xEDu, 0xD0u, 0x63u, 0xA7u, 0x90u, 0xB6u, 0x5Fu, 0xF3u, 0x81u, 0xB2u, 0xFCu, 0x2Du, // 25
+    0xADu, 0x7Du, 0x9Eu, 0x02u, 0x67u, 0xB6u, 0x76u, 0x11u, 0x91u, 0xC9u, 0x6Fu, 0x1Cu, 0xA5u, 0x35u, 0xA1u, 0x15u, 0xF5u, 0x8Eu, 0x0Du, 0x66u, 0x30u, 0xE3u, 0x99u, 0x91u, 0xDAu, 0x46u, // 26
+    0x4Fu, 0xE4u, 0x08u, 0xA5u, 0xE3u, 0x15u, 0xB4u, 0x1Du, 0x09u, 0xEDu, 0x46u, 0x63u, 0x2Du, 0x3Au, 0x8Au, 0x87u, 0x49u, 0x7Eu, 0xACu, 0x5Eu, 0xD8u, 0xC1u, 0x9Du, 0x1Au, 0x11u, 0x95u, 0x60u, // 27
+    0xA8u, 0xDFu, 0xC8u, 0x68u, 0xE0u, 0xEAu, 0x6Cu, 0xB4u, 0x6Eu, 0xBEu, 0xC3u, 0x93u, 0xCDu, 0x1Bu, 0xE8u, 0xC9u, 0x15u, 0x2Bu, 0xF5u, 0x57u, 0x2Au, 0xC3u, 0xD4u, 0x77u, 0xF2u, 0x25u, 0x09u, 0x7Bu, // 28
+    0x9Cu, 0x2Du, 0xB7u, 0x1Du, 0x97u, 0xDBu, 0x36u, 0x60u, 0xF9u, 0x18u, 0x88u, 0x05u, 0xF1u, 0xAFu, 0xBDu, 0x1Cu, 0x4Bu, 0xEAu, 0x96u, 0x94u, 0x17u, 0x09u, 0xCAu, 0xA2u, 0x44u, 0xFAu, 0x8Cu, 0x18u, 0x97u, // 29
+    0x29u, 0xADu, 0x91u, 0x98u, 0xD8u, 0x1Fu, 0xB3u, 0xB6u, 0x32u, 0x30u, 0x6Eu, 0x56u, 0xEFu, 0x60u, 0xDEu, 0x7Du, 0x2Au, 0xADu, 0xE2u, 0xC1u, 0xE0u, 0x82u, 0x9Cu, 0x25u, 0xFBu, 0xD8u, 0xEEu, 0x28u, 0xC0u, 0xB4u, // 30
+};
+
+#elif (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)
+
+const uint8_t rs_generators[] = {
+    0x01u, // 1
+    0x03u, 0x02u, // 2
+    0x07u, 0x0Eu, 0x08u, // 3
+    0x0Fu, 0x36u, 0x78u, 0x40u, // 4
+    0x1Fu, 0xC6u, 0x3Fu, 0x93u, 0x74u, // 5
+    0x3Fu, 0x01u, 0xDAu, 0x20u, 0xE3u, 0x26u, // 6
+    0x7Fu, 0x7Au, 0x9Au, 0xA4u, 0x0Bu, 0x44u, 0x75u, // 7
+    0xFFu, 0x0Bu, 0x51u, 0x36u, 0xEFu, 0xADu, 0xC8u, 0x18u, // 8
+    0xE2u, 0xCFu, 0x9Eu, 0xF5u, 0xEBu, 0xA4u, 0xE8u, 0xC5u, 0x25u, // 9
+    0xD8u, 0xC2u, 0x9Fu, 0x6Fu, 0xC7u, 0x5Eu, 0x5Fu, 0x71u, 0x9Du, 0xC1u, // 10
+    0xACu, 0x82u, 0xA3u, 0x32u, 0x7Bu, 0xDBu, 0xA2u, 0xF8u, 0x90u, 0x74u, 0xA0u, // 11
+    0x44u, 0x77u, 0x43u, 0x76u, 0xDCu, 0x1Fu, 0x07u, 0x54u, 0x5Cu, 0x7Fu, 0xD5u, 0x61u, // 12
+    0x89u, 0x49u, 0xE3u, 0x11u, 0xB1u, 0x11u, 0x34u, 0x0Du, 0x2Eu, 0x2Bu, 0x53u, 0x84u, 0x78u, // 13
+    0x0Eu, 0x36u, 0x72u, 0x46u, 0xAEu, 0x97u, 0x2Bu, 0x9Eu, 0xC3u, 0x7Fu, 0xA6u, 0xD2u, 0xEAu, 0xA3u, // 14
+    0x1Du, 0xC4u, 0x6Fu, 0xA3u, 0x70u, 0x4Au, 0x0Au, 0x69u, 0x69u, 0x8Bu, 0x84u, 0x97u, 0x20u, 0x86u, 0x1Au, // 15
+    0x3Bu, 0x0Du, 0x68u, 0xBDu, 0x44u, 0xD1u, 0x1Eu, 0x08u, 0xA3u, 0x41u, 0x29u, 0xE5u, 0x62u, 0x32u, 0x24u, 0x3Bu, // 16
+    0x77u, 0x42u, 0x53u, 0x78u, 0x77u, 0x16u, 0xC5u, 0x53u, 0xF9u, 0x29u, 0x8Fu, 0x86u, 0x55u, 0x35u, 0x7Du, 0x63u, 0x4Fu, // 17
+    0xEFu, 0xFBu, 0xB7u, 0x71u, 0x95u, 0xAFu, 0xC7u, 0xD7u, 0xF0u, 0xDCu, 0x49u, 0x52u, 0xADu, 0x4Bu, 0x20u, 0x43u, 0xD9u, 0x92u, // 18
+    0xC2u, 0x08u, 0x1Au, 0x92u, 0x14u, 0xDFu, 0xBBu, 0x98u, 0x55u, 0x73u, 0xEEu, 0x85u, 0x92u, 0x6Du, 0xADu, 0x8Au, 0x21u, 0xACu, 0xB3u, // 19
+    0x98u, 0xB9u, 0xF0u, 0x05u, 0x6Fu, 0x63u, 0x06u, 0xDCu, 0x70u, 0x96u, 0x45u, 0x24u, 0xBBu, 0x16u, 0xE4u, 0xC6u, 0x79u, 0x79u, 0xA5u, 0xAEu, // 20
+    0x2Cu, 0xF3u, 0x0Du, 0x83u, 0x31u, 0x84u, 0xC2u, 0x43u, 0xD6u, 0x1Cu, 0x59u, 0x7Cu, 0x52u, 0x9Eu, 0xF4u, 0x25u, 0xECu, 0x8Eu, 0x52u, 0xFFu, 0x59u, // 21
+    0x59u, 0xB3u, 0x83u, 0xB0u, 0xB6u, 0xF4u, 0x13u, 0xBDu, 0x45u, 0x28u, 0x1Cu, 0x89u, 0x1Du, 0x7Bu, 0x43u, 0xFDu, 0x56u, 0xDAu, 0xE6u, 0x1Au, 0x91u, 0xF5u, // 22
+    0xB3u, 0x44u, 0x9Au, 0xA3u, 0x8Cu, 0x88u, 0xBEu, 0x98u, 0x19u, 0x55u, 0x13u, 0x03u, 0xC4u, 0x1Bu, 0x71u, 0xC6u, 0x12u, 0x82u, 0x02u, 0x78u, 0x5Du, 0x29u, 0x47u, // 23
+    0x7Au, 0x76u, 0xA9u, 0x46u, 0xB2u, 0xEDu, 0xD8u, 0x66u, 0x73u, 0x96u, 0xE5u, 0x49u, 0x82u, 0x48u, 0x3Du, 0x2Bu, 0xCEu, 0x01u, 0xEDu, 0xF7u, 0x7Fu, 0xD9u, 0x90u, 0x75u, // 24
+    0xF5u, 0x31u, 0xE4u, 0x35u, 0xD7u, 0x06u, 0xCDu, 0xD2u, 0x26u, 0x52u, 0x38u, 0x50u, 0x61u, 0x8Bu, 0x51u, 0x86u, 0x7Eu, 0xA8u, 0x62u, 0xE2u, 0x7Du, 0x17u, 0xABu, 0xADu, 0xC1u, // 25
+    0xF6u, 0x33u, 0xB7u, 0x04u, 0x88u, 0x62u, 0xC7u, 0x98u, 0x4Du, 0x38u, 0xCEu, 0x18u, 0x91u, 0x28u, 0xD1u, 0x75u, 0xE9u, 0x2Au, 0x87u, 0x44u, 0x46u, 0x90u, 0x92u, 0x4Du, 0x2Bu, 0x5Eu, // 26
+    0xF0u, 0x3Du, 0x1Du, 0x91u, 0x90u, 0x75u, 0x96u, 0x30u, 0x3Au, 0x8Bu, 0x5Eu, 0x86u, 0xC1u, 0x69u, 0x21u, 0xA9u, 0xCAu, 0x66u, 0x7Bu, 0x71u, 0xC3u, 0x19u, 0xD5u, 0x06u, 0x98u, 0xA4u, 0xD9u, // 27
+    0xFCu, 0x09u, 0x1Cu, 0x0Du, 0x12u, 0xFBu, 0xD0u, 0x96u, 0x67u, 0xAEu, 0x64u, 0x29u, 0xA7u, 0x0Cu, 0xF7u, 0x38u, 0x75u, 0x77u, 0xE9u, 0x7Fu, 0xB5u, 0x64u, 0x79u, 0x93u, 0xB0u, 0x4Au, 0x3Au, 0xC5u, // 28
+    0xE4u, 0xC1u, 0xC4u, 0x30u, 0xAAu, 0x56u, 0x50u, 0xD9u, 0x36u, 0x8Fu, 0x4Fu, 0x20u, 0x58u, 0xFFu, 0x57u, 0x18u, 0x0Fu, 0xFBu, 0x55u, 0x52u, 0xC9u, 0x3Au, 0x70u, 0xBFu, 0x99u, 0x6Cu, 0x84u, 0x8Fu, 0xAAu, // 29
+    0xD4u, 0xF6u, 0x4Du, 0x49u, 0xC3u, 0xC0u, 0x4Bu, 0x62u, 0x05u, 0x46u, 0x67u, 0xB1u, 0x16u, 0xD9u, 0x8Au, 0x33u, 0xB5u, 0xF6u, 0x48u, 0x19u, 0x12u, 0x2Eu, 0xE4u, 0x4Au, 0xD8u, 0xC3u, 0x0Bu, 0x6Au, 0x82u, 0x96u, // 30
+};
+
+#endif // QR_RS_ENGINE
+
@@ -1,7 +1,14 @@
+#include <gbdk/platform.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "qrcodegen.h"
 
 #pragma bank 1 // Autobanked
 
+// Only used with the banked LUT Reed-Solomon engine, see QR_RS_ENGINE in qrcodegen.h
+#if (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)
+
 // Reed Solomon Multiply LUT x:(0 -> 63)
 
 const uint8_t reed_solomon_mul_lut_1[] = {
@@ -519,4 +526,6 @@ const uint8_t reed_solomon_mul_lut_1[] = {
     0x3E, 0x01, 0x40, 0x7F, 0xC2, 0xFD, 0xBC, 0x83, 0xDB, 0xE4, 0xA5, 0x9A, 0x27, 0x18, 0x59, 0x66, 0xE9, 0xD6, 0x97, 0xA8, 0x15, 0x2A, 0x6B, 0x54, 0x0C, 0x33, 0x72, 0x4D, 0xF0, 0xCF, 0x8E, 0xB1, 
 };
 
+#endif // QR_RS_ENGINE_LUT_BANKED
+
 
@@ -1,7 +1,14 @@
+#include <gbdk/platform.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "qrcodegen.h"
 
 #pragma bank 2 // Autobanked
 
+// Only used with the banked LUT Reed-Solomon engine, see QR_RS_ENGINE in qrcodegen.h
+#if (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)
+
 // Reed Solomon Multiply LUT x:(64 -> 127)
 
 const uint8_t reed_solomon_mul_lut_2[] = {
@@ -519,4 +526,6 @@ const uint8_t reed_solomon_mul_lut_2[] = {
     0x9C, 0xE3, 0x62, 0x1D, 0x7D, 0x02, 0x83, 0xFC, 0x43, 0x3C, 0xBD, 0xC2, 0xA2, 0xDD, 0x5C, 0x23, 0x3F, 0x40, 0xC1, 0xBE, 0xDE, 0xA1, 0x20, 0x5F, 0xE0, 0x9F, 0x1E, 0x61, 0x01, 0x7E, 0xFF, 0x80, 
 };
 
+#endif // QR_RS_ENGINE_LUT_BANKED
+
 
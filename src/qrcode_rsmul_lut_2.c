@@ -1,7 +1,14 @@
+#include <gbdk/platform.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "qrcodegen.h"
 
 #pragma bank 3 // Autobanked
 
+// Only used with the banked LUT Reed-Solomon engine, see QR_RS_ENGINE in qrcodegen.h
+#if (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)
+
 // Reed Solomon Multiply LUT x:(128 -> 191)
 
 const uint8_t reed_solomon_mul_lut_3[] = {
@@ -519,4 +526,6 @@ const uint8_t reed_solomon_mul_lut_3[] = {
     0x67, 0xD8, 0x04, 0xBB, 0xA1, 0x1E, 0xC2, 0x7D, 0xF6, 0x49, 0x95, 0x2A, 0x30, 0x8F, 0x53, 0xEC, 0x58, 0xE7, 0x3B, 0x84, 0x9E, 0x21, 0xFD, 0x42, 0xC9, 0x76, 0xAA, 0x15, 0x0F, 0xB0, 0x6C, 0xD3, 
 };
 
+#endif // QR_RS_ENGINE_LUT_BANKED
+
 
@@ -1,7 +1,14 @@
+#include <gbdk/platform.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+#include "qrcodegen.h"
 
 #pragma bank 4 // Autobanked
 
+// Only used with the banked LUT Reed-Solomon engine, see QR_RS_ENGINE in qrcodegen.h
+#if (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)
+
 // Reed Solomon Multiply LUT x:(192 -> 255)
 
 const uint8_t reed_solomon_mul_lut_4[] = {
@@ -519,4 +526,6 @@ const uint8_t reed_solomon_mul_lut_4[] = {
     0xC5, 0x3A, 0x26, 0xD9, 0x1E, 0xE1, 0xFD, 0x02, 0x6E, 0x91, 0x8D, 0x72, 0xB5, 0x4A, 0x56, 0xA9, 0x8E, 0x71, 0x6D, 0x92, 0x55, 0xAA, 0xB6, 0x49, 0x25, 0xDA, 0xC6, 0x39, 0xFE, 0x01, 0x1D, 0xE2, 
 };
 
+#endif // QR_RS_ENGINE_LUT_BANKED
+
 
@@ -42,9 +42,15 @@ BANKREF(qrcodegen)
 
     #define debugBorder(a) do {} while(false)  // TODO
     #define INLINE inline
-    #define QRVERSION 8
+    #define QR_VERSION_MAX 8
+    #define QR_RS_ENGINE_LOG_EXP 0
+    #define QR_RS_ENGINE QR_RS_ENGINE_LOG_EXP
+    #define QR_MASK_SELECT_BEST 1
+    #define QR_MASK_SELECT QR_MASK_SELECT_BEST
+    #define QR_MASK_FIXED 0
+    #define QR_MASK_CANDIDATES 0xFFu
+    #define ARRAY_LEN(A)  (sizeof(A) / sizeof(A[0]))
     #define QRECL qrcodegen_Ecc_MEDIUM
-    #define QRSIZE (QRVERSION * 4 + 17)
     #define QRPAD 64
     uint8_t *qrcodegen(const char *text);
 #endif
@@ -57,7 +63,9 @@ BANKREF(qrcodegen)
     #include <stdlib.h>
     #include <stdio.h>
 
+    #include "common.h"
     #include "qrcodegen.h"
+    #include "profiler.h"
     #define INLINE inline
     #define size_t uint16_t
 #endif
@@ -86,64 +94,88 @@ enum qrcodegen_Mask {
 	qrcodegen_Mask_6,
 	qrcodegen_Mask_7,
 };
-// THIS VERSION SUPPORTS ONLY MASK 0
-#define MASK qrcodegen_Mask_0
-
-enum qrcodegen_Mode {
-	qrcodegen_Mode_NUMERIC      = 0x1,
-	qrcodegen_Mode_ALPHANUMERIC = 0x2,  // 0–9, A–Z (upper-case only), space, $, %, *, +, -, ., /, :   Note: No semicolon as needed for mime header
-	qrcodegen_Mode_BYTE         = 0x4,
-	qrcodegen_Mode_KANJI        = 0x8,
-	qrcodegen_Mode_ECI          = 0x7,
-};
-// THIS VERSION SUPPORTS ONLY BYTE MODE
-#define MODE qrcodegen_Mode_BYTE
+// Mask is picked at runtime, see QR_MASK_SELECT in the header
+
+// Segment modes are in the header (numeric, alphanumeric and byte are supported)
 
 // #define qrcodegen_BUFFER_SZ  (QRPAD * QRSIZE/8)
-#define qrcodegen_BUFFER_SZ  (QR_OUTPUT_ROW_SZ_BYTES * QR_FINAL_PIXEL_HEIGHT)
+#define qrcodegen_BUFFER_SZ  (QR_OUTPUT_ROW_SZ_BYTES * QR_FINAL_PIXEL_HEIGHT_MAX)
 
 // TODO: OPTIONAL: Could move TMPBUFFER into SRAM (it's ~2.5K at max QR Size)
 uint8_t TMPBUFFER[qrcodegen_BUFFER_SZ];
 uint8_t QRCODE[qrcodegen_BUFFER_SZ];
 
-#define qrcodegen_REED_SOLOMON_DEGREE_MAX 30  // Based on the table ECC_CODEWORDS_PER_BLOCK_D
-
-#define  SKIP1(a,...) __VA_ARGS__,a
-#define  SKIP2(...)    SKIP1H(SKIP1(__VA_ARGS__))
-#define  SKIP4(...)   SKIP2H(SKIP2(__VA_ARGS__))
-#define  SKIP8(...)   SKIP4H(SKIP4(__VA_ARGS__))
-#define  SKIP16(...)  SKIP8H(SKIP8(__VA_ARGS__))
-#define  SKIP32(...) SKIP16H(SKIP16(__VA_ARGS__))
-
-#define  SKIP1H(...)   SKIP1(__VA_ARGS__)
-#define  SKIP2H(...)   SKIP2(__VA_ARGS__)
-#define  SKIP4H(...)   SKIP4(__VA_ARGS__)
-#define  SKIP8H(...)   SKIP8(__VA_ARGS__)
-#define  SKIP16H(...)   SKIP16(__VA_ARGS__)
-
+// Selected at the start of qrcodegen() based on payload length
+uint8_t qr_version;
+uint8_t qr_size;
 
-#define SELECT1_H(a,...)  (a)
-#define SELECT1(...) SELECT1_H(__VA_ARGS__)
-#define SELECT2(n, ...)  (n< 1?  SELECT1(__VA_ARGS__):  SELECT1(SKIP1(__VA_ARGS__)))
-#define SELECT4(n, ...)  (n< 2?  SELECT2(n,__VA_ARGS__):  SELECT2((n- 2),  SKIP2(__VA_ARGS__)))
-#define SELECT8(n, ...)  (n< 4?  SELECT4(n,__VA_ARGS__):  SELECT4((n- 4),  SKIP4(__VA_ARGS__)))
-#define SELECT16(n, ...) (n< 8?  SELECT8(n,__VA_ARGS__):  SELECT8((n- 8),  SKIP8(__VA_ARGS__)))
-#define SELECT32(n, ...) (n<16? SELECT16(n,__VA_ARGS__): SELECT16((n-16), SKIP16(__VA_ARGS__)))
-#define SELECT64(n, ...) (n<32? SELECT32(n,__VA_ARGS__): SELECT32((n-32), SKIP32(__VA_ARGS__)))
+#define qrcodegen_REED_SOLOMON_DEGREE_MAX 30  // Based on the table ECC_CODEWORDS_PER_BLOCK_D
 
-#define SELECT(n, ...) SELECT64(n,__VA_ARGS__)
+// Tables indexed by [Error Correction Level][Version], index 0 is unused (-1)
+static const int8_t ECC_CODEWORDS_PER_BLOCK[4][41] = {
+	// Version: (note that index 0 is for padding, and is set to an illegal value)
+	//0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40    Error correction level
+	{-1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // Low
+	{-1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},  // Medium
+	{-1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // Quartile
+	{-1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},  // High
+};
 
-#define ECC_CODEWORDS_PER_BLOCK_D(e, v, ...) SELECT(e, \
-    SELECT(v, -1,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30), \
-    SELECT(v, -1, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28), \
-    SELECT(v, -1, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30), \
-    SELECT(v, -1, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30))   
+static const int8_t NUM_ERROR_CORRECTION_BLOCKS[4][41] = {
+	// Version: (note that index 0 is for padding, and is set to an illegal value)
+	//0, 1, 2, 3, 4, 5, 6, 7, 8, 9,10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40    Error correction level
+	{-1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},  // Low
+	{-1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},  // Medium
+	{-1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},  // Quartile
+	{-1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},  // High
+};
 
-#define NUM_ERROR_CORRECTION_BLOCKS_D(e, v, ...) SELECT(e, \
-    SELECT(v, -1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25), \
-    SELECT(v, -1, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49), \
-    SELECT(v, -1, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68), \
-    SELECT(v, -1, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81))   
+// Alignment pattern center positions per version (used on both the x and y axes)
+// The number of used entries is: (version == 1) ? 0 : (version / 7 + 2)
+#define ALIGNMENT_PATTERN_POSITIONS_MAX 7u
+static const uint8_t ALIGNMENT_PATTERN_POSITIONS[41][ALIGNMENT_PATTERN_POSITIONS_MAX] = {
+    {  0,   0,   0,   0,   0,   0,   0},  // 0
+    {  0,   0,   0,   0,   0,   0,   0},  // 1
+    {  6,  18,   0,   0,   0,   0,   0},  // 2
+    {  6,  22,   0,   0,   0,   0,   0},  // 3
+    {  6,  26,   0,   0,   0,   0,   0},  // 4
+    {  6,  30,   0,   0,   0,   0,   0},  // 5
+    {  6,  34,   0,   0,   0,   0,   0},  // 6
+    {  6,  22,  38,   0,   0,   0,   0},  // 7
+    {  6,  24,  42,   0,   0,   0,   0},  // 8
+    {  6,  26,  46,   0,   0,   0,   0},  // 9
+    {  6,  28,  50,   0,   0,   0,   0},  // 10
+    {  6,  30,  54,   0,   0,   0,   0},  // 11
+    {  6,  32,  58,   0,   0,   0,   0},  // 12
+    {  6,  34,  62,   0,   0,   0,   0},  // 13
+    {  6,  26,  46,  66,   0,   0,   0},  // 14
+    {  6,  26,  48,  70,   0,   0,   0},  // 15
+    {  6,  26,  50,  74,   0,   0,   0},  // 16
+    {  6,  30,  54,  78,   0,   0,   0},  // 17
+    {  6,  30,  56,  82,   0,   0,   0},  // 18
+    {  6,  30,  58,  86,   0,   0,   0},  // 19
+    {  6,  34,  62,  90,   0,   0,   0},  // 20
+    {  6,  28,  50,  72,  94,   0,   0},  // 21
+    {  6,  26,  50,  74,  98,   0,   0},  // 22
+    {  6,  30,  54,  78, 102,   0,   0},  // 23
+    {  6,  28,  54,  80, 106,   0,   0},  // 24
+    {  6,  32,  58,  84, 110,   0,   0},  // 25
+    {  6,  30,  58,  86, 114,   0,   0},  // 26
+    {  6,  34,  62,  90, 118,   0,   0},  // 27
+    {  6,  26,  50,  74,  98, 122,   0},  // 28
+    {  6,  30,  54,  78, 102, 126,   0},  // 29
+    {  6,  26,  52,  78, 104, 130,   0},  // 30
+    {  6,  30,  56,  82, 108, 134,   0},  // 31
+    {  6,  34,  60,  86, 112, 138,   0},  // 32
+    {  6,  30,  58,  86, 114, 142,   0},  // 33
+    {  6,  34,  62,  90, 118, 146,   0},  // 34
+    {  6,  30,  54,  78, 102, 126, 150},  // 35
+    {  6,  24,  50,  76, 102, 128, 154},  // 36
+    {  6,  28,  54,  80, 106, 132, 158},  // 37
+    {  6,  32,  58,  84, 110, 136, 162},  // 38
+    {  6,  26,  54,  82, 110, 138, 166},  // 39
+    {  6,  30,  58,  86, 114, 142, 170},  // 40
+};
 
 
 
@@ -183,7 +215,7 @@ INLINE void setModule(uint8_t qrcode[], uint8_t x, uint8_t y, bool isBlack) {
 static void setModuleStatic(uint8_t qrcode[], uint8_t x, uint8_t y, bool isBlack) { setModule(qrcode, x, y, isBlack); }
 bool qr_get(uint8_t x, uint8_t y) { return getModule(QRCODE,x,y); }
 static void setModuleBounded(uint8_t qrcode[], int x, int y, bool isBlack) {
-	if (0 <= x && x < QRSIZE && 0 <= y && y < QRSIZE)
+	if (0 <= x && x < qr_size && 0 <= y && y < qr_size)
 		setModule(qrcode, x, y, isBlack);
 }
 
@@ -209,11 +241,12 @@ uint8_t qr_get8(uint8_t x, uint8_t y) { return getModule8(QRCODE,x,y); }
 // Returns the number of data bytes that can be stored in a QR Code of the given version number, after
 // all function modules are excluded. This includes remainder bits, so it might not be a multiple of 8.
 // The result is in the range [208, 29648]. This could be implemented as a 40-entry lookup table.
-INLINE int getNumRawDataModules(void) {
-	int result = (16 * QRVERSION + 128) * QRVERSION + 64;
-	if (QRVERSION >= 2) {
-		result -= (25 * (QRVERSION / 7 + 2) - 10) * (QRVERSION / 7 + 2) - 55;
-		if (QRVERSION >= 7)
+// Note: Unlike upstream this returns bytes instead of bits
+static int getNumRawDataModules(uint8_t version) {
+	int result = (16 * version + 128) * version + 64;
+	if (version >= 2) {
+		result -= (25 * (version / 7 + 2) - 10) * (version / 7 + 2) - 55;
+		if (version >= 7)
 			result -= 36;
 	}
 	return result / 8;
@@ -221,10 +254,10 @@ INLINE int getNumRawDataModules(void) {
 
 // Returns the number of 8-bit codewords that can be used for storing data (not ECC),
 // for the given version number and error correction level. The result is in the range [9, 2956].
-INLINE int getNumDataCodewords(void) {
-	return getNumRawDataModules()
-		- ECC_CODEWORDS_PER_BLOCK_D(QRECL,QRVERSION)
-		* NUM_ERROR_CORRECTION_BLOCKS_D(QRECL,QRVERSION);;
+static int getNumDataCodewords(uint8_t version) {
+	return getNumRawDataModules(version)
+		- ECC_CODEWORDS_PER_BLOCK[QRECL][version]
+		* NUM_ERROR_CORRECTION_BLOCKS[QRECL][version];
 }
 
 
@@ -238,6 +271,97 @@ INLINE int getNumDataCodewords(void) {
 
 /*---- Reed-Solomon ECC generator functions ----*/
 
+// Set per QR Code based on the selected version
+static uint8_t RSDegree;
+
+static uint8_t rsdiv[qrcodegen_REED_SOLOMON_DEGREE_MAX];
+static uint8_t rsremainder[qrcodegen_REED_SOLOMON_DEGREE_MAX];
+
+
+#if (QR_RS_ENGINE == QR_RS_ENGINE_LOG_EXP)
+
+// GF(2^8/0x11D) antilog and log tables (generator 0x02)
+//
+// Both live in this bank next to the code using them, so lookups don't need any bank switching.
+// gf256_exp[255] repeats gf256_exp[0] (= 1) so that a log sum of exactly 255 doesn't need a fixup
+static const uint8_t gf256_exp[256] = {
+    0x01u, 0x02u, 0x04u, 0x08u, 0x10u, 0x20u, 0x40u, 0x80u, 0x1Du, 0x3Au, 0x74u, 0xE8u, 0xCDu, 0x87u, 0x13u, 0x26u,
+    0x4Cu, 0x98u, 0x2Du, 0x5Au, 0xB4u, 0x75u, 0xEAu, 0xC9u, 0x8Fu, 0x03u, 0x06u, 0x0Cu, 0x18u, 0x30u, 0x60u, 0xC0u,
+    0x9Du, 0x27u, 0x4Eu, 0x9Cu, 0x25u, 0x4Au, 0x94u, 0x35u, 0x6Au, 0xD4u, 0xB5u, 0x77u, 0xEEu, 0xC1u, 0x9Fu, 0x23u,
+    0x46u, 0x8Cu, 0x05u, 0x0Au, 0x14u, 0x28u, 0x50u, 0xA0u, 0x5Du, 0xBAu, 0x69u, 0xD2u, 0xB9u, 0x6Fu, 0xDEu, 0xA1u,
+    0x5Fu, 0xBEu, 0x61u, 0xC2u, 0x99u, 0x2Fu, 0x5Eu, 0xBCu, 0x65u, 0xCAu, 0x89u, 0x0Fu, 0x1Eu, 0x3Cu, 0x78u, 0xF0u,
+    0xFDu, 0xE7u, 0xD3u, 0xBBu, 0x6Bu, 0xD6u, 0xB1u, 0x7Fu, 0xFEu, 0xE1u, 0xDFu, 0xA3u, 0x5Bu, 0xB6u, 0x71u, 0xE2u,
+    0xD9u, 0xAFu, 0x43u, 0x86u, 0x11u, 0x22u, 0x44u, 0x88u, 0x0Du, 0x1Au, 0x34u, 0x68u, 0xD0u, 0xBDu, 0x67u, 0xCEu,
+    0x81u, 0x1Fu, 0x3Eu, 0x7Cu, 0xF8u, 0xEDu, 0xC7u, 0x93u, 0x3Bu, 0x76u, 0xECu, 0xC5u, 0x97u, 0x33u, 0x66u, 0xCCu,
+    0x85u, 0x17u, 0x2Eu, 0x5Cu, 0xB8u, 0x6Du, 0xDAu, 0xA9u, 0x4Fu, 0x9Eu, 0x21u, 0x42u, 0x84u, 0x15u, 0x2Au, 0x54u,
+    0xA8u, 0x4Du, 0x9Au, 0x29u, 0x52u, 0xA4u, 0x55u, 0xAAu, 0x49u, 0x92u, 0x39u, 0x72u, 0xE4u, 0xD5u, 0xB7u, 0x73u,
+    0xE6u, 0xD1u, 0xBFu, 0x63u, 0xC6u, 0x91u, 0x3Fu, 0x7Eu, 0xFCu, 0xE5u, 0xD7u, 0xB3u, 0x7Bu, 0xF6u, 0xF1u, 0xFFu,
+    0xE3u, 0xDBu, 0xABu, 0x4Bu, 0x96u, 0x31u, 0x62u, 0xC4u, 0x95u, 0x37u, 0x6Eu, 0xDCu, 0xA5u, 0x57u, 0xAEu, 0x41u,
+    0x82u, 0x19u, 0x32u, 0x64u, 0xC8u, 0x8Du, 0x07u, 0x0Eu, 0x1Cu, 0x38u, 0x70u, 0xE0u, 0xDDu, 0xA7u, 0x53u, 0xA6u,
+    0x51u, 0xA2u, 0x59u, 0xB2u, 0x79u, 0xF2u, 0xF9u, 0xEFu, 0xC3u, 0x9Bu, 0x2Bu, 0x56u, 0xACu, 0x45u, 0x8Au, 0x09u,
+    0x12u, 0x24u, 0x48u, 0x90u, 0x3Du, 0x7Au, 0xF4u, 0xF5u, 0xF7u, 0xF3u, 0xFBu, 0xEBu, 0xCBu, 0x8Bu, 0x0Bu, 0x16u,
+    0x2Cu, 0x58u, 0xB0u, 0x7Du, 0xFAu, 0xE9u, 0xCFu, 0x83u, 0x1Bu, 0x36u, 0x6Cu, 0xD8u, 0xADu, 0x47u, 0x8Eu, 0x01u,
+};
+
+// gf256_log[0] is undefined (zero has no log) and never read
+static const uint8_t gf256_log[256] = {
+    0x00u, 0x00u, 0x01u, 0x19u, 0x02u, 0x32u, 0x1Au, 0xC6u, 0x03u, 0xDFu, 0x33u, 0xEEu, 0x1Bu, 0x68u, 0xC7u, 0x4Bu,
+    0x04u, 0x64u, 0xE0u, 0x0Eu, 0x34u, 0x8Du, 0xEFu, 0x81u, 0x1Cu, 0xC1u, 0x69u, 0xF8u, 0xC8u, 0x08u, 0x4Cu, 0x71u,
+    0x05u, 0x8Au, 0x65u, 0x2Fu, 0xE1u, 0x24u, 0x0Fu, 0x21u, 0x35u, 0x93u, 0x8Eu, 0xDAu, 0xF0u, 0x12u, 0x82u, 0x45u,
+    0x1Du, 0xB5u, 0xC2u, 0x7Du, 0x6Au, 0x27u, 0xF9u, 0xB9u, 0xC9u, 0x9Au, 0x09u, 0x78u, 0x4Du, 0xE4u, 0x72u, 0xA6u,
+    0x06u, 0xBFu, 0x8Bu, 0x62u, 0x66u, 0xDDu, 0x30u, 0xFDu, 0xE2u, 0x98u, 0x25u, 0xB3u, 0x10u, 0x91u, 0x22u, 0x88u,
+    0x36u, 0xD0u, 0x94u, 0xCEu, 0x8Fu, 0x96u, 0xDBu, 0xBDu, 0xF1u, 0xD2u, 0x13u, 0x5Cu, 0x83u, 0x38u, 0x46u, 0x40u,
+    0x1Eu, 0x42u, 0xB6u, 0xA3u, 0xC3u, 0x48u, 0x7Eu, 0x6Eu, 0x6Bu, 0x3Au, 0x28u, 0x54u, 0xFAu, 0x85u, 0xBAu, 0x3Du,
+    0xCAu, 0x5Eu, 0x9Bu, 0x9Fu, 0x0Au, 0x15u, 0x79u, 0x2Bu, 0x4Eu, 0xD4u, 0xE5u, 0xACu, 0x73u, 0xF3u, 0xA7u, 0x57u,
+    0x07u, 0x70u, 0xC0u, 0xF7u, 0x8Cu, 0x80u, 0x63u, 0x0Du, 0x67u, 0x4Au, 0xDEu, 0xEDu, 0x31u, 0xC5u, 0xFEu, 0x18u,
+    0xE3u, 0xA5u, 0x99u, 0x77u, 0x26u, 0xB8u, 0xB4u, 0x7Cu, 0x11u, 0x44u, 0x92u, 0xD9u, 0x23u, 0x20u, 0x89u, 0x2Eu,
+    0x37u, 0x3Fu, 0xD1u, 0x5Bu, 0x95u, 0xBCu, 0xCFu, 0xCDu, 0x90u, 0x87u, 0x97u, 0xB2u, 0xDCu, 0xFCu, 0xBEu, 0x61u,
+    0xF2u, 0x56u, 0xD3u, 0xABu, 0x14u, 0x2Au, 0x5Du, 0x9Eu, 0x84u, 0x3Cu, 0x39u, 0x53u, 0x47u, 0x6Du, 0x41u, 0xA2u,
+    0x1Fu, 0x2Du, 0x43u, 0xD8u, 0xB7u, 0x7Bu, 0xA4u, 0x76u, 0xC4u, 0x17u, 0x49u, 0xECu, 0x7Fu, 0x0Cu, 0x6Fu, 0xF6u,
+    0x6Cu, 0xA1u, 0x3Bu, 0x52u, 0x29u, 0x9Du, 0x55u, 0xAAu, 0xFBu, 0x60u, 0x86u, 0xB1u, 0xBBu, 0xCCu, 0x3Eu, 0x5Au,
+    0xCBu, 0x59u, 0x5Fu, 0xB0u, 0x9Cu, 0xA9u, 0xA0u, 0x51u, 0x0Bu, 0xF5u, 0x16u, 0xEBu, 0x7Au, 0x75u, 0x2Cu, 0xD7u,
+    0x4Fu, 0xAEu, 0xD5u, 0xE9u, 0xE6u, 0xE7u, 0xADu, 0xE8u, 0x74u, 0xD6u, 0xF4u, 0xEAu, 0xA8u, 0x50u, 0x58u, 0xAFu,
+};
+
+// Adds two logs modulo 255 by folding the carry back in: (a + b) - 256 + 1
+// A result of 255 is left as-is since gf256_exp[255] == gf256_exp[0]
+#define GF256_LOG_ADD(a, b, result) do { result = (a) + (b); if (result < (a)) result++; } while(0)
+
+
+// Polynomial division of the data by the divisor.
+// rsdiv[] is in log form (see reedSolomonLoadDivisor()), so each term is one
+// add-mod-255 and one table lookup instead of a full multiply
+//
+// Generator coefficients are never zero, so only the leading factor needs a zero check
+static void reedSolomonComputeRemainder(const uint8_t data_[], uint8_t dataLen_) {
+
+    const uint8_t degree_m1 = RSDegree - 1u;
+    memset(rsremainder,0,RSDegree);
+
+    for (uint8_t i = 0; i < dataLen_; i++) {  // Polynomial division
+        uint8_t factor = (*data_++) ^ rsremainder[0];
+
+        // Shift the remainder down by one term
+        memmove(rsremainder, rsremainder + 1, degree_m1);
+        rsremainder[degree_m1] = 0u;
+
+        if (factor) {
+            const uint8_t factor_log = gf256_log[factor];
+            const uint8_t * p_div_log = rsdiv;
+            uint8_t * p_rem = rsremainder;
+
+            for (uint8_t j = RSDegree; j != 0u; j--) {
+                uint8_t log_sum;
+                GF256_LOG_ADD(factor_log, *p_div_log++, log_sum);
+                *p_rem++ ^= gf256_exp[log_sum];
+            }
+        }
+    }
+}
+
+
+#elif (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)
+
 // Returns the product of the two given field elements modulo GF(2^8/0x11D).
 // All inputs are valid. This could be implemented as a 256*256 lookup table.
 //
@@ -292,33 +416,7 @@ static uint8_t reedSolomonMultiply(uint8_t x_) {
 }
 */
 
-static uint8_t reedSolomonMultiply02(uint8_t x_) {
-	// Russian peasant multiplication
-	uint8_t x=x_, y=0x02, z=0;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x80) z ^= x;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x40) z ^= x;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x20) z ^= x;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x10) z ^= x;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x08) z ^= x;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x04) z ^= x;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x02) z ^= x;
-    if (z & 0x80) { z = ((z << 1) ^ 0x1D); } else { z = (z << 1); }
-    if (y & 0x01) z ^= x;
-	return z;
-}
-
-#define RSDegree ECC_CODEWORDS_PER_BLOCK_D(QRECL,QRVERSION)
-
 /////// SLOWISH
-static uint8_t rsdiv[qrcodegen_REED_SOLOMON_DEGREE_MAX];
-static uint8_t rsremainder[qrcodegen_REED_SOLOMON_DEGREE_MAX];
 static const uint8_t *rsdata;
 static SFR dataLen;
 static void reedSolomonComputeRemainder(const uint8_t data_[], uint8_t dataLen_) {
@@ -338,22 +436,24 @@ static void reedSolomonComputeRemainder(const uint8_t data_[], uint8_t dataLen_)
 	}
 }
 
-/////// FAST
-static void reedSolomonComputeDivisor(void) {
+#else
+    #error "Unknown QR_RS_ENGINE"
+#endif // QR_RS_ENGINE
 
-    memset(rsdiv,0,RSDegree);
 
-	rsdiv[RSDegree - 1] = 1;  // Start off with the monomial x^0
-	
-	rs_y = 1;
-	for (uint8_t i = 0; i < RSDegree; i++) {
-		for (uint8_t j = 0; j < RSDegree; j++) {
-			rsdiv[j] = reedSolomonMultiply(rsdiv[j]);
-			if (j + 1 < RSDegree)
-				rsdiv[j] ^= rsdiv[j + 1];
-		}
-		rs_y = reedSolomonMultiply02(rs_y);
-	}
+// Divisor (generator) polynomials for every degree are precomputed in ROM, in the form the
+// selected QR_RS_ENGINE uses. See qrcode_rs_generators.c (generated by util/reedsolomon_mul_lut.c)
+BANKREF_EXTERN(qrcode_rs_generators)
+extern const uint8_t rs_generators[];
+
+#define RS_GENERATOR_OFFSET(degree) (((uint16_t)(degree) * ((degree) - 1u)) / 2u)
+
+static void reedSolomonLoadDivisor(void) NONBANKED {
+
+    uint8_t save_bank = CURRENT_BANK;
+    PLAT_SWITCH_ROM(BANK(qrcode_rs_generators));
+    memcpy(rsdiv, rs_generators + RS_GENERATOR_OFFSET(RSDegree), RSDegree);
+    PLAT_SWITCH_ROM(save_bank);
 }
 
 
@@ -364,30 +464,43 @@ static void reedSolomonComputeDivisor(void) {
 // bytes from the blocks and stores them in the result array. data[0 : dataLen] contains
 // the input data. data[dataLen : rawCodewords] is used as a temporary work area and will
 // be clobbered by this function. The final answer is stored in result[0 : rawCodewords].
-static void addEccAndInterleave(uint8_t data[], uint8_t result[]) {
+//
+// Done one block at a time (addEccBlock()) so qrcodegen_stream_end_step() can spread it out
+static const uint8_t * ecc_block_data;
 
-    
-	int numBlocks = NUM_ERROR_CORRECTION_BLOCKS_D(QRECL,QRVERSION);
-	int blockEccLen = ECC_CODEWORDS_PER_BLOCK_D(QRECL,QRVERSION);
-	int rawCodewords = getNumRawDataModules();
-	int dataLen = getNumDataCodewords();
+static void addEccBegin(const uint8_t data[]) {
+	reedSolomonLoadDivisor();
+	ecc_block_data = data;
+}
+
+// Blocks must be added in order, starting at 0. Returns true after the last one
+static bool addEccBlock(uint8_t i, uint8_t result[]) {
+
+	int numBlocks = NUM_ERROR_CORRECTION_BLOCKS[QRECL][qr_version];
+	int blockEccLen = ECC_CODEWORDS_PER_BLOCK[QRECL][qr_version];
+	int rawCodewords = getNumRawDataModules(qr_version);
+	int dataLen = getNumDataCodewords(qr_version);
 	int numShortBlocks = numBlocks - rawCodewords % numBlocks;
 	int shortBlockDataLen = rawCodewords / numBlocks - blockEccLen;
-	
-	reedSolomonComputeDivisor();
-	const uint8_t *dat = data;
-	for (int i = 0; i < numBlocks; i++) {
-		int datLen = shortBlockDataLen + (i < numShortBlocks ? 0 : 1);
-        reedSolomonComputeRemainder(dat, datLen);
-        for (int j = 0, k = i; j < datLen; j++, k += numBlocks) {  // Copy data
-			if (j == shortBlockDataLen)
-				k -= numShortBlocks;
-			result[k] = dat[j];
-		}
-		for (int j = 0, k = dataLen + i; j < blockEccLen; j++, k += numBlocks)  // Copy ECC
-			result[k] = rsremainder[j];
-		dat += datLen;
+
+	const uint8_t *dat = ecc_block_data;
+	int datLen = shortBlockDataLen + (i < numShortBlocks ? 0 : 1);
+	reedSolomonComputeRemainder(dat, datLen);
+	for (int j = 0, k = i; j < datLen; j++, k += numBlocks) {  // Copy data
+		if (j == shortBlockDataLen)
+			k -= numShortBlocks;
+		result[k] = dat[j];
 	}
+	for (int j = 0, k = dataLen + i; j < blockEccLen; j++, k += numBlocks)  // Copy ECC
+		result[k] = rsremainder[j];
+	ecc_block_data += datLen;
+
+	if (i + 1 < numBlocks) return false;
+
+	// Remainder bits (0 - 7 depending on version) after the last codeword are read
+	// from this byte when placing codewords, they should be zero (white before masking)
+	result[rawCodewords] = 0;
+	return true;
 }
 
 
@@ -398,16 +511,12 @@ static void addEccAndInterleave(uint8_t data[], uint8_t result[]) {
 // Calculates and stores an ascending list of positions of alignment patterns
 // for this version number, returning the length of the list (in the range [0,7]).
 // Each position is in the range [0,177), and are used on both the x and y axes.
-// This could be implemented as lookup table of 40 variable-length lists of unsigned bytes.
+// Implemented as a lookup table (ALIGNMENT_PATTERN_POSITIONS) of 40 lists of unsigned bytes.
 static int getAlignmentPatternPositions(uint8_t result[7]) {
-	if (QRVERSION == 1)
+	if (qr_version == 1)
 		return 0;
-	int step = (QRVERSION == 32) ? 26 :
-		(QRVERSION*4 + (QRVERSION / 7 + 2)*2 + 1) / ((QRVERSION / 7 + 2)*2 - 2) * 2;
-	for (int i = (QRVERSION / 7 + 2) - 1, pos = QRVERSION * 4 + 10; i >= 1; i--, pos -= step)
-		result[i] = (uint8_t)pos;
-	result[0] = 6;
-	return (QRVERSION / 7 + 2);
+	memcpy(result, ALIGNMENT_PATTERN_POSITIONS[qr_version], ALIGNMENT_PATTERN_POSITIONS_MAX);
+	return (qr_version / 7 + 2);
 }
 
 
@@ -427,13 +536,13 @@ static void initializeFunctionModules(int version, uint8_t qrcode[]) {
 	memset(qrcode, 0, (size_t)qrcodegen_BUFFER_SZ * sizeof(qrcode[0]));
 	
 	// Fill horizontal and vertical timing patterns
-	fillRectangle(6, 0, 1, QRSIZE, qrcode);
-	fillRectangle(0, 6, QRSIZE, 1, qrcode);
+	fillRectangle(6, 0, 1, qr_size, qrcode);
+	fillRectangle(0, 6, qr_size, 1, qrcode);
 	
 	// Fill 3 finder patterns (all corners except bottom right) and format bits
 	fillRectangle(0, 0, 9, 9, qrcode);
-	fillRectangle(QRSIZE - 8, 0, 8, 9, qrcode);
-	fillRectangle(0, QRSIZE - 8, 9, 8, qrcode);
+	fillRectangle(qr_size - 8, 0, 8, 9, qrcode);
+	fillRectangle(0, qr_size - 8, 9, 8, qrcode);
 	
 	// Fill numerous alignment patterns
 	uint8_t alignPatPos[7];
@@ -448,8 +557,8 @@ static void initializeFunctionModules(int version, uint8_t qrcode[]) {
 	
 	// Fill version blocks
 	if (version >= 7) {
-		fillRectangle(QRSIZE - 11, 0, 3, 6, qrcode);
-		fillRectangle(0, QRSIZE - 11, 6, 3, qrcode);
+		fillRectangle(qr_size - 11, 0, 3, 6, qrcode);
+		fillRectangle(0, qr_size - 11, 6, 3, qrcode);
 	}
 }
 
@@ -460,7 +569,7 @@ static void initializeFunctionModules(int version, uint8_t qrcode[]) {
 static void drawWhiteFunctionModules(void) {
 	// Draw horizontal and vertical timing patterns
 	int i;
-    for (i = 7; i < QRSIZE - 7; i += 2) {
+    for (i = 7; i < qr_size - 7; i += 2) {
 		setModuleStatic(QRCODE, 6, i, false);
 		setModuleStatic(QRCODE, i, 6, false);
 	}
@@ -473,8 +582,8 @@ static void drawWhiteFunctionModules(void) {
 				dist = abs(dy);
 			if (dist == 2 || dist == 4) {
 				setModuleBounded(QRCODE, 3 + dx, 3 + dy, false);
-				setModuleBounded(QRCODE, QRSIZE - 4 + dx, 3 + dy, false);
-				setModuleBounded(QRCODE, 3 + dx, QRSIZE - 4 + dy, false);
+				setModuleBounded(QRCODE, qr_size - 4 + dx, 3 + dy, false);
+				setModuleBounded(QRCODE, 3 + dx, qr_size - 4 + dy, false);
 			}
 		}
 	}
@@ -494,18 +603,18 @@ static void drawWhiteFunctionModules(void) {
 	}
 	
 	// Draw version blocks
-	if (QRVERSION >= 7) {
+	if (qr_version >= 7) {
 		// Calculate error correction code and pack bits
-		int rem = QRVERSION;  // version is uint6, in the range [7, 40]
+		int rem = qr_version;  // version is uint6, in the range [7, 40]
 		for (i = 0; i < 12; i++)
 			rem = (rem << 1) ^ ((rem >> 11) * 0x1F25);
-		long bits = (long)QRVERSION << 12 | rem;  // uint18
+		long bits = (long)qr_version << 12 | rem;  // uint18
 		assert(bits >> 18 == 0);
 		
 		// Draw two copies
 		for (i = 0; i < 6; i++) {
 			for (int j = 0; j < 3; j++) {
-				int k = QRSIZE - 11 + j;
+				int k = qr_size - 11 + j;
 				setModuleStatic(QRCODE, k, i, (bits & 1) != 0);
 				setModuleStatic(QRCODE, i, k, (bits & 1) != 0);
 				bits >>= 1;
@@ -545,19 +654,19 @@ static void drawFormatBitsCopy1(uint16_t bits) {
     uint8_t b = bits&0xFF;
     uint8_t i;
 	for (i = 0; i < 8; i++) {
-		setModuleStatic(QRCODE, QRSIZE - 1 - i, 8, b&1); b>>=1;
+		setModuleStatic(QRCODE, qr_size - 1 - i, 8, b&1); b>>=1;
     }
     b = bits>>8;
 	for (i = 8; i < 15; i++) {
-		setModuleStatic(QRCODE, 8, QRSIZE - 15 + i, b&1); b>>=1;
+		setModuleStatic(QRCODE, 8, qr_size - 15 + i, b&1); b>>=1;
     }
-	setModuleStatic(QRCODE, 8, QRSIZE - 8, true);  // Always black
+	setModuleStatic(QRCODE, 8, qr_size - 8, true);  // Always black
 
 }
-static void drawFormatBits(void) {
+static void drawFormatBits(uint8_t mask) {
     
 	static const int table[] = {1, 0, 3, 2};
-	int data = table[QRECL] << 3 | (int)MASK;  // errCorrLvl is uint2, mask is uint3
+	int data = table[QRECL] << 3 | (int)mask;  // errCorrLvl is uint2, mask is uint3
 	int rem = data;
 	for (uint8_t i = 0; i < 10; i++)
 		rem = (rem << 1) ^ ((rem >> 9) * 0x537);
@@ -569,207 +678,889 @@ static void drawFormatBits(void) {
 
 
 
-// Standard versions:
-//   _drawCodewords          11398278    1
-//   _drawCodewordsLR        5897382    34
-//   _drawCodewordsRL        5334832    35
-//           Self Time       163538      1   
-//
-// Faster versions:
-//   _drawCodewords          5054768     1
-//   _drawCodewordsLR_faster 2562032    34
-//   _drawCodewordsRL_faster 2417040    35
-//   Self Time               74610       1   
-
 /*---- Drawing data modules and masking ----*/
-static uint16_t dc_i;
 
-const uint8_t tmpbuffer_bitmasks[] = {0x80u, 0x40u, 0x20u, 0x10u, 0x08u, 0x04u, 0x02u, 0x01u };
-
-// New versions, about 2x faster
+// Table driven codeword placement
 //
-// Scans the output qrcode on one Y line from checking if it has bit/modules/pixel == 0 (for X and X-1),
-// if it checks the current bit in TMPBUFFER (and advances it) for whether to set the current bit/module/pixel
+// The data bits zig-zag through column pairs (x, x-1) from the right edge, alternating between
+// upward and downward, skipping every function module. Which modules get skipped only depends
+// on the version, so the path is reduced once per version into a run-length map of the free
+// modules. Placement then just streams bits from TMPBUFFER into the runs without testing any
+// function module bits.
 //
-// Dir: Top to Bottom
-static void drawCodewordsLR_faster(uint8_t x) {
-
-    uint8_t y = 0;
-
-    // Set up the pointers
-    const uint8_t * p_TMPBUFFER    = TMPBUFFER + (dc_i >> 3);
-          uint8_t   tmpbuffer_mask = tmpbuffer_bitmasks[dc_i & 0x07];
-
-          uint8_t * p_QRCODE        = QRCODE + (y * QR_OUTPUT_ROW_SZ_BYTES) + (x       >> 3);
-          uint8_t * p_QRCODE_xmin_1 = QRCODE + (y * QR_OUTPUT_ROW_SZ_BYTES) + ((x - 1) >> 3);
-          const uint8_t   qrcode_pxmodule_mask        = qr_bitmask[x];;
-          const uint8_t   qrcode_pxmodule_mask_xmin_1 = qr_bitmask[x - 1];;
-
-    // Step through all Y lines in output at current X position 
-    while (y < QRSIZE) {
-        // Check bit corresponding to X,Y module/pixel position in output
-        if (!(*p_QRCODE & qrcode_pxmodule_mask)) {
-
-            // Set or clear X,Y output if bit set or not at current TMPBUFFER index
-            if (*p_TMPBUFFER & tmpbuffer_mask)  *p_QRCODE |=  qrcode_pxmodule_mask; // Set bit
-            else                                *p_QRCODE &= ~qrcode_pxmodule_mask; // Clear bit
-
-            // Increment what seems to be a bit index into TMPBUFFER
-            dc_i++;
-            // Increment TMPBUFFER pointer when crossing bit boundary to next byte
-            if ((dc_i & 0x7u) == 0) p_TMPBUFFER++;
-            // Rotate the mask to keep it bit aligned
-            tmpbuffer_mask >>= 1;
-            if (tmpbuffer_mask == 0) tmpbuffer_mask = 0x80u;
+// - One byte per run: upper 2 bits are which modules of the pair are free on those rows, lower 6 bits the row count
+// - Runs never cross into the next column pair, so each pair's runs add up to qr_size rows
+// - The map is rebuilt only when the version changes (it's cached in WRAM between exports)
+#define QR_PLACE_RUN_BOTH      0x00u  // x and x-1 free, 2 bits per row
+#define QR_PLACE_RUN_LEFT      0x40u  // Only x-1 free (x is a function module)
+#define QR_PLACE_RUN_RIGHT     0x80u  // Only x free (x-1 is a function module)
+#define QR_PLACE_RUN_SKIP      0xC0u  // Both are function modules
+#define QR_PLACE_RUN_TYPE_MASK 0xC0u
+#define QR_PLACE_RUN_LEN_MASK  0x3Fu
+#define QR_PLACE_RUN_LEN_MAX   QR_PLACE_RUN_LEN_MASK
+
+#define QR_PLACE_BURST_ROWS    4u     // Rows of a BOTH run placed from one whole byte of data
+
+// Worst case for all versions stays under 4 runs per row of the symbol (version 31 needs 483, version 40 needs 641)
+#define QR_PLACE_MAP_SZ_MAX    (QRSIZE_MAX * 4u)
+
+static uint8_t placement_map[QR_PLACE_MAP_SZ_MAX];
+static uint8_t placement_map_version = 0u;  // 0 = no map built yet (versions start at 1)
+
+
+// Rebuilds the placement map for qr_version.
+// Requires QRCODE to have only the function modules set (namely by initializeFunctionModules()).
+static void buildPlacementMap(void) {
+
+    uint8_t * p_map    = placement_map;
+    uint8_t   x        = qr_size - 1u;
+    bool      upward   = true;
+
+    while (true) {
+        uint8_t y        = (upward) ? (qr_size - 1u) : 0u;
+        uint8_t run_type = 0xFFu;  // Forces a new run at the start of each column pair
+        uint8_t run_len  = 0u;
+
+        for (uint8_t rows = qr_size; rows != 0u; rows--) {
+            uint8_t type = QR_PLACE_RUN_BOTH;
+            if (getModule(QRCODE, x,      y)) type |= QR_PLACE_RUN_LEFT;
+            if (getModule(QRCODE, x - 1u, y)) type |= QR_PLACE_RUN_RIGHT;
+
+            if ((type == run_type) && (run_len < QR_PLACE_RUN_LEN_MAX)) {
+                run_len++;
+                *(p_map - 1) = type | run_len;
+            } else {
+                run_type = type;
+                run_len  = 1u;
+                *p_map++ = type | run_len;
+            }
+            if (upward) y--; else y++;
         }
-        if (!(*p_QRCODE_xmin_1 & qrcode_pxmodule_mask_xmin_1)) {
 
-            if (*p_TMPBUFFER & tmpbuffer_mask)  *p_QRCODE_xmin_1 |=  qrcode_pxmodule_mask_xmin_1; // Set bit
-            else                                *p_QRCODE_xmin_1 &= ~qrcode_pxmodule_mask_xmin_1; // Clear bit
+        if (x == 1u) break;
+        x -= 2u;
+        if (x == 6u) x = 5u;  // Skip the vertical timing pattern column
+        upward = !upward;
+    }
+
+    placement_map_version = qr_version;
+}
+
+
+// Bit reader for TMPBUFFER, MSB first. The window is kept topped up with 9 - 16 valid
+// bits so that up to 8 bits (one burst) can always be read straight from the upper byte.
+static const uint8_t * p_place_src;
+static uint16_t        place_window;
+static uint8_t         place_window_bits;
 
-            // Increment what seems to be a bit index into TMPBUFFER
-            dc_i++;
-            if ((dc_i & 0x7u) == 0) p_TMPBUFFER++;
-            tmpbuffer_mask >>= 1;
-            if (tmpbuffer_mask == 0) tmpbuffer_mask = 0x80u;
+#define PLACE_REFILL() \
+    if (place_window_bits <= 8u) { \
+        place_window |= (uint16_t)(*p_place_src++) << (8u - place_window_bits); \
+        place_window_bits += 8u; \
+    }
+
+#define PLACE_CONSUME(count) \
+    place_window <<= (count); \
+    place_window_bits -= (count); \
+    PLACE_REFILL()
+
+
+// Places the interleaved codewords (TMPBUFFER) into the data modules of QRCODE.
+// Requires the placement map for qr_version and the data modules of QRCODE to be 0 (they only get bits ORed in).
+static void drawCodewords(void) {
+
+    const uint8_t * p_map  = placement_map;
+          uint8_t   x      = qr_size - 1u;
+          bool      upward = true;
+
+    p_place_src       = TMPBUFFER;
+    place_window      = 0u;
+    place_window_bits = 0u;
+    PLACE_REFILL();
+    PLACE_REFILL();
+
+    while (true) {
+        const int16_t   step       = (upward) ? -(int16_t)QR_OUTPUT_ROW_SZ_BYTES : (int16_t)QR_OUTPUT_ROW_SZ_BYTES;
+        const uint16_t  row_offset = (upward) ? ((qr_size - 1u) * QR_OUTPUT_ROW_SZ_BYTES) : 0u;
+              uint8_t * p_right    = QRCODE + row_offset + (x >> 3);
+              uint8_t * p_left     = QRCODE + row_offset + ((x - 1u) >> 3);
+        const uint8_t   mask_right = qr_bitmask[x];
+        const uint8_t   mask_left  = qr_bitmask[x - 1u];
+
+        // Both modules of a row OR'd in at once, indexed by the next 2 data bits (right module first)
+        // Only valid when x and x-1 are in the same byte (x is not a multiple of 8)
+        const uint8_t pair_lut[4] = { 0u, mask_left, mask_right, (uint8_t)(mask_right | mask_left) };
+        const bool    pair_split  = (p_right != p_left);
+
+        uint8_t rows = qr_size;
+        while (rows) {
+            const uint8_t run = *p_map++;
+                  uint8_t len = run & QR_PLACE_RUN_LEN_MASK;
+            rows -= len;
+
+            switch (run & QR_PLACE_RUN_TYPE_MASK) {
+
+                case QR_PLACE_RUN_BOTH:
+                    if (pair_split) {
+                        do {
+                            if (place_window & 0x8000u) *p_right |= mask_right;
+                            if (place_window & 0x4000u) *p_left  |= mask_left;
+                            PLACE_CONSUME(2u);
+                            p_right += step;
+                            p_left  += step;
+                        } while (--len);
+                    } else {
+                        // Whole bytes of data fill 4 rows at a time
+                        while (len >= QR_PLACE_BURST_ROWS) {
+                            const uint8_t data = (uint8_t)(place_window >> 8);
+                            *p_right |= pair_lut[data >> 6];         p_right += step;
+                            *p_right |= pair_lut[(data >> 4) & 0x03u]; p_right += step;
+                            *p_right |= pair_lut[(data >> 2) & 0x03u]; p_right += step;
+                            *p_right |= pair_lut[data & 0x03u];        p_right += step;
+                            PLACE_CONSUME(8u);
+                            len -= QR_PLACE_BURST_ROWS;
+                        }
+                        while (len) {
+                            *p_right |= pair_lut[place_window >> 14];
+                            PLACE_CONSUME(2u);
+                            p_right += step;
+                            len--;
+                        }
+                        p_left = p_right;
+                    }
+                    break;
+
+                case QR_PLACE_RUN_RIGHT:
+                    do {
+                        if (place_window & 0x8000u) *p_right |= mask_right;
+                        PLACE_CONSUME(1u);
+                        p_right += step;
+                        p_left  += step;
+                    } while (--len);
+                    break;
+
+                case QR_PLACE_RUN_LEFT:
+                    do {
+                        if (place_window & 0x8000u) *p_left |= mask_left;
+                        PLACE_CONSUME(1u);
+                        p_right += step;
+                        p_left  += step;
+                    } while (--len);
+                    break;
+
+                default: // QR_PLACE_RUN_SKIP
+                    p_right += step * len;
+                    p_left  += step * len;
+                    break;
+            }
         }
-        y++;
-        p_QRCODE += QR_OUTPUT_ROW_SZ_BYTES;  // Move down 1 line in output qrcode buffer
-        p_QRCODE_xmin_1 += QR_OUTPUT_ROW_SZ_BYTES;
+
+        if (x == 1u) break;
+        x -= 2u;
+        if (x == 6u) x = 5u;  // Skip the vertical timing pattern column
+        upward = !upward;
     }
 }
 
-// Same as above, but stepping Y from BOTTOM up to TOP
-static void drawCodewordsRL_faster(uint8_t x) {
+// Mask patterns (1 = invert module), packed the same way as QRCODE rows (bit 0 = leftmost module).
+// All 8 patterns repeat every 24 modules horizontally (3 bytes) and every 12 rows vertically,
+// so each mask can be applied a whole byte at a time.
+#define MASK_PATTERN_ROWS   12u
+#define MASK_PATTERN_BYTES  3u
+static const uint8_t MASK_PATTERNS[8][MASK_PATTERN_ROWS][MASK_PATTERN_BYTES] = {
+    {  // Mask 0: (x + y) % 2 == 0
+        {0x55u, 0x55u, 0x55u}, {0xAAu, 0xAAu, 0xAAu}, {0x55u, 0x55u, 0x55u}, {0xAAu, 0xAAu, 0xAAu}, {0x55u, 0x55u, 0x55u}, {0xAAu, 0xAAu, 0xAAu},
+        {0x55u, 0x55u, 0x55u}, {0xAAu, 0xAAu, 0xAAu}, {0x55u, 0x55u, 0x55u}, {0xAAu, 0xAAu, 0xAAu}, {0x55u, 0x55u, 0x55u}, {0xAAu, 0xAAu, 0xAAu} },
+    {  // Mask 1: y % 2 == 0
+        {0xFFu, 0xFFu, 0xFFu}, {0x00u, 0x00u, 0x00u}, {0xFFu, 0xFFu, 0xFFu}, {0x00u, 0x00u, 0x00u}, {0xFFu, 0xFFu, 0xFFu}, {0x00u, 0x00u, 0x00u},
+        {0xFFu, 0xFFu, 0xFFu}, {0x00u, 0x00u, 0x00u}, {0xFFu, 0xFFu, 0xFFu}, {0x00u, 0x00u, 0x00u}, {0xFFu, 0xFFu, 0xFFu}, {0x00u, 0x00u, 0x00u} },
+    {  // Mask 2: x % 3 == 0
+        {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u},
+        {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u}, {0x49u, 0x92u, 0x24u} },
+    {  // Mask 3: (x + y) % 3 == 0
+        {0x49u, 0x92u, 0x24u}, {0x24u, 0x49u, 0x92u}, {0x92u, 0x24u, 0x49u}, {0x49u, 0x92u, 0x24u}, {0x24u, 0x49u, 0x92u}, {0x92u, 0x24u, 0x49u},
+        {0x49u, 0x92u, 0x24u}, {0x24u, 0x49u, 0x92u}, {0x92u, 0x24u, 0x49u}, {0x49u, 0x92u, 0x24u}, {0x24u, 0x49u, 0x92u}, {0x92u, 0x24u, 0x49u} },
+    {  // Mask 4: (x / 3 + y / 2) % 2 == 0
+        {0xC7u, 0x71u, 0x1Cu}, {0xC7u, 0x71u, 0x1Cu}, {0x38u, 0x8Eu, 0xE3u}, {0x38u, 0x8Eu, 0xE3u}, {0xC7u, 0x71u, 0x1Cu}, {0xC7u, 0x71u, 0x1Cu},
+        {0x38u, 0x8Eu, 0xE3u}, {0x38u, 0x8Eu, 0xE3u}, {0xC7u, 0x71u, 0x1Cu}, {0xC7u, 0x71u, 0x1Cu}, {0x38u, 0x8Eu, 0xE3u}, {0x38u, 0x8Eu, 0xE3u} },
+    {  // Mask 5: x * y % 2 + x * y % 3 == 0
+        {0xFFu, 0xFFu, 0xFFu}, {0x41u, 0x10u, 0x04u}, {0x49u, 0x92u, 0x24u}, {0x55u, 0x55u, 0x55u}, {0x49u, 0x92u, 0x24u}, {0x41u, 0x10u, 0x04u},
+        {0xFFu, 0xFFu, 0xFFu}, {0x41u, 0x10u, 0x04u}, {0x49u, 0x92u, 0x24u}, {0x55u, 0x55u, 0x55u}, {0x49u, 0x92u, 0x24u}, {0x41u, 0x10u, 0x04u} },
+    {  // Mask 6: (x * y % 2 + x * y % 3) % 2 == 0
+        {0xFFu, 0xFFu, 0xFFu}, {0xC7u, 0x71u, 0x1Cu}, {0xDBu, 0xB6u, 0x6Du}, {0x55u, 0x55u, 0x55u}, {0x6Du, 0xDBu, 0xB6u}, {0x71u, 0x1Cu, 0xC7u},
+        {0xFFu, 0xFFu, 0xFFu}, {0xC7u, 0x71u, 0x1Cu}, {0xDBu, 0xB6u, 0x6Du}, {0x55u, 0x55u, 0x55u}, {0x6Du, 0xDBu, 0xB6u}, {0x71u, 0x1Cu, 0xC7u} },
+    {  // Mask 7: ((x + y) % 2 + x * y % 3) % 2 == 0
+        {0x55u, 0x55u, 0x55u}, {0x38u, 0x8Eu, 0xE3u}, {0x71u, 0x1Cu, 0xC7u}, {0xAAu, 0xAAu, 0xAAu}, {0xC7u, 0x71u, 0x1Cu}, {0x8Eu, 0xE3u, 0x38u},
+        {0x55u, 0x55u, 0x55u}, {0x38u, 0x8Eu, 0xE3u}, {0x71u, 0x1Cu, 0xC7u}, {0xAAu, 0xAAu, 0xAAu}, {0xC7u, 0x71u, 0x1Cu}, {0x8Eu, 0xE3u, 0x38u} },
+};
 
-    uint8_t y = QRSIZE - 1;
+// Number of bytes actually used in a QRCODE row, and which bits of the last one are inside the symbol
+#define QR_ROW_BYTES          ((qr_size + 7u) >> 3)
+#define QR_ROW_LAST_BYTE_MASK ((uint8_t)((1u << (qr_size & 0x07u)) - 1u))  // qr_size is always odd, so never a multiple of 8
 
-    // Set up the pointers
-    const uint8_t * p_TMPBUFFER    = TMPBUFFER + (dc_i >> 3);
-          uint8_t   tmpbuffer_mask = tmpbuffer_bitmasks[dc_i & 0x07];
 
-          uint8_t * p_QRCODE        = QRCODE + (y * QR_OUTPUT_ROW_SZ_BYTES) + (x       >> 3);
-          uint8_t * p_QRCODE_xmin_1 = QRCODE + (y * QR_OUTPUT_ROW_SZ_BYTES) + ((x - 1) >> 3);
-          const uint8_t   qrcode_pxmodule_mask        = qr_bitmask[x];;
-          const uint8_t   qrcode_pxmodule_mask_xmin_1 = qr_bitmask[x - 1];;
+// XORs the mask pattern into all non-function modules of QRCODE (TMPBUFFER has the function modules set).
+// Applying the same mask twice undoes it. Bits past the right edge of the symbol are left untouched.
+static void applyMask(uint8_t mask) {
 
-    // Step through all Y lines in output at current X position 
-    do {
-        // Check bit corresponding to X,Y module/pixel position in output
-        if (!(*p_QRCODE & qrcode_pxmodule_mask)) {
+    const uint8_t   row_bytes_m1     = QR_ROW_BYTES - 1u;
+    const uint8_t   last_byte_mask   = QR_ROW_LAST_BYTE_MASK;
+    const uint8_t   row_skip         = QR_OUTPUT_ROW_SZ_BYTES - row_bytes_m1;
+          uint8_t * p_qrcode         = QRCODE;
+    const uint8_t * p_func           = TMPBUFFER;
+          uint8_t   pattern_row      = 0u;
 
-            // Set or clear X,Y output if bit set or not at current TMPBUFFER index
-            if (*p_TMPBUFFER & tmpbuffer_mask)  *p_QRCODE |=  qrcode_pxmodule_mask; // Set bit
-            else                                *p_QRCODE &= ~qrcode_pxmodule_mask; // Clear bit
+    for (uint8_t y = 0; y < qr_size; y++) {
 
-            // Increment what seems to be a bit index into TMPBUFFER
-            dc_i++;
-            // Increment TMPBUFFER pointer when crossing bit boundary to next byte
-            if ((dc_i & 0x7u) == 0) p_TMPBUFFER++;
-            // Rotate the mask to keep it bit aligned
-            tmpbuffer_mask >>= 1;
-            if (tmpbuffer_mask == 0) tmpbuffer_mask = 0x80u;
+        const uint8_t * p_pattern = MASK_PATTERNS[mask][pattern_row];
+        uint8_t pattern_col = 0u;
+
+        for (uint8_t col = row_bytes_m1; col != 0u; col--) {
+            *p_qrcode++ ^= p_pattern[pattern_col] & ~(*p_func++);
+            if (++pattern_col == MASK_PATTERN_BYTES) pattern_col = 0u;
         }
-        if (!(*p_QRCODE_xmin_1 & qrcode_pxmodule_mask_xmin_1)) {
+        *p_qrcode ^= p_pattern[pattern_col] & ~(*p_func) & last_byte_mask;
+
+        p_qrcode += row_skip;
+        p_func   += row_skip;
+        if (++pattern_row == MASK_PATTERN_ROWS) pattern_row = 0u;
+    }
+}
+
+
+
+/*---- Function pattern template cache ----*/
+
+// The function patterns (finders, timing, alignment, version blocks) only depend on the version,
+// so they are drawn once per version and kept as a sparse template in a caller supplied buffer
+// (Cart SRAM on the Game Boy). Later QR Codes of the same version just get it copied in.
+//
+// - Only bytes of a QRCODE row which have function modules are stored, everything else is 0
+// - Per row: entry count, then per entry: byte column, function map (all function modules = 1), function colors
+// - The format bits are left 0 (white) in the colors since they depend on the mask (see drawFormatBits())
+// - Error correction level doesn't matter, it's only in the format bits
+// - Version 31 needs 1447 bytes. If the buffer is too small the patterns are just drawn every time
+#define QR_TEMPLATE_SIGNATURE   0x5154u  // "QT"
+
+#define QR_TEMPLATE_ENTRY_SZ    3u
+#define QR_TEMPLATE_OFS_COL     0u
+#define QR_TEMPLATE_OFS_MAP     1u
+#define QR_TEMPLATE_OFS_COLOR   2u
+
+typedef struct qr_template_header_t {
+    uint16_t signature;  // Cleared while building and by qrcodegen_invalidate_template_cache()
+    uint8_t  version;
+    uint8_t  reserved;
+} qr_template_header_t;
+
+static uint8_t * p_template_cache = NULL;
+static uint16_t  template_cache_sz;
+
+#define TEMPLATE_HEADER  ((qr_template_header_t *)p_template_cache)
+#define TEMPLATE_DATA    (p_template_cache + sizeof(qr_template_header_t))
+
+
+// The buffer must stay reserved for the template, but its contents may be kept across power cycles (SRAM)
+void qrcodegen_set_template_cache(uint8_t * p_cache, uint16_t cache_sz) BANKED {
+    p_template_cache  = p_cache;
+    template_cache_sz = cache_sz;
+}
+
+
+// Needed before anything else writes to the template cache buffer (it's shared with flood fill on the Game Boy)
+void qrcodegen_invalidate_template_cache(void) BANKED {
+    if (p_template_cache) TEMPLATE_HEADER->signature = 0u;
+}
 
-            if (*p_TMPBUFFER & tmpbuffer_mask)  *p_QRCODE_xmin_1 |=  qrcode_pxmodule_mask_xmin_1; // Set bit
-            else                                *p_QRCODE_xmin_1 &= ~qrcode_pxmodule_mask_xmin_1; // Clear bit
 
-            // Increment what seems to be a bit index into TMPBUFFER
-            dc_i++;
-            if ((dc_i & 0x7u) == 0) p_TMPBUFFER++;
-            tmpbuffer_mask >>= 1;
-            if (tmpbuffer_mask == 0) tmpbuffer_mask = 0x80u;
+static bool templateCacheValid(void) {
+    return (p_template_cache) &&
+           (TEMPLATE_HEADER->signature == QR_TEMPLATE_SIGNATURE) &&
+           (TEMPLATE_HEADER->version   == qr_version);
+}
+
+
+// Records every byte of QRCODE with function modules as a template entry.
+// Requires QRCODE to have only the function modules set (namely by initializeFunctionModules()).
+// Returns false if the template doesn't fit in the cache buffer.
+static bool templateCacheStoreMap(void) {
+
+    if ((p_template_cache == NULL) || (template_cache_sz < sizeof(qr_template_header_t))) return false;
+
+    TEMPLATE_HEADER->signature = 0u;
+
+          uint8_t * p_dst      = TEMPLATE_DATA;
+    const uint8_t * p_dst_end  = p_template_cache + template_cache_sz;
+    const uint8_t * p_row      = QRCODE;
+    const uint8_t   row_bytes  = QR_ROW_BYTES;
+
+    for (uint8_t y = qr_size; y != 0u; y--) {
+
+        if (p_dst >= p_dst_end) return false;
+        uint8_t * p_count = p_dst++;
+        *p_count = 0u;
+
+        for (uint8_t col = 0u; col < row_bytes; col++) {
+            if (p_row[col]) {
+                if ((p_dst_end - p_dst) < QR_TEMPLATE_ENTRY_SZ) return false;
+                p_dst[QR_TEMPLATE_OFS_COL] = col;
+                p_dst[QR_TEMPLATE_OFS_MAP] = p_row[col];
+                p_dst += QR_TEMPLATE_ENTRY_SZ;
+                (*p_count)++;
+            }
         }
-        // y--;  // Has to be below in order to complete loop with value as 0
-        p_QRCODE -= QR_OUTPUT_ROW_SZ_BYTES;  // Move down 1 line in output qrcode buffer
-        p_QRCODE_xmin_1 -= QR_OUTPUT_ROW_SZ_BYTES;
-    } while (y--);
-}
-
-// Standard Versions (about 2x slower)
-static void drawCodewordsLR(uint8_t x) {
-    uint8_t y=0;
-    while (y<QRSIZE) {
-        if (!getModule(QRCODE, x, y)) {
-            setModule(QRCODE, x, y, getBit(TMPBUFFER[dc_i >> 3], 7 - (dc_i & 7)));
-            dc_i++;
+        p_row += QR_OUTPUT_ROW_SZ_BYTES;
+    }
+    return true;
+}
+
+
+// Fills in the colors for the entries from templateCacheStoreMap() and marks the template as valid.
+// Requires QRCODE to have the function patterns drawn (namely by drawWhiteFunctionModules()).
+static void templateCacheStoreColors(void) {
+
+          uint8_t * p_dst = TEMPLATE_DATA;
+    const uint8_t * p_row = QRCODE;
+
+    for (uint8_t y = qr_size; y != 0u; y--) {
+        for (uint8_t count = *p_dst++; count != 0u; count--) {
+            p_dst[QR_TEMPLATE_OFS_COLOR] = p_row[p_dst[QR_TEMPLATE_OFS_COL]];
+            p_dst += QR_TEMPLATE_ENTRY_SZ;
         }
-        if (!getModule(QRCODE, x-1, y)) {
-            setModule(QRCODE, x-1, y, getBit(TMPBUFFER[dc_i >> 3], 7 - (dc_i & 7)));
-            dc_i++;
+        p_row += QR_OUTPUT_ROW_SZ_BYTES;
+    }
+
+    TEMPLATE_HEADER->version   = qr_version;
+    TEMPLATE_HEADER->signature = QR_TEMPLATE_SIGNATURE;
+}
+
+
+// Clears the buffer and copies in either the function map or the function colors (entry_ofs) from the template
+static void templateCacheCopy(uint8_t qrcode[], uint8_t entry_ofs) {
+
+    memset(qrcode, 0, (size_t)qrcodegen_BUFFER_SZ * sizeof(qrcode[0]));
+
+    const uint8_t * p_src = TEMPLATE_DATA;
+
+    for (uint8_t y = qr_size; y != 0u; y--) {
+        for (uint8_t count = *p_src++; count != 0u; count--) {
+            qrcode[p_src[QR_TEMPLATE_OFS_COL]] = p_src[entry_ofs];
+            p_src += QR_TEMPLATE_ENTRY_SZ;
         }
-        y++;
-    }        
+        qrcode += QR_OUTPUT_ROW_SZ_BYTES;
+    }
 }
 
-static void drawCodewordsRL(uint8_t x) {
-    uint8_t y=QRSIZE;
-    while (y) {
-        y--;
-        if (!getModule(QRCODE, x, y)) {
-            setModule(QRCODE, x, y, getBit(TMPBUFFER[dc_i >> 3], 7 - (dc_i & 7)));
-            dc_i++;
+
+// Clears QRCODE and draws all function patterns except the format bits, with data modules left 0.
+// Also makes sure the placement map is for qr_version.
+static void drawFunctionPatterns(void) {
+
+    if (templateCacheValid()) {
+        if (placement_map_version != qr_version) {
+            templateCacheCopy(QRCODE, QR_TEMPLATE_OFS_MAP);
+            buildPlacementMap();
         }
-        if (!getModule(QRCODE, x-1, y)) {
-            setModule(QRCODE, x-1, y, getBit(TMPBUFFER[dc_i >> 3], 7 - (dc_i & 7)));
-            dc_i++;
+        templateCacheCopy(QRCODE, QR_TEMPLATE_OFS_COLOR);
+    } else {
+        initializeFunctionModules(qr_version, QRCODE);
+        if (placement_map_version != qr_version) buildPlacementMap();
+        bool stored = templateCacheStoreMap();
+        drawWhiteFunctionModules();
+        if (stored) templateCacheStoreColors();
+    }
+}
+
+
+// Sets TMPBUFFER to the function module map (used to skip function modules while masking)
+static void drawFunctionMap(void) {
+
+    if (templateCacheValid()) templateCacheCopy(TMPBUFFER, QR_TEMPLATE_OFS_MAP);
+    else                      initializeFunctionModules(qr_version, TMPBUFFER);
+}
+
+
+/*---- Mask penalty scoring ----*/
+
+// Penalty weights from the QR Code spec
+#define PENALTY_N1  3u
+#define PENALTY_N2  3u
+#define PENALTY_N3 40u
+#define PENALTY_N4 10u
+
+// Number of consecutive bits starting at bit 0 which match bit 0 (i.e. length of the leftmost run in a byte)
+static const uint8_t RUN_LEN_LSB[256] = {
+    8, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 5,
+    5, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 6,
+    6, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 5,
+    5, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 7,
+    7, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 5,
+    5, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 6,
+    6, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 5,
+    5, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 4,
+    4, 1, 1, 2, 2, 1, 1, 3, 3, 1, 1, 2, 2, 1, 1, 8,
+};
+
+static const uint8_t POPCOUNT_NIBBLE[16] = {0u, 1u, 1u, 2u, 1u, 2u, 2u, 3u, 1u, 2u, 2u, 3u, 2u, 3u, 3u, 4u};
+#define POPCOUNT_8(b) (POPCOUNT_NIBBLE[(b) & 0x0Fu] + POPCOUNT_NIBBLE[(b) >> 4])
+
+// Run tracking for one line of modules (a row or a column) for the N1 and N3 (finder-like) penalties.
+// Same approach as upstream: a history of the last 7 run lengths, with the light border outside
+// the symbol added to the first and last runs.
+typedef struct penalty_run_t {
+    uint8_t  color;        // Color of the current run: 0 = light, 1 = dark
+    uint8_t  len;          // Length of the current run
+    uint16_t history[7];   // Previous run lengths, most recent first (can exceed 8 bits due to the border)
+} penalty_run_t;
+
+static uint32_t penalty_total;
+static penalty_run_t penalty_row_run;
+static penalty_run_t penalty_col_runs[8];  // One per column in an 8 column wide strip
+
+
+static void penaltyRunReset(penalty_run_t * p_run) {
+    memset(p_run, 0u, sizeof(penalty_run_t));
+}
+
+
+static void penaltyRunAddHistory(penalty_run_t * p_run, uint16_t len) {
+    if (p_run->history[0] == 0u)
+        len += qr_size;  // Add light border to initial run
+    memmove(&p_run->history[1], &p_run->history[0], (ARRAY_LEN(p_run->history) - 1u) * sizeof(p_run->history[0]));
+    p_run->history[0] = len;
+}
+
+
+// Counts 1:1:3:1:1 dark:light patterns with 4 light modules on either side in the run history
+static uint8_t penaltyRunCountFinders(const penalty_run_t * p_run) {
+    const uint16_t * h = p_run->history;
+    uint16_t n = h[1];
+    if ((n == 0u) || (h[2] != n) || (h[3] != n * 3u) || (h[4] != n) || (h[5] != n))
+        return 0u;
+    return ((h[0] >= n * 4u) && (h[6] >= n) ? 1u : 0u) + ((h[6] >= n * 4u) && (h[0] >= n) ? 1u : 0u);
+}
+
+
+// N1: runs of 5 or more modules of the same color
+static void penaltyRunScoreLength(uint8_t len) {
+    if (len >= 5u)
+        penalty_total += PENALTY_N1 + (len - 5u);
+}
+
+
+// Adds the next count (1 - 8) modules of a line from the low bits of a packed byte
+static void penaltyRunFeed(penalty_run_t * p_run, uint8_t bits, uint8_t count) {
+
+    while (count) {
+        // Whole byte runs (all light / all dark) are handled in a single step
+        uint8_t len = RUN_LEN_LSB[bits];
+        if (len > count) len = count;
+
+        if ((bits & 0x01u) != p_run->color) {
+            // Color changed, close out the current run
+            penaltyRunScoreLength(p_run->len);
+            penaltyRunAddHistory(p_run, p_run->len);
+            if (p_run->color == 0u)
+                penalty_total += penaltyRunCountFinders(p_run) * PENALTY_N3;
+            p_run->color ^= 0x01u;
+            p_run->len = 0u;
         }
+        p_run->len += len;
+        bits = (uint8_t)(bits >> len);
+        count -= len;
     }
 }
 
 
-static void drawCodewords(void) {
-    
-    dc_i=0;  // Seems to be bit index of incoming data in TMPBUFFER
-    
-    uint8_t x=QRSIZE-1;
+// Closes out the line, the light border past the end counts as part of the last light run
+static void penaltyRunEnd(penalty_run_t * p_run) {
 
-    drawCodewordsRL_faster(x);
-    // drawCodewordsRL(x);
-    x-=2;
-    
-    while(x>7) {
-
-        drawCodewordsLR_faster(x);
-        // drawCodewordsLR(x);
-        x-=2;
-        drawCodewordsRL_faster(x);
-        // drawCodewordsRL(x);
-        x-=2;
+    penaltyRunScoreLength(p_run->len);
+
+    uint16_t len = p_run->len;
+    if (p_run->color) {  // Terminate dark run
+        penaltyRunAddHistory(p_run, len);
+        len = 0u;
     }
-    x = 5;
+    penaltyRunAddHistory(p_run, len + qr_size);  // Add light border to final run
+    penalty_total += penaltyRunCountFinders(p_run) * PENALTY_N3;
+}
 
-    drawCodewordsLR_faster(x);
-    // drawCodewordsLR(x);
-    x-=2;
 
-    drawCodewordsRL_faster(x);
-    // drawCodewordsRL(x);
-    x-=2;
+// N1 + N3 for rows, N2 (2x2 blocks) and the dark module count for N4
+static uint16_t penaltyScoreRows(void) {
+
+    const uint8_t row_bytes       = QR_ROW_BYTES;
+    const uint8_t last_byte_count = qr_size & 0x07u;
+    // 2x2 blocks are scored at their top left module, so x: 0 .. qr_size - 2
+    const uint8_t block_bytes     = (qr_size - 1u + 7u) >> 3;
+    const uint8_t block_last_mask = (uint8_t)(0xFFu >> (7u - ((qr_size - 2u) & 0x07u)));
+    uint16_t dark_count = 0u;
+
+    const uint8_t * p_row = QRCODE;
+    for (uint8_t y = 0; y < qr_size; y++) {
+
+        // Row runs
+        penaltyRunReset(&penalty_row_run);
+        uint8_t col;
+        for (col = 0u; col < row_bytes - 1u; col++)
+            penaltyRunFeed(&penalty_row_run, p_row[col], 8u);
+        penaltyRunFeed(&penalty_row_run, p_row[col], last_byte_count);
+        penaltyRunEnd(&penalty_row_run);
+
+        // Bits past the right edge are always 0 (see applyMask())
+        for (col = 0u; col < row_bytes; col++)
+            dark_count += POPCOUNT_8(p_row[col]);
+
+        // 2x2 blocks: same color vertically at x and x + 1, and the same color horizontally at x
+        if (y < (qr_size - 1u)) {
+            const uint8_t * p_next_row = p_row + QR_OUTPUT_ROW_SZ_BYTES;
+            uint8_t same_v      = ~(p_row[0] ^ p_next_row[0]);
+            for (col = 0u; col < block_bytes; col++) {
+                // Bytes past the right edge only feed bit 7, which gets masked off when it's outside the symbol
+                uint8_t same_v_next = ~(p_row[col + 1u] ^ p_next_row[col + 1u]);
+                uint8_t same_h      = ~(p_row[col] ^ (uint8_t)((p_row[col] >> 1) | (p_row[col + 1u] << 7)));
+                uint8_t blocks      = same_v & (uint8_t)((same_v >> 1) | (same_v_next << 7)) & same_h;
+
+                if (col == (block_bytes - 1u)) blocks &= block_last_mask;
+                penalty_total += POPCOUNT_8(blocks) * PENALTY_N2;
+                same_v = same_v_next;
+            }
+        }
+        p_row += QR_OUTPUT_ROW_SZ_BYTES;
+    }
+    return dark_count;
+}
+
+
+// N1 + N3 for columns
+//
+// Works on 8 column wide strips: each 8x8 block gets transposed so the columns
+// become bytes which can use the same run code as the rows
+static void penaltyScoreColumns(void) {
+
+    const uint8_t row_bytes = QR_ROW_BYTES;
+    uint8_t block[8];
+
+    for (uint8_t col = 0u; col < row_bytes; col++) {
+
+        const uint8_t strip_width = (col == (row_bytes - 1u)) ? (qr_size & 0x07u) : 8u;
+        for (uint8_t i = 0u; i < strip_width; i++)
+            penaltyRunReset(&penalty_col_runs[i]);
+
+        const uint8_t * p_src = QRCODE + col;
+        for (uint8_t y = 0u; y < qr_size; y += 8u) {
+
+            uint8_t block_height = qr_size - y;
+            if (block_height > 8u) block_height = 8u;
+
+            // Transpose: bit Y of block[X] = module at (X, Y)
+            memset(block, 0u, sizeof(block));
+            uint8_t y_bit = 0x01u;
+            for (uint8_t by = 0u; by < block_height; by++) {
+                uint8_t row_bits = *p_src;
+                for (uint8_t bx = 0u; bx < 8u; bx++) {
+                    if (row_bits & 0x01u) block[bx] |= y_bit;
+                    row_bits >>= 1;
+                }
+                y_bit <<= 1;
+                p_src += QR_OUTPUT_ROW_SZ_BYTES;
+            }
+
+            for (uint8_t i = 0u; i < strip_width; i++)
+                penaltyRunFeed(&penalty_col_runs[i], block[i], block_height);
+        }
+
+        for (uint8_t i = 0u; i < strip_width; i++)
+            penaltyRunEnd(&penalty_col_runs[i]);
+    }
+}
+
+
+// Penalty score (N1 - N4) of the current QRCODE contents, lower is better
+static uint32_t getPenaltyScore(void) {
+
+    penalty_total = 0u;
+
+    uint16_t dark  = penaltyScoreRows();
+    penaltyScoreColumns();
+
+    // N4: balance of dark and light modules
+    // Find smallest k such that (45-5k)% <= dark <= (55+5k)%
+    uint16_t total = (uint16_t)qr_size * qr_size;
+    uint32_t dark_20  = (uint32_t)dark * 20u;
+    uint32_t total_10 = (uint32_t)total * 10u;
+    uint32_t diff = (dark_20 > total_10) ? (dark_20 - total_10) : (total_10 - dark_20);
+    uint16_t k = (uint16_t)((diff + total - 1u) / total) - 1u;
+    penalty_total += (uint32_t)k * PENALTY_N4;
+
+    return penalty_total;
+}
+
+
+// Scores one mask for mask selection (see QR_MASK_CANDIDATES in qrcodegen.h)
+//
+// The mask is applied along with its format bits, scored, then removed again.
+// Requires QRCODE to have all modules drawn (unmasked) and TMPBUFFER to have the function modules set.
+static uint32_t getMaskPenalty(uint8_t mask) {
+
+    applyMask(mask);
+    drawFormatBits(mask);
+    uint32_t penalty = getPenaltyScore();
+    applyMask(mask);  // Undo
+
+    EMU_printf("QR mask %hu penalty=%lu\n", (uint8_t)mask, (uint32_t)penalty);
+    return penalty;
+}
+
+
+
+
+/*---- Segment handling ----*/
+
+// Char count field width per mode for versions 1-9, 10-26 and 27-40
+static const uint8_t CHAR_COUNT_BITS[3][3] = {
+	// Numeric, Alphanumeric, Byte
+	{10,  9,  8},
+	{12, 11, 16},
+	{14, 13, 16},
+};
+
+// Mode indicator values to the CHAR_COUNT_BITS column
+static uint8_t modeIndex(uint8_t mode) {
+	return (mode == qrcodegen_Mode_NUMERIC) ? 0u : ((mode == qrcodegen_Mode_ALPHANUMERIC) ? 1u : 2u);
+}
+
+static uint8_t numCharCountBits(uint8_t mode, uint8_t version) {
+	return CHAR_COUNT_BITS[(version < 10u) ? 0u : ((version < 27u) ? 1u : 2u)][modeIndex(mode)];
+}
+
+
+// Data bits (without the header) for len chars in the given mode
+static uint16_t segmentDataBits(uint8_t mode, uint16_t len) {
+	switch (mode) {
+		case qrcodegen_Mode_NUMERIC:      return ((len / 3u) * 10u) + (((len % 3u) == 2u) ? 7u : ((len % 3u) * 4u));
+		case qrcodegen_Mode_ALPHANUMERIC: return ((len / 2u) * 11u) + ((len & 1u) * 6u);
+		default:                          return len * 8u;
+	}
+}
+
+
+// Chars that fit in the given number of data bits, the inverse of segmentDataBits()
+static uint16_t segmentCharsForBits(uint8_t mode, uint16_t bits) {
+	switch (mode) {
+		case qrcodegen_Mode_NUMERIC:      return ((bits / 10u) * 3u) + (((bits % 10u) >= 7u) ? 2u : (((bits % 10u) >= 4u) ? 1u : 0u));
+		case qrcodegen_Mode_ALPHANUMERIC: return ((bits / 11u) * 2u) + (((bits % 11u) >= 6u) ? 1u : 0u);
+		default:                          return bits / 8u;
+	}
+}
+
 
-    drawCodewordsLR_faster(x);
-    // drawCodewordsLR(x);
+// Structured append header: mode indicator + symbol position + total symbols - 1 + parity
+#define STRUCTURED_APPEND_HEADER_BITS (4u + 4u + 4u + 8u)
+#define qrcodegen_Mode_STRUCTURED_APPEND 0x3u
+
+static uint8_t sa_position;
+static uint8_t sa_total;   // 0 (or 1) when off
+static uint8_t sa_parity;
+
+#define SA_HEADER_BITS ((sa_total > 1u) ? STRUCTURED_APPEND_HEADER_BITS : 0u)
+
+
+void qrcodegen_set_structured_append(uint8_t position, uint8_t total, uint8_t parity) BANKED {
+	sa_position = position;
+	sa_total    = (total > QR_STRUCTURED_APPEND_MAX) ? QR_STRUCTURED_APPEND_MAX : total;
+	sa_parity   = parity;
 }
 
-static void applyMask0(void) {
-    uint8_t invert;
-	for (uint8_t y = 0; y < QRSIZE; y++) {
-        invert = ((y&1)?0xAA:~0xAA);
-		for (uint8_t x = 0; x < QRSIZE; x+=8) {
-            uint8_t tmp = invert & ~getModule8(TMPBUFFER, x, y);
-            
-			setModule8(QRCODE, x, y,  getModule8(QRCODE, x, y) ^ tmp);
+
+// Picks the smallest version in [QR_VERSION_MIN, QR_VERSION_MAX] that fits all the
+// segments (headers + data). Returns 0 if it doesn't fit in any of them.
+static uint8_t selectVersion(const qr_segment_t * p_segments, uint8_t count) {
+
+	for (uint8_t version = QR_VERSION_MIN; version <= QR_VERSION_MAX; version++) {
+
+		uint32_t needed_bits = SA_HEADER_BITS;
+		bool     fits        = true;
+		for (uint8_t i = 0u; i < count; i++) {
+			const uint8_t cc_bits = numCharCountBits(p_segments[i].mode, version);
+			// Char count has to fit in its field
+			if ((cc_bits < 16u) && (p_segments[i].len >= (1u << cc_bits))) { fits = false; break; }
+			// Mode indicator (4 bits) + char count + data
+			needed_bits += 4u + cc_bits + segmentDataBits(p_segments[i].mode, p_segments[i].len);
 		}
+		// Compared in bytes rounded up
+		if (fits && (((needed_bits + 7u) / 8u) <= (uint32_t)getNumDataCodewords(version)))
+			return version;
 	}
+	return 0;
 }
 
 
+// Local version so the per char segment and append loops don't go through a banked call
+static uint8_t alnumValue(uint8_t c) {
+
+	if ((c >= '0') && (c <= '9')) return c - '0';
+	if ((c >= 'A') && (c <= 'Z')) return (c - 'A') + 10u;
+	switch (c) {
+		case ' ': return 36u;
+		case '$': return 37u;
+		case '%': return 38u;
+		case '*': return 39u;
+		case '+': return 40u;
+		case '-': return 41u;
+		case '.': return 42u;
+		case '/': return 43u;
+		case ':': return 44u;
+	}
+	return QR_ALNUM_INVALID;
+}
 
+uint8_t qrcodegen_alnum_value(uint8_t c) BANKED {
+	return alnumValue(c);
+}
 
-/*---- Segment handling ----*/
 
-INLINE int numCharCountBits(void) { return SELECT(((QRVERSION + 7) / 17), 8, 16, 16); }
+uint16_t qrcodegen_fit_segments(qr_segment_t * p_segments, uint8_t * p_count, uint8_t version) BANKED {
+
+	uint16_t avail_bits = (getNumDataCodewords(version) * 8u) - SA_HEADER_BITS;
+	uint16_t chars = 0u;
+	uint8_t  kept  = 0u;
+
+	while (kept < *p_count) {
+		qr_segment_t * p_seg   = &p_segments[kept];
+		const uint8_t  cc_bits = numCharCountBits(p_seg->mode, version);
+
+		if (avail_bits <= (4u + cc_bits)) break;
+		avail_bits -= 4u + cc_bits;
+
+		// Limited by the char count field, and by the space left
+		uint16_t len = p_seg->len;
+		if ((cc_bits < 16u) && (len >= (1u << cc_bits))) len = (1u << cc_bits) - 1u;
+		if (segmentDataBits(p_seg->mode, len) > avail_bits) len = segmentCharsForBits(p_seg->mode, avail_bits);
+		if (len == 0u) break;
+
+		avail_bits -= segmentDataBits(p_seg->mode, len);
+		chars += len;
+		kept++;
+		if (len != p_seg->len) {
+			p_seg->len = len;
+			break;  // Out of space
+		}
+	}
+	*p_count = kept;
+	return chars;
+}
+
+
+// Narrowest mode which can hold the char (numeric < alphanumeric < byte)
+static uint8_t charMode(uint8_t c) {
+	if ((c >= '0') && (c <= '9'))                  return qrcodegen_Mode_NUMERIC;
+	if (alnumValue(c) != QR_ALNUM_INVALID)          return qrcodegen_Mode_ALPHANUMERIC;
+	return qrcodegen_Mode_BYTE;
+}
+
+// Mode values happen to be in increasing order of what they can hold
+#define MODE_WIDEST(a, b) (((a) > (b)) ? (a) : (b))
+
+// Header + data bits of a segment, header size is for the version the caller estimated
+static uint16_t segmentBits(uint8_t mode, uint16_t len, uint8_t version) {
+	return 4u + numCharCountBits(mode, version) + segmentDataBits(mode, len);
+}
+
+
+// Number of chars at the start of the text which fit in the mode
+static uint16_t runLength(const uint8_t * p_text, uint16_t len, uint8_t mode) {
+	uint16_t run = 0u;
+	while ((run < len) && (charMode(p_text[run]) <= mode)) run++;
+	return run;
+}
+
+
+// Whether a run of chars takes fewer bits as its own narrower segment than inside a wider
+// one. Unless the run is at the end, the wider mode needs another header to resume after it.
+static bool worthSwitching(uint8_t mode, uint16_t len, uint8_t wider_mode, bool at_end, uint8_t version) {
+	uint16_t separate_bits = segmentBits(mode, len, version);
+	if (!at_end) separate_bits += 4u + numCharCountBits(wider_mode, version);
+	return separate_bits < segmentDataBits(wider_mode, len);
+}
+
+
+// Splits the text into segments, switching to a narrower mode only where the run of chars
+// which fit in it saves more bits than the extra segment headers cost (like ISO 18004 Annex J,
+// but with the break-even lengths worked out from the bit costs instead of tables).
+//
+// Header sizes depend on the version, which depends on the segments. So they are
+// estimated with the version the whole text would need in byte mode (the worst case).
+uint8_t qrcodegen_make_segments(const uint8_t * p_text, uint16_t len, qr_segment_t * p_segments, uint8_t max_count) BANKED {
+
+	if ((len == 0u) || (max_count == 0u)) return 0u;
+
+	qr_segment_t whole = {qrcodegen_Mode_BYTE, len};
+	uint8_t version = selectVersion(&whole, 1u);
+	if (version == 0u) version = QR_VERSION_MAX;
+
+	uint8_t count = 0u;
+	while (len) {
+		uint8_t  mode;
+		uint16_t seg_len;
+
+		if (count == (max_count - 1u)) {
+			// Out of segments, the last one takes the rest
+			mode = qrcodegen_Mode_NUMERIC;
+			for (seg_len = 0u; seg_len < len; seg_len++) mode = MODE_WIDEST(mode, charMode(p_text[seg_len]));
+		}
+		else {
+			// Start in the narrowest mode whose run is worth a segment of its own,
+			// otherwise widen to the mode of the char which ends the run
+			mode = charMode(*p_text);
+			while (mode != qrcodegen_Mode_BYTE) {
+				const uint16_t run = runLength(p_text, len, mode);
+				if (run == len) break;
+				const uint8_t wider_mode = charMode(p_text[run]);
+				if (worthSwitching(mode, run, wider_mode, true, version)) break;
+				mode = wider_mode;
+			}
+
+			// Extend until a char doesn't fit, or a run of narrower chars is worth switching to
+			seg_len = 0u;
+			while (seg_len < len) {
+				const uint8_t char_mode = charMode(p_text[seg_len]);
+				if (char_mode > mode) break;
+				if (char_mode == mode) { seg_len++; continue; }
+
+				// Check the widest narrower mode, then numeric if that's narrower still
+				const uint8_t  try_mode = (mode == qrcodegen_Mode_BYTE) ? qrcodegen_Mode_ALPHANUMERIC : qrcodegen_Mode_NUMERIC;
+				const uint16_t run      = runLength(p_text + seg_len, len - seg_len, try_mode);
+				if (worthSwitching(try_mode, run, mode, (seg_len + run) == len, version)) break;
+				if (try_mode != char_mode) {
+					const uint16_t num_run = runLength(p_text + seg_len, len - seg_len, char_mode);
+					if (worthSwitching(char_mode, num_run, mode, (seg_len + num_run) == len, version)) break;
+					seg_len += num_run;
+				}
+				else seg_len += run;
+			}
+		}
+
+		if (count && (p_segments[count - 1u].mode == mode))
+			p_segments[count - 1u].len += seg_len;  // Can happen with the last segment taking the rest
+		else {
+			p_segments[count].mode = mode;
+			p_segments[count].len  = seg_len;
+			count++;
+		}
+		p_text += seg_len;
+		len    -= seg_len;
+	}
+	return count;
+}
 
 
 
@@ -780,16 +1571,30 @@ INLINE int numCharCountBits(void) { return SELECT(((QRVERSION + 7) / 17), 8, 16,
 
 // Appends the given number of low-order bits of the given value to the given byte-based
 // bit buffer, increasing the bit length. Requires 0 <= numBits <= 16 and val < 2^numBits.
+// Bits are ORed in, so the buffer must be cleared past bitLen. Writes up to a byte at a time.
 // INLINE
 void appendBitsToBuffer(unsigned int val, int numBits, uint8_t buffer[], int *bitLen) {
 	assert(0 <= numBits && numBits <= 16 && (unsigned long)val >> numBits == 0);
-	for (int i = numBits - 1; i >= 0; i--, (*bitLen)++)
-		buffer[*bitLen >> 3] |= ((val >> i) & 1) << (7 - (*bitLen & 7));
+
+	uint8_t * p_out = buffer + (*bitLen >> 3);
+	uint8_t   free  = 8u - (*bitLen & 7);  // Unused bits in the current byte
+	*bitLen += numBits;
+
+	while (numBits > 0) {
+		if (numBits >= free) {
+			numBits -= free;
+			*p_out++ |= (uint8_t)(val >> numBits) & (uint8_t)((1u << free) - 1u);
+			free = 8u;
+		} else {
+			*p_out |= (uint8_t)((val & ((1u << numBits) - 1u)) << (free - numBits));
+			numBits = 0;
+		}
+	}
 }
 
 // INLINE
 // Much faster version of appendBitsToBuffer() which accepts only whole bytes 
-void appendByteBitsToBuffer(uint8_t * p_srcdata, uint8_t * p_outdata, uint16_t byte_len, int *bitLen) {
+void appendByteBitsToBuffer(const uint8_t * p_srcdata, uint8_t * p_outdata, uint16_t byte_len, int *bitLen) {
 
     if (byte_len == 0) return;
 
@@ -802,7 +1607,7 @@ void appendByteBitsToBuffer(uint8_t * p_srcdata, uint8_t * p_outdata, uint16_t b
     // If bit alignment is 0 then take a fast path since no bit shifting is needed
     if (bit_alignment == 0u) {
         while (byte_len-- > 0) {
-            *p_outdata-- = *p_srcdata;
+            *p_outdata++ = *p_srcdata++;
         }
     }
     else {
@@ -857,61 +1662,287 @@ uint8_t *qrcodegen(const char *text, uint16_t len) BANKED {
     
     // uint8_t len = 0;
     // while (text[len]!=0) len++;
-	
-	const uint8_t *data = (const uint8_t *)text;
 
+	qr_segment_t segments[QR_SEGMENTS_MAX];
+	uint8_t count = qrcodegen_make_segments((const uint8_t *)text, len, segments, QR_SEGMENTS_MAX);
+
+	if (!qrcodegen_stream_begin_segments(segments, count)) return NULL;
+	qrcodegen_stream_append((const uint8_t *)text, len);
+	return qrcodegen_stream_end();
+}
+
+
+// Streamed data: the segment data gets appended straight into the
+// QR Code data bits in pieces as it's produced (no buffer for the whole string)
+static int stream_bitLen;
+static uint16_t stream_len_remaining;
+
+static qr_segment_t stream_segments[QR_SEGMENTS_MAX];
+static uint8_t  stream_segment_count;
+static uint8_t  stream_segment_index;
+static uint16_t stream_segment_remaining;  // Chars left in the current segment
+
+// Numeric and alphanumeric modes pack several chars together, which may arrive in different appends
+static uint16_t stream_pending_value;
+static uint8_t  stream_pending_count;
+
+
+// Steps for finishing a streamed QR Code, see qrcodegen_stream_end_step()
+enum {
+	END_STEP_PAD,    // Terminator and padding
+	END_STEP_ECC,    // One Reed-Solomon block per step
+	END_STEP_PLACE,  // Function patterns and codeword placement
+	END_STEP_MASK,   // One mask candidate scored per step
+	END_STEP_APPLY,  // Best mask and format bits
+	END_STEP_DONE,
+	END_STEP_ERROR
+};
+
+static uint8_t  end_step = END_STEP_ERROR;
+static uint8_t  end_ecc_block;
+static uint8_t  end_mask;
+static uint8_t  end_best_mask;
+static uint32_t end_best_penalty;
+
+
+static void streamBeginSegment(void) {
+
+	const qr_segment_t * p_seg = &stream_segments[stream_segment_index];
+
+	appendBitsToBuffer((unsigned int)p_seg->mode, 4, QRCODE, &stream_bitLen);
+	appendBitsToBuffer((unsigned int)p_seg->len, numCharCountBits(p_seg->mode, qr_version), QRCODE, &stream_bitLen);
+	stream_segment_remaining = p_seg->len;
+	stream_pending_value = 0u;
+	stream_pending_count = 0u;
+}
+
+
+// Writes out a partial group of numeric or alphanumeric chars left at the end of a segment
+static void streamEndSegment(void) {
+
+	if (stream_pending_count) {
+		if (stream_segments[stream_segment_index].mode == qrcodegen_Mode_NUMERIC)
+			appendBitsToBuffer(stream_pending_value, (stream_pending_count == 2u) ? 7 : 4, QRCODE, &stream_bitLen);
+		else
+			appendBitsToBuffer(stream_pending_value, 6, QRCODE, &stream_bitLen);
+	}
+}
+
+
+// Numeric: 3 digits per 10 bits
+static void streamAppendNumeric(const uint8_t * p_data, uint16_t len) {
+
+	while (len--) {
+		stream_pending_value = (stream_pending_value * 10u) + (*p_data++ - '0');
+		if (++stream_pending_count == 3u) {
+			appendBitsToBuffer(stream_pending_value, 10, QRCODE, &stream_bitLen);
+			stream_pending_value = 0u;
+			stream_pending_count = 0u;
+		}
+	}
+}
+
+
+// Alphanumeric: 2 chars per 11 bits
+static void streamAppendAlnum(const uint8_t * p_data, uint16_t len) {
+
+	while (len--) {
+		uint8_t value = alnumValue(*p_data++);
+		if (value == QR_ALNUM_INVALID) value = 0u;  // Invalid for the mode, keep the length right at least
+
+		if (stream_pending_count) {
+			appendBitsToBuffer((stream_pending_value * 45u) + value, 11, QRCODE, &stream_bitLen);
+			stream_pending_count = 0u;
+		} else {
+			stream_pending_value = value;
+			stream_pending_count = 1u;
+		}
+	}
+}
+
+
+bool qrcodegen_stream_begin(uint16_t len) BANKED {
+
+	qr_segment_t segment = {qrcodegen_Mode_BYTE, len};
+	return qrcodegen_stream_begin_segments(&segment, 1u);
+}
+
+
+bool qrcodegen_stream_begin_segments(const qr_segment_t * p_segments, uint8_t count) BANKED {
+
+	end_step = END_STEP_ERROR;
+	if ((count == 0u) || (count > QR_SEGMENTS_MAX)) return false;
+
+	stream_len_remaining = 0u;
+	for (uint8_t i = 0u; i < count; i++) {
+		if (p_segments[i].len == 0u) return false;
+		stream_len_remaining += p_segments[i].len;
+	}
+
+	// Use the smallest version that fits the data
+	qr_version = selectVersion(p_segments, count);
+	if (qr_version == 0) return false;
+	qr_size  = QRSIZE_FROM_VERSION(qr_version);
+	RSDegree = ECC_CODEWORDS_PER_BLOCK[QRECL][qr_version];
+	EMU_printf("QR version=%hu, size=%hu, segments=%hu, symbol=%hu/%hu\n", (uint8_t)qr_version, (uint8_t)qr_size, (uint8_t)count,
+	           (uint8_t)(sa_position + 1u), (uint8_t)sa_total);
+
+	memcpy(stream_segments, p_segments, count * sizeof(qr_segment_t));
+	stream_segment_count = count;
+	stream_segment_index = 0u;
 
 	// Concatenate all segments to create the data bit string
+	PROF_BEGIN(PROF_STAGE_QR_APPEND);
 	memset(QRCODE, 0, (size_t)qrcodegen_BUFFER_SZ * sizeof(QRCODE[0]));
-	int bitLen = 0;
-    appendBitsToBuffer((unsigned int)MODE, 4, QRCODE, &bitLen);
-    appendBitsToBuffer((unsigned int)len, numCharCountBits(), QRCODE, &bitLen);
-
-    EMU_printf("bitlen=%d\n", (int16_t)bitLen);
-    // EMU_BREAKPOINT;
-    // Append incoming data as bytes instead of 1 bit at a time, about 12x faster
-    appendByteBitsToBuffer(data, QRCODE + (bitLen/8), len, &bitLen);
-    // for (int j = 0; j < len*8; j++) {
-    //     int bit = (data[j >> 3] >> (7 - (j & 7))) & 1;
-    //     appendBitsToBuffer((unsigned int)bit, 1, QRCODE, &bitLen);
-    // }
-    EMU_printf("After %d bytes Data Appended -> bitlen=%d\n", (uint16_t)len, (int16_t)bitLen);
-    // EMU_BREAKPOINT;
-	
-	// Add terminator and pad up to a byte if applicable
-	appendBitsToBuffer(0, 4, QRCODE, &bitLen);
+	stream_bitLen = 0;
+	if (sa_total > 1u) {
+		appendBitsToBuffer(qrcodegen_Mode_STRUCTURED_APPEND, 4, QRCODE, &stream_bitLen);
+		appendBitsToBuffer(sa_position, 4, QRCODE, &stream_bitLen);
+		appendBitsToBuffer(sa_total - 1u, 4, QRCODE, &stream_bitLen);
+		appendBitsToBuffer(sa_parity, 8, QRCODE, &stream_bitLen);
+	}
+	streamBeginSegment();
+	PROF_END(PROF_STAGE_QR_APPEND);
+	end_step = END_STEP_PAD;
 
-	int dataCapacityBits = getNumDataCodewords() * 8;
-	
-	// Pad with alternating bytes until data capacity is reached
-	for (uint8_t padByte = 0xEC; bitLen < dataCapacityBits; padByte ^= 0xEC ^ 0x11)
-		appendBitsToBuffer(padByte, 8, QRCODE, &bitLen);
-	
-	// Draw function and data codeword modules
-    // debugBorder(BWhite);
-	addEccAndInterleave(QRCODE, TMPBUFFER);
-    // debugBorder(BLightBlue);
-	initializeFunctionModules(QRVERSION, QRCODE);
-    // debugBorder(BLightGreen); //***
-	drawCodewords();
-    // debugBorder(BLightRed);
-	drawWhiteFunctionModules();
-    // debugBorder(BLightYellow);
-	initializeFunctionModules(QRVERSION, TMPBUFFER);
-    // debugBorder(BDarkRed); 
-    applyMask0();
-    // debugBorder(BDarkYellow);
-	drawFormatBits();
-    // debugBorder(BBlack);
-        
-    return QRCODE;
+    EMU_printf("bitlen=%d\n", (int16_t)stream_bitLen);
+    return true;
+}
+
+
+void qrcodegen_stream_append(const uint8_t * p_data, uint16_t len) BANKED {
+
+	// Never write past the length given to qrcodegen_stream_begin()
+	if (len > stream_len_remaining) len = stream_len_remaining;
+	stream_len_remaining -= len;
+
+	PROF_BEGIN(PROF_STAGE_QR_APPEND);
+	while (len) {
+		uint16_t seg_len = (len > stream_segment_remaining) ? stream_segment_remaining : len;
+
+		switch (stream_segments[stream_segment_index].mode) {
+			case qrcodegen_Mode_NUMERIC:      streamAppendNumeric(p_data, seg_len); break;
+			case qrcodegen_Mode_ALPHANUMERIC: streamAppendAlnum(p_data, seg_len);   break;
+			default:
+				// Append incoming data as bytes instead of 1 bit at a time, about 12x faster
+				appendByteBitsToBuffer(p_data, QRCODE + (stream_bitLen/8), seg_len, &stream_bitLen);
+				break;
+		}
+		p_data += seg_len;
+		len    -= seg_len;
+
+		stream_segment_remaining -= seg_len;
+		if (stream_segment_remaining == 0u) {
+			streamEndSegment();
+			if (++stream_segment_index < stream_segment_count) streamBeginSegment();
+		}
+	}
+	PROF_END(PROF_STAGE_QR_APPEND);
+}
+
+
+uint8_t qrcodegen_stream_end_step(void) BANKED {
+
+	switch (end_step) {
+
+		case END_STEP_PAD: {
+			// Appended data came up short of the length in the header
+			if (stream_len_remaining) {
+				end_step = END_STEP_ERROR;
+				return QR_STEP_ERROR;
+			}
+
+			int bitLen = stream_bitLen;
+			EMU_printf("After Data Appended -> bitlen=%d\n", (int16_t)bitLen);
+
+			PROF_BEGIN(PROF_STAGE_QR_APPEND);
+			// Add terminator and pad up to a byte if applicable
+			appendBitsToBuffer(0, 4, QRCODE, &bitLen);
+			bitLen = (bitLen + 7) & ~7;  // Only byte mode segments always end up aligned here
+
+			int dataCapacityBits = getNumDataCodewords(qr_version) * 8;
+
+			// Pad with alternating bytes until data capacity is reached
+			for (uint8_t padByte = 0xEC; bitLen < dataCapacityBits; padByte ^= 0xEC ^ 0x11)
+				appendBitsToBuffer(padByte, 8, QRCODE, &bitLen);
+			PROF_END(PROF_STAGE_QR_APPEND);
+
+			addEccBegin(QRCODE);
+			end_ecc_block = 0u;
+			end_step = END_STEP_ECC;
+			break;
+		}
+
+		case END_STEP_ECC:
+			PROF_BEGIN(PROF_STAGE_QR_RS);
+			if (addEccBlock(end_ecc_block++, TMPBUFFER)) end_step = END_STEP_PLACE;
+			PROF_END(PROF_STAGE_QR_RS);
+			break;
+
+		case END_STEP_PLACE:
+			// Draw function and data codeword modules
+			PROF_BEGIN(PROF_STAGE_QR_PLACE);
+			drawFunctionPatterns();
+			drawCodewords();
+			drawFunctionMap();
+			PROF_END(PROF_STAGE_QR_PLACE);
+
+			end_mask = 0u;
+			end_best_mask = QR_MASK_FIXED;
+			end_best_penalty = UINT32_MAX;
+			end_step = END_STEP_MASK;
+			break;
+
+		case END_STEP_MASK:
+			// Picks the mask with the lowest penalty out of QR_MASK_CANDIDATES (see qrcodegen.h)
+			#if (QR_MASK_SELECT == QR_MASK_SELECT_BEST)
+				while ((end_mask < 8u) && !(QR_MASK_CANDIDATES & (1u << end_mask))) end_mask++;
+				if (end_mask < 8u) {
+					PROF_BEGIN(PROF_STAGE_QR_MASK);
+					uint32_t penalty = getMaskPenalty(end_mask);
+					PROF_END(PROF_STAGE_QR_MASK);
+					if (penalty < end_best_penalty) {
+						end_best_penalty = penalty;
+						end_best_mask    = end_mask;
+					}
+					end_mask++;
+					break;
+				}
+			#endif
+			end_step = END_STEP_APPLY;
+			break;
+
+		case END_STEP_APPLY:
+			PROF_BEGIN(PROF_STAGE_QR_MASK);
+			applyMask(end_best_mask);
+			drawFormatBits(end_best_mask);
+			PROF_END(PROF_STAGE_QR_MASK);
+			end_step = END_STEP_DONE;
+			return QR_STEP_DONE;
+
+		case END_STEP_DONE:
+			return QR_STEP_DONE;
+
+		default:
+			return QR_STEP_ERROR;
+	}
+	return QR_STEP_BUSY;
+}
+
+
+uint8_t * qrcodegen_stream_end(void) BANKED {
+
+	uint8_t status;
+	while ((status = qrcodegen_stream_end_step()) == QR_STEP_BUSY);
+
+	return (status == QR_STEP_DONE) ? QRCODE : NULL;
 }
 
 bool qr(uint8_t x, uint8_t y) {
     if (!x) return 1;
     if (!y) return 1;
-    if (x>QRSIZE) return 1;
-    if (y>QRSIZE) return 1;
+    if (x>qr_size) return 1;
+    if (y>qr_size) return 1;
     return !qr_get(x-1,y-1);
 }
 
@@ -6,19 +6,24 @@ BANKREF_EXTERN(qrcodegen)
 // ========== Configurable Settings ==========
 
 // See: https://www.qrcode.com/en/about/version.html
-// Also, see "Byte sz" column table further below for selecting QRVERSION
+// Also, see "Byte sz" column table further below for selecting QR_VERSION_MAX
 // Only configured for "Byte" mode operation
 //
-// #define QRVERSION 3                   // <---- Configurable to change size and capacity <----
-#define QRVERSION 31
+// The version (size) is picked at runtime: the smallest version in the
+// range below which fits the payload gets used. Smaller versions have
+// larger modules on screen, which makes them easier to scan.
+//
+// Buffers are statically sized for QR_VERSION_MAX
+#define QR_VERSION_MIN 1
+#define QR_VERSION_MAX 31               // <---- Configurable to change max size and capacity <----
 
 
 // Manually set this based on the "Byte sz" column that matches:
 // - The "Error Correction" Low setting
-// - And the "Version" which matches QRVERSION above
+// - And the "Version" which matches QR_VERSION_MAX above
 //
-// #define QR_MAX_PAYLOAD_BYTES 53u      // <---- Change this based on the table below and QRVERSION above <----
-#define QR_MAX_PAYLOAD_BYTES 1840  // Size for Version "10" in Byte mode, Low Quality
+// #define QR_MAX_PAYLOAD_BYTES 53u      // <---- Change this based on the table below and QR_VERSION_MAX above <----
+#define QR_MAX_PAYLOAD_BYTES 1840  // Size for Version "31" in Byte mode, Low Quality
 //
 // For example these are the defaults for Version "3"
 // | Version   |                             |   Byte sz     |
@@ -31,17 +36,56 @@ BANKREF_EXTERN(qrcodegen)
 #define QRECL qrcodegen_Ecc_LOW
 
 
+// Reed-Solomon ECC engine
+// - LOG_EXP:    256 byte log/antilog tables in the same bank as qrcodegen (default)
+// - LUT_BANKED: 64K full multiply table split across ROM banks 1-4 (qrcode_rsmul_lut_N.c),
+//               requires a bank switch per multiply. Those files are empty unless this is selected
+#define QR_RS_ENGINE_LOG_EXP    0
+#define QR_RS_ENGINE_LUT_BANKED 1
+
+#ifndef QR_RS_ENGINE
+    #define QR_RS_ENGINE QR_RS_ENGINE_LOG_EXP
+#endif
+
+
+// Mask pattern selection
+// - FIXED: Always use QR_MASK_FIXED (fastest, but some data produces large same color areas that are harder to scan)
+// - BEST:  Score each mask in QR_MASK_CANDIDATES (bit N = mask N) and use the one with the lowest penalty.
+//          0xFFu evaluates all 8 masks (the spec behavior), fewer candidates cost less time per QR Code
+#define QR_MASK_SELECT_FIXED 0
+#define QR_MASK_SELECT_BEST  1
+
+#ifndef QR_MASK_SELECT
+    #define QR_MASK_SELECT QR_MASK_SELECT_BEST
+#endif
+
+#define QR_MASK_FIXED 0
+
+#ifndef QR_MASK_CANDIDATES
+    #define QR_MASK_CANDIDATES 0xFFu
+#endif
+
+
+// Max number of segments (runs of one mode) per QR Code, see qrcodegen_make_segments()
+#ifndef QR_SEGMENTS_MAX
+    #define QR_SEGMENTS_MAX 8u
+#endif
+
+
 // ========== Below are Non-Configurable Calculations ==========
 // #define QRPAD 32
 
 // This calculates the width and height in pixels ("modules")
 // of the QR Code image PRIOR to borders
-#define QRSIZE (QRVERSION * 4 + 17)
+#define QRSIZE_FROM_VERSION(v) ((v) * 4 + 17)
+#define QRSIZE_MAX             QRSIZE_FROM_VERSION(QR_VERSION_MAX)
 
 // QR Output row size in bytes should be:
 //   pixel width / 8, rounded up to nearest whole value of 8
+//
+// The row stride stays fixed at the size needed by QR_VERSION_MAX for all versions
 #define PIXELS_PER_BYTE  8u // 1bpp, so 8 horizontal pixels per byte
-#define QR_OUTPUT_ROW_SZ_BYTES  ((QRSIZE + (PIXELS_PER_BYTE - 1u)) / PIXELS_PER_BYTE)
+#define QR_OUTPUT_ROW_SZ_BYTES  ((QRSIZE_MAX + (PIXELS_PER_BYTE - 1u)) / PIXELS_PER_BYTE)
 
 // The output QRCode is stored internally as a 1bpp image with
 // each row composed of bytes, where a byte stores 8 sequential horizontal pixels.
@@ -51,8 +95,8 @@ BANKREF_EXTERN(qrcodegen)
 // This is the Width and Height of the QR code image prior to any user scaling
 // 1 pixel of border on each side, hence +2
 #define QR_BORDER_WIDTH 1u
-#define QR_FINAL_PIXEL_WIDTH  (QRSIZE + (QR_BORDER_WIDTH * 2u))
-#define QR_FINAL_PIXEL_HEIGHT (QRSIZE + (QR_BORDER_WIDTH * 2u))
+#define QR_FINAL_PIXEL_WIDTH_MAX  (QRSIZE_MAX + (QR_BORDER_WIDTH * 2u))
+#define QR_FINAL_PIXEL_HEIGHT_MAX (QRSIZE_MAX + (QR_BORDER_WIDTH * 2u))
 
 
 
@@ -62,8 +106,74 @@ BANKREF_EXTERN(qrcodegen)
 extern uint8_t QRCODE[];
 extern const uint8_t qr_bitmask[];
 
+// Version and size in modules of the last generated QR Code
+extern uint8_t qr_version;
+extern uint8_t qr_size;
+
+// Segment modes (values are the QR Code mode indicators)
+enum qrcodegen_Mode {
+	qrcodegen_Mode_NUMERIC      = 0x1,  // 0-9, 3.33 bits per char
+	qrcodegen_Mode_ALPHANUMERIC = 0x2,  // 0-9, A-Z (upper-case only), space, $, %, *, +, -, ., /, :  5.5 bits per char. Note: No semicolon as needed for mime header
+	qrcodegen_Mode_BYTE         = 0x4,  // 8 bits per char
+	qrcodegen_Mode_KANJI        = 0x8,  // Not supported
+	qrcodegen_Mode_ECI          = 0x7,  // Not supported
+};
+
+typedef struct qr_segment_t {
+    uint8_t  mode;  // qrcodegen_Mode_NUMERIC, _ALPHANUMERIC or _BYTE
+    uint16_t len;   // In chars (bytes for byte mode), never 0
+} qr_segment_t;
+
 // uint8_t *qrcodegen(const char *text);
+// Returns NULL if the data doesn't fit in QR_VERSION_MAX
+// The text is split into segments with qrcodegen_make_segments()
 uint8_t *qrcodegen(const char *text, uint16_t len) BANKED;
+
+// Splits text into up to max_count segments, picking the mode with the fewest bits for each run of chars
+// (including the cost of the segment headers). Returns the number of segments, 0 if len is 0
+uint8_t qrcodegen_make_segments(const uint8_t * p_text, uint16_t len, qr_segment_t * p_segments, uint8_t max_count) BANKED;
+
+// Returns the value of c in alphanumeric mode, or QR_ALNUM_INVALID if it isn't in that char set
+#define QR_ALNUM_INVALID 0xFFu
+uint8_t qrcodegen_alnum_value(uint8_t c) BANKED;
+
+// Truncates the segments to what fits in the given version (including the segment and any
+// structured append headers), updating the count. Returns the number of chars that fit
+uint16_t qrcodegen_fit_segments(qr_segment_t * p_segments, uint8_t * p_count, uint8_t version) BANKED;
+
+// Structured append (ISO 18004): one message split across up to QR_STRUCTURED_APPEND_MAX QR Codes,
+// which scanners that support it join back together.
+// Applies to the QR Codes started after it. position is 0 based, total <= 1 turns it off.
+// parity is the XOR of every byte of the whole message (the same for all its QR Codes)
+#define QR_STRUCTURED_APPEND_MAX 16u
+void qrcodegen_set_structured_append(uint8_t position, uint8_t total, uint8_t parity) BANKED;
+
+// Same as qrcodegen(), but with the data appended in pieces as it gets produced:
+// - qrcodegen_stream_begin():  len is the total data length, returns false if it doesn't fit in QR_VERSION_MAX
+// - qrcodegen_stream_append(): any number of calls, data past the total length is dropped
+// - qrcodegen_stream_end():    returns NULL if less than the total length was appended
+//
+// qrcodegen_stream_begin_segments() is the same as qrcodegen_stream_begin(), but for a list of segments
+// (copied, up to QR_SEGMENTS_MAX). Appended data fills them in order, the total length is the sum of theirs.
+// Chars appended to a numeric or alphanumeric segment must be valid for that mode.
+bool qrcodegen_stream_begin(uint16_t len) BANKED;
+bool qrcodegen_stream_begin_segments(const qr_segment_t * p_segments, uint8_t count) BANKED;
+void qrcodegen_stream_append(const uint8_t * p_data, uint16_t len) BANKED;
+uint8_t * qrcodegen_stream_end(void) BANKED;
+
+// qrcodegen_stream_end() in bounded steps, for spreading the work across frames.
+// Call until it stops returning QR_STEP_BUSY (QRCODE then holds the finished QR Code on QR_STEP_DONE).
+// Each step is one Reed-Solomon block, one mask candidate, etc. Don't start another QR Code in between.
+#define QR_STEP_BUSY  0u
+#define QR_STEP_DONE  1u
+#define QR_STEP_ERROR 2u
+uint8_t qrcodegen_stream_end_step(void) BANKED;
+
+// Optional buffer for caching the function patterns of the last used version (~1.5K for version 31)
+// - qrcodegen_set_template_cache():        without one (or if too small) the patterns get drawn for every QR Code
+// - qrcodegen_invalidate_template_cache(): call before reusing the buffer for something else
+void qrcodegen_set_template_cache(uint8_t * p_cache, uint16_t cache_sz) BANKED;
+void qrcodegen_invalidate_template_cache(void) BANKED;
 bool qr(uint8_t x, uint8_t y);
 
 bool qr_get(uint8_t x, uint8_t y);
@@ -1,5 +1,6 @@
 #include <gbdk/platform.h>
 #include <stdint.h>
+#include <string.h>
 
 #include <gbdk/emu_debug.h>  // Sensitive to duplicated line position across source files
 
@@ -7,72 +8,487 @@
 #include "common.h"
 #include "save_and_undo.h"
 #include "ui_menu_area.h"
+#include "img_2_qrcode.h"
+#include "draw.h"
 
 
 
-// app_state.next_undo_slot -> Always points to an "unused" slot after operations are completed
-//                             One slot past the most recent undo snapshot taken
-//                             Incremented AFTER taking a new snapshot
-//                             Decremented BEFORE restoring a snapshot
+// Undo history (SRAM_BANK_UNDO_SNAPSHOTS_LO and _HI)
 //
-// app_state.undo_count     -> Number of undo snapshots taken
-//                             Value of 1 means 1 snapshot available at (app_state.next_undo_slot - 1)
+// The head: a full copy of the drawing as of the most recent history entry, at the start of the LO bank.
+//           It's also the keyframe all the deltas get applied against, and what printing reads from.
 //
-// app_state.redo_count     -> Number of redo snapshots available
-//                             Value of 1 means 1 snapshot available at (app_state.next_undo_slot - 1)
+// The ring: variable size records filling the rest of both banks. Each holds the XOR of two adjacent
+//           history entries, only for the tiles which differ, and only the non-zero bytes of those.
+//           XOR deltas work in both directions, so the same record steps the head back (undo) and forward (redo).
+//
+//   [lo] oldest ... [head] ... newest [hi]
+//   |-- undo records --| |-- redo records --|
+//
+// The drawing itself matches the head apart from the tiles marked in draw_dirty_rows[DRAW_DIRTY_UNDO],
+// so taking a snapshot only reads those from VRAM. When the ring is full the oldest records are dropped.
+//
+// Record: [uint16_t size][uint8_t tile count] {[tile id: y << 4 | x][uint16_t byte mask][mask bits set: delta bytes]} [uint16_t size]
+//         (the size at both ends is so the ring can be walked either way)
+//
+// app_state.undo_count     -> Number of undo steps available
+//                             When the drawing has changed since the head (undo_head_pending) the first one
+//                             restores the head, the rest each step back through one record
+//
+// app_state.redo_count     -> Number of redo steps available (records after the head)
 //                             Reset to zero when undo snapshot taken
 //                             Incremented when undo snapshot restored / undo_count decremented
 
+#define UNDO_SRAM_BANK_END     (SRAM_BASE_A000 + 0x2000u)
+#define UNDO_HEAD_ADDR         (SRAM_BASE_A000)
+#define UNDO_RING_HEADER_ADDR  (UNDO_HEAD_ADDR + DRAW_SAVE_SLOT_SIZE)  // Ring state, so it can still be browsed after a crash
+#define UNDO_RING_HEADER_SZ    16u
+#define UNDO_RING_LO_START     (UNDO_RING_HEADER_ADDR + UNDO_RING_HEADER_SZ)
+#define UNDO_RING_LO_SZ        (UNDO_SRAM_BANK_END - UNDO_RING_LO_START)
+#define UNDO_RING_HI_START     (SRAM_BASE_A000)
+#define UNDO_RING_SZ           (UNDO_RING_LO_SZ + (UNDO_SRAM_BANK_END - UNDO_RING_HI_START))  // ~14K, a few full drawing changes at least
+
+#define UNDO_RING_MAGIC        0x5544u  // "UD"
+#define UNDO_REC_SIZE_SZ       2u
+#define UNDO_REC_HEADER_SZ     (UNDO_REC_SIZE_SZ + 1u)
+#define UNDO_REC_OVERHEAD      (UNDO_REC_HEADER_SZ + UNDO_REC_SIZE_SZ)
+#define UNDO_TILE_ENTRY_HEADER 3u
+#define UNDO_TILE_ENTRY_MAX    (UNDO_TILE_ENTRY_HEADER + TILE_SZ_BYTES)
+
+typedef struct undo_ring_t {
+    uint16_t magic;
+    uint16_t lo;     // Start of the oldest record
+    uint16_t head;   // End of the record that leads up to the head
+    uint16_t hi;     // End of the newest record
+    uint16_t used;
+    uint16_t records_behind;  // lo -> head
+    uint16_t records_ahead;   // head -> hi
+} undo_ring_t;
+
+static undo_ring_t undo_ring;
+static bool        undo_head_valid   = false;  // Head has been written this session or recovered from SRAM
+static bool        undo_head_pending = true;   // The drawing may differ from the head (a new entry on the next snapshot)
+static bool        undo_lazy_pending = false;  // A lazy snapshot's record is still open, see drawing_undo_lazy_copy()
+
+static uint8_t undo_tile_drawing[TILE_SZ_BYTES];
+static uint8_t undo_tile_head[TILE_SZ_BYTES];
+static uint8_t undo_entry[UNDO_TILE_ENTRY_MAX];
+
 #define CRASH_EXPLORE_REDO_COUNT_RESET     0u
 #define CRASH_EXPLORE_REDO_COUNT_THRESHOLD 20u
 static void crash_explore_redo_reset(void);
 static void crash_explore_redo_update(void);
-static uint8_t crash_explore_redo_counter = CRASH_EXPLORE_REDO_COUNT_RESET;
-static uint8_t crash_explore_undo_slot    = DRAW_UNDO_SLOT_MIN;
+static uint8_t  crash_explore_redo_counter = CRASH_EXPLORE_REDO_COUNT_RESET;
+static uint16_t crash_explore_rec_end;       // Next (older) record to step back through
+static uint16_t crash_explore_records_left;  // Zero: start over from the head
+
+
+// ===== Ring access =====
+// Ring offsets are linear across the end of the LO bank and the HI bank, then wrap around
+
+static uint16_t undo_ring_add(uint16_t offset, uint16_t len) {
+    offset += len;
+    if (offset >= UNDO_RING_SZ) offset -= UNDO_RING_SZ;
+    return offset;
+}
+
+static uint16_t undo_ring_sub(uint16_t offset, uint16_t len) {
+    if (offset < len) offset += UNDO_RING_SZ;
+    return offset - len;
+}
+
+
+// Switches in the SRAM bank for a ring offset, returns its address and how many bytes fit before the bank ends
+static uint8_t * undo_ring_map(uint16_t offset, uint16_t * p_chunk_max) {
+    if (offset < UNDO_RING_LO_SZ) {
+        PLAT_SWITCH_RAM(SRAM_BANK_UNDO_SNAPSHOTS_LO);
+        *p_chunk_max = UNDO_RING_LO_SZ - offset;
+        return (uint8_t *)(UNDO_RING_LO_START + offset);
+    } else {
+        PLAT_SWITCH_RAM(SRAM_BANK_UNDO_SNAPSHOTS_HI);
+        *p_chunk_max = UNDO_RING_SZ - offset;
+        return (uint8_t *)(UNDO_RING_HI_START + (offset - UNDO_RING_LO_SZ));
+    }
+}
+
+
+static uint16_t undo_ring_write(uint16_t offset, const uint8_t * p_src, uint16_t len) {
+    while (len) {
+        uint16_t chunk;
+        uint8_t * p_ring = undo_ring_map(offset, &chunk);
+        if (chunk > len) chunk = len;
+        memcpy(p_ring, p_src, chunk);
+        p_src  += chunk;
+        len    -= chunk;
+        offset = undo_ring_add(offset, chunk);
+    }
+    return offset;
+}
+
+
+static uint16_t undo_ring_read(uint16_t offset, uint8_t * p_dest, uint16_t len) {
+    while (len) {
+        uint16_t chunk;
+        const uint8_t * p_ring = undo_ring_map(offset, &chunk);
+        if (chunk > len) chunk = len;
+        memcpy(p_dest, p_ring, chunk);
+        p_dest += chunk;
+        len    -= chunk;
+        offset = undo_ring_add(offset, chunk);
+    }
+    return offset;
+}
+
+
+static uint16_t undo_ring_read_u16(uint16_t offset) {
+    uint16_t value;
+    undo_ring_read(offset, (uint8_t *)&value, sizeof(value));
+    return value;
+}
+
+
+// Keeps a copy of the ring state in SRAM next to the head
+static void undo_ring_store(void) {
+    PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+    memcpy((uint8_t *)UNDO_RING_HEADER_ADDR, &undo_ring, sizeof(undo_ring));
+}
+
+
+static void undo_ring_reset(void) {
+    undo_ring.magic          = UNDO_RING_MAGIC;
+    undo_ring.lo             = 0u;
+    undo_ring.head           = 0u;
+    undo_ring.hi             = 0u;
+    undo_ring.used           = 0u;
+    undo_ring.records_behind = 0u;
+    undo_ring.records_ahead  = 0u;
+}
+
+
+// Redo records are only valid until the drawing goes a different way
+static void undo_ring_drop_redo(void) {
+    undo_ring.used -= undo_ring_sub(undo_ring.hi, undo_ring.head);
+    undo_ring.hi            = undo_ring.head;
+    undo_ring.records_ahead = 0u;
+}
+
+
+// Drops the oldest records until there is space for a record of up to record_sz bytes
+static void undo_ring_make_room(uint16_t record_sz) {
+    while ((UNDO_RING_SZ - undo_ring.used) < record_sz) {
+        if (undo_ring.records_behind == 0u) {
+            undo_ring_drop_redo();
+            continue;
+        }
+        uint16_t oldest_sz = undo_ring_read_u16(undo_ring.lo);
+        undo_ring.lo    = undo_ring_add(undo_ring.lo, oldest_sz);
+        undo_ring.used -= oldest_sz;
+        undo_ring.records_behind--;
+    }
+}
+
+
+// Dropped records can't be stepped through anymore
+static void undo_counts_clamp(void) {
+    uint16_t undo_max = undo_ring.records_behind + ((undo_head_pending) ? 1u : 0u) + ((undo_lazy_pending) ? 1u : 0u);
+    if (app_state.undo_count > undo_max)                app_state.undo_count = (uint8_t)undo_max;
+    if (app_state.redo_count > undo_ring.records_ahead) app_state.redo_count = (uint8_t)undo_ring.records_ahead;
+}
+
+
+void undo_init(void) BANKED {
+
+    // Recover the ring from a previous session (the redo button crash explore can browse it).
+    // Recording continues after it, the first snapshot is stored as a delta from the old head
+    PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+    memcpy(&undo_ring, (const uint8_t *)UNDO_RING_HEADER_ADDR, sizeof(undo_ring));
+
+    undo_head_valid   = (undo_ring.magic == UNDO_RING_MAGIC) && (undo_ring.used <= UNDO_RING_SZ) &&
+                        (undo_ring.lo < UNDO_RING_SZ) && (undo_ring.head < UNDO_RING_SZ) && (undo_ring.hi < UNDO_RING_SZ);
+    undo_head_pending = true;
+    if (!undo_head_valid) undo_ring_reset();
+    // Whatever redo the previous session had doesn't continue from the current drawing
+    undo_ring_drop_redo();
+}
+
+
+// ===== Tiles =====
+
+static inline uint8_t * undo_tile_vram_addr(uint8_t tile_x, uint8_t tile_y) {
+    return (uint8_t *)DRAWING_VRAM_START + (tile_y * SCREEN_ROW_SZ) + (tile_x * TILE_SZ_BYTES);
+}
+
+// Caller switches in UNDO_HEAD_SRAM_BANK
+static inline uint8_t * undo_tile_head_addr(uint8_t tile_x, uint8_t tile_y) {
+    return (uint8_t *)UNDO_HEAD_ADDR + (tile_y * DRAWING_ROW_OF_TILES_SZ) + (tile_x * TILE_SZ_BYTES);
+}
+
+static void undo_tile_mark_changed(uint8_t tile_x, uint8_t tile_y, bool differs_from_head) {
+    uint16_t tile_bit = (1u << tile_x);
+    draw_dirty_rows[DRAW_DIRTY_CAPTURE][tile_y] |= tile_bit;
+    if (differs_from_head) draw_dirty_rows[DRAW_DIRTY_UNDO][tile_y] |= tile_bit;
+}
+
+
+// Packs the non-zero bytes of the delta between the drawing and head tile buffers into undo_entry,
+// returns the entry size (zero if the tiles match)
+static uint8_t undo_tile_delta_pack(uint8_t tile_x, uint8_t tile_y) {
+
+    uint16_t mask = 0u;
+    uint8_t * p_entry = undo_entry + UNDO_TILE_ENTRY_HEADER;
+
+    for (uint8_t c = 0u; c < TILE_SZ_BYTES; c++) {
+        uint8_t delta = undo_tile_drawing[c] ^ undo_tile_head[c];
+        if (delta) {
+            *p_entry++ = delta;
+            mask |= (1u << c);
+        }
+    }
+    if (mask == 0u) return 0u;
+
+    undo_entry[0] = (tile_y << 4) | tile_x;
+    undo_entry[1] = (uint8_t)mask;
+    undo_entry[2] = (uint8_t)(mask >> 8);
+    return (uint8_t)(p_entry - undo_entry);
+}
+
+
+// Reads the next tile entry of a record, expanding its delta into undo_tile_drawing. Returns the offset after it
+static uint16_t undo_tile_delta_unpack(uint16_t offset) {
+
+    offset = undo_ring_read(offset, undo_entry, UNDO_TILE_ENTRY_HEADER);
+    uint16_t mask = undo_entry[1] | (undo_entry[2] << 8);
+
+    uint8_t count = 0u;
+    for (uint16_t bits = mask; bits; bits >>= 1) count += (bits & 0x01u);
+    offset = undo_ring_read(offset, undo_entry + UNDO_TILE_ENTRY_HEADER, count);
+
+    const uint8_t * p_entry = undo_entry + UNDO_TILE_ENTRY_HEADER;
+    for (uint8_t c = 0u; c < TILE_SZ_BYTES; c++, mask >>= 1)
+        undo_tile_drawing[c] = (mask & 0x01u) ? *p_entry++ : 0u;
+
+    return offset;
+}
+
+
+// ===== Head <-> drawing =====
+
+// Record being written (at the end of the ring, right after the head)
+static uint16_t undo_rec_start;
+static uint16_t undo_rec_pos;
+static uint8_t  undo_rec_tile_count;
+
+// Starts a record after the head with room for (up to) the tiles marked in p_tile_rows
+static void undo_record_begin(const uint16_t * p_tile_rows) {
+
+    // The new record always follows on from the head
+    undo_ring_drop_redo();
+
+    // Worst case size for the tiles
+    uint16_t record_max = UNDO_REC_OVERHEAD;
+    for (uint8_t tile_y = 0u; tile_y < IMG_HEIGHT_TILES; tile_y++)
+        for (uint16_t tiles = p_tile_rows[tile_y]; tiles; tiles >>= 1)
+            if (tiles & 0x01u) record_max += UNDO_TILE_ENTRY_MAX;
+    undo_ring_make_room(record_max);
+
+    undo_rec_start      = undo_ring.hi;
+    undo_rec_pos        = undo_ring_add(undo_rec_start, UNDO_REC_HEADER_SZ);
+    undo_rec_tile_count = 0u;
+}
+
+
+static void undo_record_end(bool drawing_to_head) {
+
+    uint16_t rec_sz = undo_ring_sub(undo_rec_pos, undo_rec_start) + UNDO_REC_SIZE_SZ;
+    undo_ring_write(undo_ring_write(undo_rec_start, (const uint8_t *)&rec_sz, UNDO_REC_SIZE_SZ), &undo_rec_tile_count, 1u);
+    undo_ring.hi    = undo_ring_write(undo_rec_pos, (const uint8_t *)&rec_sz, UNDO_REC_SIZE_SZ);
+    undo_ring.used += rec_sz;
+
+    if (drawing_to_head) {
+        undo_ring.head = undo_ring.hi;
+        undo_ring.records_behind++;
+    } else undo_ring.records_ahead++;
+}
+
+
+#define UNDO_SYNC_DRAWING_TO_HEAD  0u  // Snapshot: record the change, then the head catches up with the drawing
+#define UNDO_SYNC_HEAD_TO_DRAWING  1u  // Undo with redo: record the change (as redo), then the drawing goes back to the head
+#define UNDO_SYNC_HEAD_RESTORE     2u  // Undo without redo: the drawing goes back to the head
+#define UNDO_SYNC_DRAWING_RECORD   3u  // Lazy snapshot: record the change only, the head catches up at commit
+
+// Brings one tile of the drawing and the head back in line, adding the difference to the record unless only restoring
+static void undo_tile_sync(uint8_t tile_x, uint8_t tile_y, uint8_t mode) {
+
+    uint8_t * p_vram = undo_tile_vram_addr(tile_x, tile_y);
+    vmemcpy(undo_tile_drawing, p_vram, TILE_SZ_BYTES);
+    PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+    memcpy(undo_tile_head, undo_tile_head_addr(tile_x, tile_y), TILE_SZ_BYTES);
+
+    uint8_t entry_sz = undo_tile_delta_pack(tile_x, tile_y);
+    if (entry_sz == 0u) return;
+
+    if (mode == UNDO_SYNC_DRAWING_TO_HEAD) {
+        memcpy(undo_tile_head_addr(tile_x, tile_y), undo_tile_drawing, TILE_SZ_BYTES);
+    } else if (mode != UNDO_SYNC_DRAWING_RECORD) {
+        vmemcpy(p_vram, undo_tile_head, TILE_SZ_BYTES);
+        undo_tile_mark_changed(tile_x, tile_y, false);
+    }
+
+    if (mode != UNDO_SYNC_HEAD_RESTORE) {
+        undo_rec_pos = undo_ring_write(undo_rec_pos, undo_entry, entry_sz);
+        undo_rec_tile_count++;
+    }
+}
 
 
-static inline uint8_t get_next_undo_slot(void);
-static inline uint8_t get_previous_undo_slot(void);
+static void undo_tile_rows_sync(uint16_t * p_tile_rows, uint8_t mode) {
 
-#define CALC_SRAM_BANK_AND_SLOT(slotnum, bankvar, slotvar) \
-    bankvar = SRAM_BANK_UNDO_SNAPSHOTS_LO; \
-    slotvar = (slotnum); \
-    if ((slotnum) >= DRAW_UNDO_SLOTS_PER_SRAM_BANK) { \
-        bankvar = SRAM_BANK_UNDO_SNAPSHOTS_HI; \
-        slotvar -= DRAW_UNDO_SLOTS_PER_SRAM_BANK; \
+    for (uint8_t tile_y = 0u; tile_y < IMG_HEIGHT_TILES; tile_y++) {
+        uint16_t tiles = p_tile_rows[tile_y];
+        for (uint8_t tile_x = 0u; tiles; tile_x++, tiles >>= 1) {
+            if (tiles & 0x01u) undo_tile_sync(tile_x, tile_y, mode);
+        }
+        p_tile_rows[tile_y] = 0u;
     }
+}
+
+
+// Only the tiles changed since the drawing last matched the head get looked at
+static void undo_head_sync(uint8_t mode) {
+
+    if (mode != UNDO_SYNC_HEAD_RESTORE) undo_record_begin(draw_dirty_rows[DRAW_DIRTY_UNDO]);
+    undo_tile_rows_sync(draw_dirty_rows[DRAW_DIRTY_UNDO], mode);
+    if (mode != UNDO_SYNC_HEAD_RESTORE) undo_record_end(mode == UNDO_SYNC_DRAWING_TO_HEAD);
+}
+
+
+// ===== Lazy (copy on write) snapshots =====
+//
+// Pencil, Eraser and Spray snapshot when the button goes down and start drawing right away.
+// Instead of recording all of the previous change then, a lazy snapshot opens the record and
+// moves the tiles to record into undo_lazy_rows. A tile gets recorded right before the stroke
+// first draws over it (drawing_undo_lazy_copy(), via drawing_dirty_mark() in draw.c), and
+// whatever is left when the stroke ends (or anything else touches the undo history).
+//
+// Until then the head in SRAM stays as it was, with the ring header still ending at the last
+// closed record. That way a crash mid-stroke leaves a consistent history for the crash explore,
+// the open record past the end of the ring just gets written over.
+uint16_t undo_lazy_rows[IMG_HEIGHT_TILES];
+
+void drawing_undo_lazy_copy(uint8_t tile_y, uint16_t tile_mask) BANKED {
 
+    uint16_t tiles = undo_lazy_rows[tile_y] & tile_mask;
+    undo_lazy_rows[tile_y] &= ~tiles;
 
-// Retrieve the memory address containing the last taken undo snapshot
+    for (uint8_t tile_x = 0u; tiles; tile_x++, tiles >>= 1) {
+        if (tiles & 0x01u) undo_tile_sync(tile_x, tile_y, UNDO_SYNC_DRAWING_RECORD);
+    }
+}
+
+
+// Applies the tiles recorded so far in the open record to the head
+static void undo_lazy_head_apply(void) {
+
+    uint16_t offset = undo_ring_add(undo_rec_start, UNDO_REC_HEADER_SZ);
+
+    for (uint8_t n = undo_rec_tile_count; n; n--) {
+        offset = undo_tile_delta_unpack(offset);
+        PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+        uint8_t * p_head = undo_tile_head_addr(undo_entry[0] & 0x0Fu, undo_entry[0] >> 4);
+        for (uint8_t c = 0u; c < TILE_SZ_BYTES; c++) p_head[c] ^= undo_tile_drawing[c];
+    }
+}
+
+
+void drawing_undo_lazy_commit(void) BANKED {
+
+    if (!undo_lazy_pending) return;
+
+    undo_lazy_head_apply();
+    undo_tile_rows_sync(undo_lazy_rows, UNDO_SYNC_DRAWING_TO_HEAD);
+    undo_record_end(true);
+    undo_lazy_pending = false;
+    undo_ring_store();
+}
+
+
+// Applies the record starting at rec_start. Into the head and then the drawing (undo/redo step),
+// or only into the drawing (crash explore)
+static void undo_record_apply(uint16_t rec_start, bool to_head) {
+
+    uint8_t tile_count;
+    uint16_t offset = undo_ring_read(undo_ring_add(rec_start, UNDO_REC_SIZE_SZ), &tile_count, 1u);
+
+    while (tile_count--) {
+        offset = undo_tile_delta_unpack(offset);
+        uint8_t tile_x = undo_entry[0] & 0x0Fu;
+        uint8_t tile_y = undo_entry[0] >> 4;
+        uint8_t * p_vram = undo_tile_vram_addr(tile_x, tile_y);
+
+        if (to_head) {
+            PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+            uint8_t * p_head = undo_tile_head_addr(tile_x, tile_y);
+            for (uint8_t c = 0u; c < TILE_SZ_BYTES; c++) undo_tile_head[c] = (p_head[c] ^= undo_tile_drawing[c]);
+        } else {
+            vmemcpy(undo_tile_head, p_vram, TILE_SZ_BYTES);
+            for (uint8_t c = 0u; c < TILE_SZ_BYTES; c++) undo_tile_head[c] ^= undo_tile_drawing[c];
+        }
+        vmemcpy(p_vram, undo_tile_head, TILE_SZ_BYTES);
+        undo_tile_mark_changed(tile_x, tile_y, !to_head);
+    }
+}
+
+
+// Retrieve the memory address containing the last taken undo snapshot (the head, all tiles in order)
 // Also switches in relevant SRAM bank
 uint8_t * undo_get_last_snapshot_addr(void) BANKED {
 
-    uint8_t sram_bank, sram_slot;
-    CALC_SRAM_BANK_AND_SLOT(get_previous_undo_slot(), sram_bank, sram_slot);
-    PLAT_SWITCH_RAM(sram_bank);
-
-    return (uint8_t *)(SRAM_BASE_A000 + (DRAW_SAVE_SLOT_SIZE * sram_slot));
+    drawing_undo_lazy_commit();
+    PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+    return (uint8_t *)UNDO_HEAD_ADDR;
 }
 
 
+// ===== Drawing save slots =====
+
+static uint8_t save_row_buf[DRAWING_ROW_OF_TILES_SZ];  // For copying a row of tiles between SRAM banks
+
 void drawing_save_to_sram(uint8_t sram_bank, uint8_t save_slot) BANKED {
 
-    PLAT_SWITCH_RAM(sram_bank);
     // VRAM/SRAM copy takes long enough with display off that it's distracting
     // (at least on emulators in DMG mode)
     //
-    // TODO: OPTIMIZE: Pencil and Eraser have a few frames of lag since they snapshot when tool starts
-    // drawing (others only do so on draw commit). Could snapshot while idle and then only commit the
-    // snapshot once the tool starts drawing, but that wastes a slot. The lag doesn't seem to noticeable
-    // right now when DMG-drawing.
+    // Only tiles changed since the undo head get read from VRAM (which is slow,
+    // it has to wait for access), the rest are copied from the head.
+    drawing_undo_lazy_commit();
 
     // DISPLAY_OFF;
     uint8_t * p_sram_save_slot = (uint8_t *)(SRAM_BASE_A000 + (DRAW_SAVE_SLOT_SIZE * save_slot));
     uint8_t * p_vram_drawing   = (uint8_t *)(DRAWING_VRAM_START);
+    const uint8_t * p_sram_head = (const uint8_t *)UNDO_HEAD_ADDR;
 
     for (uint8_t tile_row = 0u; tile_row < IMG_HEIGHT_TILES; tile_row++) {
-        vmemcpy(p_sram_save_slot, p_vram_drawing, DRAWING_ROW_OF_TILES_SZ); // Copy all tile patterns
+
+        uint16_t dirty = (undo_head_valid) ? draw_dirty_rows[DRAW_DIRTY_UNDO][tile_row] : DRAW_DIRTY_ROW_ALL;
+
+        if (dirty == DRAW_DIRTY_ROW_ALL) {
+            PLAT_SWITCH_RAM(sram_bank);
+            vmemcpy(p_sram_save_slot, p_vram_drawing, DRAWING_ROW_OF_TILES_SZ); // Copy all tile patterns
+        } else {
+            // Unchanged tiles from the head
+            PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+            memcpy(save_row_buf, p_sram_head, DRAWING_ROW_OF_TILES_SZ);
+            PLAT_SWITCH_RAM(sram_bank);
+            memcpy(p_sram_save_slot, save_row_buf, DRAWING_ROW_OF_TILES_SZ);
+
+            // Then the changed ones
+            for (uint8_t tile_x = 0u; dirty; tile_x++, dirty >>= 1) {
+                if (dirty & 0x01u)
+                    vmemcpy(p_sram_save_slot + (tile_x * TILE_SZ_BYTES), p_vram_drawing + (tile_x * TILE_SZ_BYTES), TILE_SZ_BYTES);
+            }
+        }
         p_sram_save_slot += DRAWING_ROW_OF_TILES_SZ;
+        p_sram_head      += DRAWING_ROW_OF_TILES_SZ;
         p_vram_drawing   += SCREEN_ROW_SZ;
     }
     // DISPLAY_ON;
@@ -80,6 +496,9 @@ void drawing_save_to_sram(uint8_t sram_bank, uint8_t save_slot) BANKED {
 
 void drawing_restore_from_sram(uint8_t sram_bank, uint8_t save_slot) BANKED {
 
+    qrcode_pregen_invalidate();
+    drawing_undo_lazy_commit();
+
     PLAT_SWITCH_RAM(sram_bank);
     // DISPLAY_OFF;
     uint8_t * p_sram_save_slot = (uint8_t *)(SRAM_BASE_A000 + (DRAW_SAVE_SLOT_SIZE * save_slot));
@@ -91,141 +510,164 @@ void drawing_restore_from_sram(uint8_t sram_bank, uint8_t save_slot) BANKED {
         p_vram_drawing   += SCREEN_ROW_SZ;
     }
     // DISPLAY_ON;
-}
-
 
-static inline uint8_t get_next_undo_slot(void) {
-    // Increment slot used, wrap around if needed    
-    if (app_state.next_undo_slot == DRAW_UNDO_SLOT_MAX)
-        return DRAW_UNDO_SLOT_MIN;
-    else
-        return app_state.next_undo_slot + 1u;
+    // Whole drawing replaced
+    drawing_dirty_mark_all();
+    undo_head_pending = true;
 }
 
 
-static inline uint8_t get_previous_undo_slot(void) {
-    // Decrement slot used, wrap around if needed    
-    if (app_state.next_undo_slot == DRAW_UNDO_SLOT_MIN)
-        return DRAW_UNDO_SLOT_MAX;
-    else
-        return app_state.next_undo_slot - 1u;
-}
+// ===== Undo / Redo =====
 
-
-// Undo snapshots are a ring buffer stored in SRAM
-void drawing_take_undo_snapshot(void) BANKED {
+static void undo_take_snapshot(bool lazy) {
 
     // Whenever an Undo state is made, reset the hidden ui access to browsing raw undo states
     crash_explore_redo_reset();
+    drawing_undo_lazy_commit();
 
-    // EMU_printf("Undo: Taking (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
-    uint8_t sram_bank, sram_slot;
+    // Snapshots are taken right before the drawing changes
+    qrcode_pregen_invalidate();
+
+    // EMU_printf("Undo: Taking (count=%hu, redo_sz=%hu, ring used=%u)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count, (uint16_t)undo_ring.used);
 
     // Hide redo button if showing
     // Taking an undo snapshot clears out any existing redo queue
     app_state.redo_count = DRAW_REDO_COUNT_NONE;
+    undo_ring_drop_redo();
     ui_redo_button_refresh();
 
-    // Always take the undo snapshot, discard (overwrite) the oldest if needed.
-    // Meaning increment count up to, but not past, the max number of slots
-    if (app_state.undo_count < DRAW_UNDO_SLOT_COUNT_USABLE) {
-        app_state.undo_count++;
+    if (!undo_head_valid) {
+        // Nothing to make a delta against yet, so the head starts as a full copy
+        undo_ring_reset();
+        uint8_t * p_vram_drawing = (uint8_t *)(DRAWING_VRAM_START);
+        uint8_t * p_sram_head    = (uint8_t *)UNDO_HEAD_ADDR;
+        PLAT_SWITCH_RAM(UNDO_HEAD_SRAM_BANK);
+        for (uint8_t tile_row = 0u; tile_row < IMG_HEIGHT_TILES; tile_row++) {
+            vmemcpy(p_sram_head, p_vram_drawing, DRAWING_ROW_OF_TILES_SZ);
+            p_sram_head    += DRAWING_ROW_OF_TILES_SZ;
+            p_vram_drawing += SCREEN_ROW_SZ;
+        }
+        drawing_dirty_clear(DRAW_DIRTY_UNDO);
+        undo_head_valid = true;
     }
+    // The drawing becomes the new head, with the change from the old one recorded.
+    // Right after an undo/redo the drawing already is the head, so nothing to record
+    else if (undo_head_pending) {
+        if (lazy) {
+            // Recorded as the new stroke gets to the tiles, see drawing_undo_lazy_copy()
+            undo_record_begin(draw_dirty_rows[DRAW_DIRTY_UNDO]);
+            memcpy(undo_lazy_rows, draw_dirty_rows[DRAW_DIRTY_UNDO], sizeof(undo_lazy_rows));
+            drawing_dirty_clear(DRAW_DIRTY_UNDO);
+            undo_lazy_pending = true;
+        } else undo_head_sync(UNDO_SYNC_DRAWING_TO_HEAD);
+    }
+    undo_head_pending = true;
 
-    // Adjust SRAM access if undo slots are in the second SRAM bank (i.e. later half of undo states)
-    CALC_SRAM_BANK_AND_SLOT(app_state.next_undo_slot, sram_bank, sram_slot);
-    drawing_save_to_sram(sram_bank, sram_slot);
-
-    // Increment slot used AFTER taking it
-    app_state.next_undo_slot = get_next_undo_slot();
+    // Always take the undo snapshot, discard the oldest if needed.
+    // Meaning increment count up to, but not past, the max
+    if (app_state.undo_count < DRAW_UNDO_COUNT_MAX) {
+        app_state.undo_count++;
+    }
+    undo_counts_clamp();
+    undo_ring_store();
 
-    // EMU_printf("  - Undo: Done (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
+    // EMU_printf("  - Undo: Done (count=%hu, redo_sz=%hu, ring used=%u)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count, (uint16_t)undo_ring.used);
 
     // Make sure undo button is enabled
     ui_undo_button_refresh();
 }
 
 
-// take_redo_snapshot is (currently) only false when called for QR code generating
-// If sram size is increased the qrcode snapshotting could be split off from the undo stack and remove the need for this
+void drawing_take_undo_snapshot(void) BANKED {
+    undo_take_snapshot(false);
+}
+
+
+// For tools that draw as soon as the button goes down, see drawing_undo_lazy_copy()
+void drawing_take_undo_snapshot_lazy(void) BANKED {
+    undo_take_snapshot(true);
+}
+
+
+// take_redo_snapshot is (currently) only false when called for QR code generating, right after taking a snapshot
 void drawing_restore_undo_snapshot(bool take_redo_snapshot) BANKED {
 
     crash_explore_redo_reset();
+    drawing_undo_lazy_commit();
 
-    // EMU_printf("Undo: Restore requested (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
-    uint8_t sram_bank, sram_slot;
+    // EMU_printf("Undo: Restore requested (count=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count);
 
     // Make sure there is an undo to restore from
     if (app_state.undo_count > DRAW_UNDO_COUNT_NONE) {
 
-        if (take_redo_snapshot) {
-            // If redo count is zero it means this is the head of the undo queue
-            // and a redo snapshot should be taken of the pre-undo state (added to
-            // the end of the queue)
-            // It may overwrite the Oldest undo entry if the queue is maximally full
-            if (app_state.redo_count == DRAW_REDO_COUNT_NONE) {
-                // Current slot points to an "empty" slot one past the last undo snapshot
-                // so take the snapshot of the current d+rawing there before it gets
-                // rewound during the undo restore
-                CALC_SRAM_BANK_AND_SLOT(app_state.next_undo_slot, sram_bank, sram_slot);
-                drawing_save_to_sram(sram_bank, sram_slot);
+        qrcode_pregen_invalidate();
+
+        if (undo_head_pending) {
+            // The drawing goes back to the head. If it's the start of the redo queue
+            // the change gets recorded first (added after the head) so it can be redone
+            undo_head_sync((take_redo_snapshot) ? UNDO_SYNC_HEAD_TO_DRAWING : UNDO_SYNC_HEAD_RESTORE);
+            undo_head_pending = false;
+        } else if (undo_ring.records_behind) {
+            // Step the head (and the drawing with it) back through the record that led up to it
+            uint16_t rec_sz = undo_ring_read_u16(undo_ring_sub(undo_ring.head, UNDO_REC_SIZE_SZ));
+            undo_ring.head = undo_ring_sub(undo_ring.head, rec_sz);
+            undo_record_apply(undo_ring.head, true);
+            undo_ring.records_behind--;
+            undo_ring.records_ahead++;
+        }
 
-            }
-            // Should not need a limiter on redo_count, the undo count limiter
-            // should effectively cap it at DRAW_UNDO_SLOT_COUNT_USABLE
+        if (take_redo_snapshot) {
             // Make sure redo button is enabled
             app_state.redo_count++;
             ui_redo_button_refresh();
         }
 
-        // Decrement to previous slot BEFORE restoring it
-        app_state.next_undo_slot = get_previous_undo_slot();
-
-        // Adjust SRAM access if undo slots are in the second SRAM bank (i.e. later half of undo states)
-        CALC_SRAM_BANK_AND_SLOT(app_state.next_undo_slot, sram_bank, sram_slot);
-        drawing_restore_from_sram(sram_bank, sram_slot);
-
         // Reduce size of undo queue
         // Remove undo button if zero snapshots
         app_state.undo_count--;
+        undo_counts_clamp();
+        undo_ring_store();
         ui_undo_button_refresh();
 
-        // EMU_printf("  - Undo: Restore completed (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
+        // EMU_printf("  - Undo: Restore completed (count=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count);
     } else {
-        // EMU_printf("  - Undo: None Found (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
+        // EMU_printf("  - Undo: None Found (count=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count);
     }
 }
 
 
 void drawing_restore_redo_snapshot(void) BANKED {
 
-    // EMU_printf("Undo: REDO Restore requested (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
-    uint8_t sram_bank, sram_slot;
+    drawing_undo_lazy_commit();
+
+    // EMU_printf("Undo: REDO Restore requested (count=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count);
 
     // Make sure there is an redo to restore from
     if (app_state.redo_count > DRAW_REDO_COUNT_NONE) {
 
-        // Current redo slot is always the *next* slot after current next undo slot
-        CALC_SRAM_BANK_AND_SLOT( get_next_undo_slot(), sram_bank, sram_slot);
-        drawing_restore_from_sram(sram_bank, sram_slot);
+        qrcode_pregen_invalidate();
+
+        // Step the head (and the drawing with it) forward through the next record
+        undo_record_apply(undo_ring.head, true);
+        undo_ring.head = undo_ring_add(undo_ring.head, undo_ring_read_u16(undo_ring.head));
+        undo_ring.records_behind++;
+        undo_ring.records_ahead--;
+        undo_ring_store();
 
         // Hide redo button if going to zero snapshots
-        // Taking an undo snapshot clears out any existing redo queue
         app_state.redo_count--;
         ui_redo_button_refresh();
-        // Increment the undo count, basically transferring the snapshot
+        // Increment the undo count, basically transferring the record
         // from the redo side of the queue into the undo side
         app_state.undo_count++;
         ui_undo_button_refresh();
 
-        app_state.next_undo_slot = get_next_undo_slot();
-
         crash_explore_redo_reset();
-        // EMU_printf("  - Undo: REDO Restore completed (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
+        // EMU_printf("  - Undo: REDO Restore completed (count=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count);
     } else {
         // Hidden UI option to browse/restore ALL undo states saved in SRAM regardless of undo stack state
         crash_explore_redo_update();
-        // EMU_printf("  - Undo: REDO None Found (count=%hu, slot=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.next_undo_slot, (uint8_t)app_state.redo_count);
+        // EMU_printf("  - Undo: REDO None Found (count=%hu, redo_sz=%hu)\n", (uint8_t)app_state.undo_count, (uint8_t)app_state.redo_count);
     }
 }
 
@@ -236,28 +678,40 @@ void drawing_restore_redo_snapshot(void) BANKED {
 // - Restore (successful) redo snapshot
 static void crash_explore_redo_reset(void) {
     crash_explore_redo_counter = CRASH_EXPLORE_REDO_COUNT_RESET;
+    crash_explore_records_left = 0u;
 }
 
 
 // Called/updated when the user clicks the NOT-ENABLED Restore redo snapshot button.
 // N clicks in a row with NO OTHER undo actions will allow it to
-// start loading/browsing the raw undo stack in SRAM.
+// start loading/browsing the raw undo history in SRAM: the head, then
+// one step further back per click through every record still in the ring
 static void crash_explore_redo_update(void) {
 
-    //EMU_printf("  CRASH EXPLORE REDO HANDLER (count=%hu, slot=%hu)\n", (uint8_t)crash_explore_redo_counter, (uint8_t)crash_explore_undo_slot);
+    //EMU_printf("  CRASH EXPLORE REDO HANDLER (count=%hu, left=%u)\n", (uint8_t)crash_explore_redo_counter, (uint16_t)crash_explore_records_left);
     if (crash_explore_redo_counter > CRASH_EXPLORE_REDO_COUNT_THRESHOLD) {
         // EMU_printf("RESTORING\n");
-        // Load a undo slot then increment to the next (wrapping if at end)
-        uint8_t sram_bank, sram_slot;
-        CALC_SRAM_BANK_AND_SLOT(crash_explore_undo_slot, sram_bank, sram_slot);
-        drawing_restore_from_sram(sram_bank, sram_slot);
-
-        crash_explore_undo_slot++;
-        if (crash_explore_undo_slot > DRAW_UNDO_SLOT_MAX)
-            crash_explore_undo_slot = DRAW_UNDO_SLOT_MIN;
+        if (!undo_head_valid) return;
+
+        if (crash_explore_records_left == 0u) {
+            // Start (over) from the head
+            drawing_restore_from_sram(UNDO_HEAD_SRAM_BANK, 0u);
+            crash_explore_rec_end      = undo_ring.head;
+            crash_explore_records_left = undo_ring.records_behind;
+        } else {
+            qrcode_pregen_invalidate();
+            crash_explore_rec_end = undo_ring_sub(crash_explore_rec_end, undo_ring_read_u16(undo_ring_sub(crash_explore_rec_end, UNDO_REC_SIZE_SZ)));
+            undo_record_apply(crash_explore_rec_end, false);
+            crash_explore_records_left--;
+        }
+
+        // The drawing no longer follows the undo history, it gets recorded as a new entry on the next snapshot
+        undo_head_pending = true;
+        undo_ring_drop_redo();
+        undo_counts_clamp();
+        undo_ring_store();
     }
     else {
-        // if ((app_state.redo_count == 0) && (app_state.redo_count == 0))
         crash_explore_redo_counter++;
     }
-}
\ No newline at end of file
+}
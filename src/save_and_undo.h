@@ -1,6 +1,8 @@
 #ifndef SAVE_AND_UNDO_H
 #define SAVE_AND_UNDO_H
 
+#include "common.h"
+
 // ~ 2304 bytes per save
 
 #define DRAWING_ROW_OF_TILES_SZ   (IMG_WIDTH_TILES * TILE_SZ_BYTES)
@@ -8,12 +10,22 @@
 #define DRAW_SAVE_SLOT_SIZE    (IMG_WIDTH_TILES * IMG_HEIGHT_TILES * TILE_SZ_BYTES)
 #define DRAWING_VRAM_START        (APA_MODE_VRAM_START + (((IMG_TILE_Y_START * DEVICE_SCREEN_WIDTH) + IMG_TILE_X_START) * TILE_SZ_BYTES))
 
+// SRAM bank of the undo head, the drawing as of the last snapshot (switched in by undo_get_last_snapshot_addr())
+#define UNDO_HEAD_SRAM_BANK       (SRAM_BANK_UNDO_SNAPSHOTS_LO)
+
+void undo_init(void) BANKED;
 uint8_t * undo_get_last_snapshot_addr(void) BANKED;
 
 void drawing_save_to_sram(uint8_t sram_bank, uint8_t save_slot) BANKED;
 void drawing_restore_from_sram(uint8_t sram_bank, uint8_t save_slot) BANKED;
 
 void drawing_take_undo_snapshot(void) BANKED;
+void drawing_take_undo_snapshot_lazy(void) BANKED;
+
+// Tiles the pending lazy snapshot still has to record before they get drawn over
+extern uint16_t undo_lazy_rows[IMG_HEIGHT_TILES];
+void drawing_undo_lazy_copy(uint8_t tile_y, uint16_t tile_mask) BANKED;
+void drawing_undo_lazy_commit(void) BANKED;
 void drawing_restore_undo_snapshot(bool take_redo_snapshot) BANKED;
 void drawing_restore_redo_snapshot(void) BANKED;
 
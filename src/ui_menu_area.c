@@ -55,6 +55,9 @@ void ui_redraw_menus_all(void) NONBANKED {
         PLAT_SWITCH_ROM(save_bank);
     }
 
+    // The background image covers the drawing area too
+    drawing_dirty_mark_all();
+
     // Redraw various menus and their state
     ui_menu_tools_draw_highlight(app_state.drawing_tool, TOOLS_MENU_HIGHLIGHT_COLOR);
     ui_menu_file_draw_highlight(app_state.save_slot_current, FILE_MENU_HIGHLIGHT_COLOR);
@@ -0,0 +1,874 @@
+// Host (Linux) benchmark for the drawing export pipeline:
+//   96x96 1bpp drawing -> PNG -> Base64 url -> QR Code
+//
+// Build and run with: make host-bench
+//
+// Usage: host_bench [-n iterations] [-s] [-f filter_mode] [-a url_prefix] [-m version] [drawing.bin ...]
+// - -s encodes the PNG without compression (Stored block), where the CRC-32 runs over the whole image
+// - -f sets the PNG row filter mode (PNG_FILTER_MODE_*: 0 = none, 1 = per row heuristic, 2 = heuristic reused for 8 rows)
+// - -a uses the Base32 url format with the given prefix instead of the Base64 data url (see QR_URL_FORMAT in base32.h)
+// - -m splits the url across QR Codes of at most the given version (structured append, like SELECT + START)
+// - Each optional drawing.bin is a raw 96x96 1bpp image (12 bytes per row, MSB = leftmost pixel, 1 = black)
+//   and gets added to the built-in corpus of generated drawings
+//
+// Times are wall clock averages per call of each stage, so they are only useful
+// for comparing changes on the same machine, not for estimating Game Boy cycles.
+//
+// Each output is also checked against reference implementations written from the specs
+// (see "Output checks" below), the "check" column and the exit code show if any failed.
+
+#include <gbdk/platform.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "common.h"
+#include "png_indexed.h"
+#include "png_palettes.h"
+#include "base64.h"
+#include "base32.h"
+#include "qrcodegen.h"
+
+
+// IMG_WIDTH_PX and IMG_HEIGHT_PX (96x96) come from common.h
+#define IMG_ROW_SZ_BYTES   (IMG_WIDTH_PX / 8u)
+#define IMG_SZ_BYTES       (IMG_ROW_SZ_BYTES * IMG_HEIGHT_PX)
+
+#define CORPUS_MAX         32u
+#define NAME_MAX_LEN       24u
+#define ITERATIONS_DEFAULT 20u
+
+#define PNG_BUF_SZ         8192u
+#define B64_BUF_SZ         (B64_CALC_OUT_SZ(PNG_BUF_SZ) + 64u)
+#define QR_TEMPLATE_BUF_SZ 4096u  // Same as the SRAM the Game Boy build uses
+
+
+typedef struct corpus_entry_t {
+    char    name[NAME_MAX_LEN];
+    uint8_t pixels[IMG_SZ_BYTES];
+} corpus_entry_t;
+
+typedef struct stage_result_t {
+    uint64_t png_ns;
+    uint64_t b64_ns;
+    uint64_t qr_ns;
+    uint16_t png_sz;
+    uint16_t b64_sz;
+    uint8_t  qr_version;  // 0 if the url didn't fit, largest one for several QR Codes
+    uint8_t  qr_count;
+    bool     check_ok;    // PNG and QR Code(s) passed the reference checks
+} stage_result_t;
+
+
+static corpus_entry_t corpus[CORPUS_MAX];
+static uint8_t corpus_count;
+
+static uint8_t png_buf[PNG_BUF_SZ];
+static uint8_t b64_buf[B64_BUF_SZ];
+static uint8_t qr_template_buf[QR_TEMPLATE_BUF_SZ];
+
+static uint8_t png_compression = PNG_COMPRESSION_FIXED_HUFFMAN;
+static uint8_t png_filter_mode = PNG_FILTER_MODE_NONE;
+static const char * p_url_base32_prefix = NULL;  // NULL for the Base64 data url
+static uint8_t qr_split_version = 0u;            // 0 for a single QR Code
+
+static const char * const crc_engine_names[] = { "TABLE32", "BYTE_PLANES", "NIBBLE" };
+
+
+// Small deterministic PRNG so the generated corpus is the same on every run
+static uint32_t rng_state;
+
+static uint32_t rng_next(void) {
+    rng_state = (rng_state * 1103515245u) + 12345u;
+    return (rng_state >> 16) & 0x7FFFu;
+}
+
+
+static void plot(uint8_t * p_img, int x, int y) {
+    if ((x < 0) || (y < 0) || (x >= (int)IMG_WIDTH_PX) || (y >= (int)IMG_HEIGHT_PX)) return;
+    p_img[(y * IMG_ROW_SZ_BYTES) + (x >> 3)] |= (uint8_t)(0x80u >> (x & 0x07));
+}
+
+
+static void draw_line(uint8_t * p_img, int x0, int y0, int x1, int y1) {
+    int dx = abs(x1 - x0), sx = (x0 < x1) ? 1 : -1;
+    int dy = -abs(y1 - y0), sy = (y0 < y1) ? 1 : -1;
+    int err = dx + dy;
+    while (true) {
+        plot(p_img, x0, y0);
+        if ((x0 == x1) && (y0 == y1)) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x0 += sx; }
+        if (e2 <= dx) { err += dx; y0 += sy; }
+    }
+}
+
+
+static void draw_circle(uint8_t * p_img, int cx, int cy, int r) {
+    int x = r, y = 0, err = 1 - r;
+    while (x >= y) {
+        plot(p_img, cx + x, cy + y); plot(p_img, cx + y, cy + x);
+        plot(p_img, cx - y, cy + x); plot(p_img, cx - x, cy + y);
+        plot(p_img, cx - x, cy - y); plot(p_img, cx - y, cy - x);
+        plot(p_img, cx + y, cy - x); plot(p_img, cx + x, cy - y);
+        y++;
+        if (err < 0) err += (2 * y) + 1;
+        else { x--; err += 2 * (y - x) + 1; }
+    }
+}
+
+
+static uint8_t * corpus_add(const char * name) {
+    if (corpus_count >= CORPUS_MAX) {
+        fprintf(stderr, "Corpus full, skipping %s\n", name);
+        return NULL;
+    }
+    corpus_entry_t * p_entry = &corpus[corpus_count++];
+    snprintf(p_entry->name, sizeof(p_entry->name), "%s", name);
+    memset(p_entry->pixels, 0u, sizeof(p_entry->pixels));
+    return p_entry->pixels;
+}
+
+
+// Drawings roughly covering what gets made with the paint tools,
+// from easy to compress (blank) up to the worst case (noise)
+static void corpus_generate(void) {
+
+    uint8_t * p_img;
+
+    corpus_add("blank");
+
+    if ((p_img = corpus_add("box_outline"))) {
+        for (int i = 0; i < (int)IMG_WIDTH_PX; i++) {
+            plot(p_img, i, 0); plot(p_img, i, IMG_HEIGHT_PX - 1);
+            plot(p_img, 0, i); plot(p_img, IMG_WIDTH_PX - 1, i);
+        }
+    }
+
+    if ((p_img = corpus_add("circles"))) {
+        for (int r = 4; r < 48; r += 6) draw_circle(p_img, 48, 48, r);
+    }
+
+    if ((p_img = corpus_add("lines"))) {
+        rng_state = 1u;
+        for (int i = 0; i < 24; i++)
+            draw_line(p_img, rng_next() % IMG_WIDTH_PX, rng_next() % IMG_HEIGHT_PX,
+                             rng_next() % IMG_WIDTH_PX, rng_next() % IMG_HEIGHT_PX);
+    }
+
+    if ((p_img = corpus_add("sketch"))) {
+        // Short connected strokes, similar to freehand pen drawing
+        rng_state = 2u;
+        int x = 48, y = 48;
+        for (int i = 0; i < 400; i++) {
+            int nx = x + (int)(rng_next() % 7u) - 3;
+            int ny = y + (int)(rng_next() % 7u) - 3;
+            if ((nx < 0) || (nx >= (int)IMG_WIDTH_PX)) nx = x;
+            if ((ny < 0) || (ny >= (int)IMG_HEIGHT_PX)) ny = y;
+            draw_line(p_img, x, y, nx, ny);
+            x = nx; y = ny;
+        }
+    }
+
+    if ((p_img = corpus_add("checker_8px"))) {
+        for (uint16_t y = 0u; y < IMG_HEIGHT_PX; y++)
+            for (uint16_t col = 0u; col < IMG_ROW_SZ_BYTES; col++)
+                p_img[(y * IMG_ROW_SZ_BYTES) + col] = (((y >> 3) ^ col) & 0x01u) ? 0xFFu : 0x00u;
+    }
+
+    if ((p_img = corpus_add("spray_10pct"))) {
+        rng_state = 3u;
+        for (uint16_t i = 0u; i < (IMG_WIDTH_PX * IMG_HEIGHT_PX) / 10u; i++)
+            plot(p_img, rng_next() % IMG_WIDTH_PX, rng_next() % IMG_HEIGHT_PX);
+    }
+
+    if ((p_img = corpus_add("noise"))) {
+        rng_state = 4u;
+        for (uint16_t i = 0u; i < IMG_SZ_BYTES; i++)
+            p_img[i] = (uint8_t)rng_next();
+    }
+}
+
+
+static bool corpus_load_file(const char * filename) {
+
+    FILE * p_file = fopen(filename, "rb");
+    if (!p_file) {
+        fprintf(stderr, "Error: unable to open %s\n", filename);
+        return false;
+    }
+
+    const char * p_name = strrchr(filename, '/');
+    p_name = (p_name) ? p_name + 1 : filename;
+
+    uint8_t * p_img = corpus_add(p_name);
+    bool ok = true;
+    if (p_img) {
+        size_t read_len = fread(p_img, 1u, IMG_SZ_BYTES, p_file);
+        if (read_len != IMG_SZ_BYTES) {
+            fprintf(stderr, "Error: %s is %u bytes, expected %u (96x96 1bpp)\n", filename, (unsigned)read_len, (unsigned)IMG_SZ_BYTES);
+            corpus_count--;
+            ok = false;
+        }
+    }
+    fclose(p_file);
+    return ok;
+}
+
+
+static uint64_t time_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000u) + (uint64_t)ts.tv_nsec;
+}
+
+
+// ===== Output checks =====
+// Reference implementations written straight from the specs (PNG / zlib / DEFLATE: RFC 1950, 1951,
+// QR Code: ISO 18004) without sharing any tables or code with the encoders, so that optimized
+// encoders can be checked against them: the PNG is taken apart, inflated and compared with the
+// drawing, the QR Code is read back, its Reed-Solomon ECC recomputed and its data compared with the url.
+
+static char verify_error[80];
+
+static bool verify_fail(const char * p_msg, unsigned value) {
+    snprintf(verify_error, sizeof(verify_error), p_msg, value);
+    return false;
+}
+
+
+static uint32_t read_be32(const uint8_t * p) {
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+
+static uint32_t ref_crc32(const uint8_t * p_data, uint32_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    while (len--) {
+        crc ^= *p_data++;
+        for (uint8_t b = 0u; b < 8u; b++) crc = (crc >> 1) ^ ((crc & 1u) ? 0xEDB88320u : 0u);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+static uint32_t ref_adler32(const uint8_t * p_data, uint32_t len) {
+    uint32_t s1 = 1u, s2 = 0u;
+    while (len--) {
+        s1 = (s1 + *p_data++) % 65521u;
+        s2 = (s2 + s1) % 65521u;
+    }
+    return (s2 << 16) | s1;
+}
+
+
+// Minimal inflate for the block types the encoder uses: Stored and Fixed Huffman
+typedef struct inflate_state_t {
+    const uint8_t * p_in;
+    uint32_t        in_len;
+    uint32_t        in_pos;
+    uint8_t         bit_pos;
+} inflate_state_t;
+
+static bool inflate_bits(inflate_state_t * p_st, uint8_t count, uint16_t * p_value) {
+    *p_value = 0u;
+    for (uint8_t b = 0u; b < count; b++) {
+        if (p_st->in_pos >= p_st->in_len) return false;
+        *p_value |= (uint16_t)((p_st->p_in[p_st->in_pos] >> p_st->bit_pos) & 1u) << b;
+        if (++p_st->bit_pos == 8u) { p_st->bit_pos = 0u; p_st->in_pos++; }
+    }
+    return true;
+}
+
+// Huffman codes are packed starting with their most significant bit
+static bool inflate_code_bit(inflate_state_t * p_st, uint16_t * p_code) {
+    uint16_t bit;
+    if (!inflate_bits(p_st, 1u, &bit)) return false;
+    *p_code = (uint16_t)((*p_code << 1) | bit);
+    return true;
+}
+
+static bool inflate_fixed_litlen(inflate_state_t * p_st, uint16_t * p_sym) {
+    uint16_t code = 0u;
+    for (uint8_t b = 0u; b < 7u; b++) if (!inflate_code_bit(p_st, &code)) return false;
+    if (code <= 0x17u) { *p_sym = 256u + code; return true; }                         // 256 - 279: 7 bits
+    if (!inflate_code_bit(p_st, &code)) return false;
+    if ((code >= 0x30u) && (code <= 0xBFu)) { *p_sym = code - 0x30u; return true; }     // 0 - 143: 8 bits
+    if ((code >= 0xC0u) && (code <= 0xC7u)) { *p_sym = 280u + (code - 0xC0u); return true; }  // 280 - 287: 8 bits
+    if (!inflate_code_bit(p_st, &code)) return false;
+    if (code >= 0x190u) { *p_sym = 144u + (code - 0x190u); return true; }               // 144 - 255: 9 bits
+    return false;
+}
+
+static const uint16_t inflate_len_base[29]  = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+static const uint8_t  inflate_len_extra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+static const uint16_t inflate_dist_base[30]  = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577 };
+static const uint8_t  inflate_dist_extra[30] = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
+
+// Inflates a zlib stream, checks its header and Adler-32. Returns the inflated size, 0 on error
+static uint32_t ref_zlib_inflate(const uint8_t * p_in, uint32_t in_len, uint8_t * p_out, uint32_t out_max) {
+
+    if ((in_len < 6u) || ((p_in[0] & 0x0Fu) != 8u) || (((p_in[0] << 8) | p_in[1]) % 31u) || (p_in[1] & 0x20u))
+        return verify_fail("bad zlib header", 0u), 0u;
+
+    inflate_state_t st = { .p_in = p_in, .in_len = in_len - 4u, .in_pos = 2u, .bit_pos = 0u };
+    uint32_t out_len = 0u;
+    uint16_t final, type;
+
+    do {
+        if (!inflate_bits(&st, 1u, &final) || !inflate_bits(&st, 2u, &type)) return verify_fail("DEFLATE data truncated", 0u), 0u;
+
+        if (type == 0u) {
+            // Stored: skip to the byte boundary, then LEN / NLEN and the raw bytes
+            if (st.bit_pos) { st.bit_pos = 0u; st.in_pos++; }
+            if ((st.in_pos + 4u) > st.in_len) return verify_fail("DEFLATE stored header truncated", 0u), 0u;
+            uint16_t len  = (uint16_t)(p_in[st.in_pos] | (p_in[st.in_pos + 1u] << 8));
+            uint16_t nlen = (uint16_t)(p_in[st.in_pos + 2u] | (p_in[st.in_pos + 3u] << 8));
+            st.in_pos += 4u;
+            if (((uint32_t)len + nlen) != 0xFFFFu) return verify_fail("DEFLATE stored LEN/NLEN mismatch", 0u), 0u;
+            if (((st.in_pos + len) > st.in_len) || ((out_len + len) > out_max)) return verify_fail("DEFLATE stored block too long", 0u), 0u;
+            memcpy(p_out + out_len, p_in + st.in_pos, len);
+            st.in_pos += len;
+            out_len   += len;
+        }
+        else if (type == 1u) {
+            while (true) {
+                uint16_t sym, extra, dist_sym;
+                if (!inflate_fixed_litlen(&st, &sym)) return verify_fail("bad DEFLATE literal/length code", 0u), 0u;
+                if (sym < 256u) {
+                    if (out_len >= out_max) return verify_fail("DEFLATE output too long", 0u), 0u;
+                    p_out[out_len++] = (uint8_t)sym;
+                    continue;
+                }
+                if (sym == 256u) break;
+                if ((sym -= 257u) >= 29u) return verify_fail("bad DEFLATE length code %u", sym + 257u), 0u;
+                if (!inflate_bits(&st, inflate_len_extra[sym], &extra)) return verify_fail("DEFLATE data truncated", 0u), 0u;
+                uint16_t len = inflate_len_base[sym] + extra;
+
+                // Fixed distance codes are 5 bits, most significant bit first
+                dist_sym = 0u;
+                for (uint8_t b = 0u; b < 5u; b++) if (!inflate_code_bit(&st, &dist_sym)) return verify_fail("DEFLATE data truncated", 0u), 0u;
+                if (dist_sym >= 30u) return verify_fail("bad DEFLATE distance code %u", dist_sym), 0u;
+                if (!inflate_bits(&st, inflate_dist_extra[dist_sym], &extra)) return verify_fail("DEFLATE data truncated", 0u), 0u;
+                uint16_t dist = inflate_dist_base[dist_sym] + extra;
+
+                if ((dist > out_len) || ((out_len + len) > out_max)) return verify_fail("DEFLATE match out of range (distance %u)", dist), 0u;
+                for (uint16_t c = 0u; c < len; c++, out_len++) p_out[out_len] = p_out[out_len - dist];
+            }
+        }
+        else return verify_fail("unexpected DEFLATE block type %u", type), 0u;
+    } while (!final);
+
+    if (st.bit_pos) st.in_pos++;
+    if (st.in_pos != st.in_len) return verify_fail("%u extra bytes after the DEFLATE data", st.in_len - st.in_pos), 0u;
+    if (read_be32(p_in + st.in_len) != ref_adler32(p_out, out_len)) return verify_fail("Adler-32 mismatch", 0u), 0u;
+    return out_len;
+}
+
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = (int)a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    return ((pa <= pb) && (pa <= pc)) ? a : (pb <= pc) ? b : c;
+}
+
+
+// Takes the PNG apart (chunk CRCs, header, palette), inflates the image data,
+// undoes the row filters and compares every pixel with the drawing
+static bool verify_png(const uint8_t * p_png, uint16_t png_sz, const uint8_t * p_pixels) {
+
+    static const uint8_t png_signature[8] = { 0x89u, 'P', 'N', 'G', 0x0Du, 0x0Au, 0x1Au, 0x0Au };
+    static uint8_t idat[PNG_BUF_SZ];
+    static uint8_t scanlines[IMG_HEIGHT_PX * (IMG_ROW_SZ_BYTES + 1u)];
+
+    const uint8_t * p_ihdr = NULL;
+    const uint8_t * p_plte = NULL;
+    uint32_t plte_len = 0u, idat_len = 0u, pos = sizeof(png_signature);
+    bool iend = false;
+
+    if ((png_sz < pos) || memcmp(p_png, png_signature, sizeof(png_signature))) return verify_fail("bad PNG signature", 0u);
+
+    while (!iend) {
+        if ((pos + 12u) > png_sz) return verify_fail("PNG truncated at offset %u", pos);
+        uint32_t len = read_be32(p_png + pos);
+        const uint8_t * p_type = p_png + pos + 4u;
+        const uint8_t * p_data = p_png + pos + 8u;
+        if ((pos + 12u + len) > png_sz) return verify_fail("PNG chunk at offset %u too long", pos);
+        if (read_be32(p_data + len) != ref_crc32(p_type, len + 4u)) return verify_fail("CRC-32 mismatch in chunk at offset %u", pos);
+
+        if      (!memcmp(p_type, "IHDR", 4u)) p_ihdr = p_data;
+        else if (!memcmp(p_type, "PLTE", 4u)) { p_plte = p_data; plte_len = len; }
+        else if (!memcmp(p_type, "IDAT", 4u)) {
+            memcpy(idat + idat_len, p_data, len);
+            idat_len += len;
+        }
+        else if (!memcmp(p_type, "IEND", 4u)) iend = true;
+        pos += 12u + len;
+    }
+    if (pos != png_sz) return verify_fail("%u bytes after IEND", png_sz - pos);
+
+    // 1 bit indexed, no interlace
+    if (!p_ihdr || (read_be32(p_ihdr) != IMG_WIDTH_PX) || (read_be32(p_ihdr + 4u) != IMG_HEIGHT_PX) ||
+        (p_ihdr[8] != 1u) || (p_ihdr[9] != 3u) || p_ihdr[10] || p_ihdr[11] || p_ihdr[12])
+        return verify_fail("unexpected IHDR", 0u);
+    if (!p_plte || (plte_len != 6u)) return verify_fail("unexpected PLTE", 0u);
+
+    uint32_t len = ref_zlib_inflate(idat, idat_len, scanlines, sizeof(scanlines));
+    if (len == 0u) return false;
+    if (len != sizeof(scanlines)) return verify_fail("inflated to %u bytes", len);
+
+    // Row filters, bytes per pixel rounds up to 1 for 1 bit pixels
+    const uint16_t stride = IMG_ROW_SZ_BYTES + 1u;
+    for (uint16_t y = 0u; y < IMG_HEIGHT_PX; y++) {
+        uint8_t * p_row = scanlines + (y * stride) + 1u;
+        const uint8_t * p_up = (y) ? p_row - stride : NULL;
+        uint8_t filter = p_row[-1];
+        if (filter > 4u) return verify_fail("bad filter type on row %u", y);
+
+        for (uint16_t x = 0u; x < IMG_ROW_SZ_BYTES; x++) {
+            uint8_t a = (x) ? p_row[x - 1u] : 0u;
+            uint8_t b = (p_up) ? p_up[x] : 0u;
+            uint8_t c = (x && p_up) ? p_up[x - 1u] : 0u;
+            switch (filter) {
+                case 1u: p_row[x] += a; break;
+                case 2u: p_row[x] += b; break;
+                case 3u: p_row[x] += (uint8_t)((a + b) >> 1); break;
+                case 4u: p_row[x] += paeth(a, b, c); break;
+            }
+        }
+
+        // Drawing pixels are 1 = black, check they come out dark through the palette
+        for (uint16_t x = 0u; x < IMG_WIDTH_PX; x++) {
+            uint8_t index = (p_row[x >> 3] >> (7u - (x & 0x07u))) & 1u;
+            bool dark     = (uint16_t)(p_plte[index * 3u] + p_plte[index * 3u + 1u] + p_plte[index * 3u + 2u]) < (3u * 128u);
+            bool black    = (p_pixels[(y * IMG_ROW_SZ_BYTES) + (x >> 3)] >> (7u - (x & 0x07u))) & 1u;
+            if (dark != black) return verify_fail("pixel mismatch on row %u", y);
+        }
+    }
+    return true;
+}
+
+
+// QR Code error correction codewords per block and number of blocks, indexed by [format ECL bits][version]
+// (ISO 18004 table 9, format bits order: 0 = M, 1 = L, 2 = H, 3 = Q)
+static const uint8_t ref_qr_ecc_per_block[4][41] = {
+    {0, 10, 16, 26, 18, 24, 16, 18, 22, 22, 26, 30, 22, 22, 24, 24, 28, 28, 26, 26, 26, 26, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28, 28},
+    {0,  7, 10, 15, 20, 26, 18, 20, 24, 30, 18, 20, 24, 26, 30, 22, 24, 28, 30, 28, 28, 28, 28, 30, 30, 26, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {0, 17, 28, 22, 16, 22, 28, 26, 26, 24, 28, 24, 28, 22, 24, 24, 30, 28, 28, 26, 28, 30, 24, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+    {0, 13, 22, 18, 26, 18, 24, 18, 22, 20, 24, 28, 26, 24, 20, 30, 24, 28, 28, 26, 30, 28, 30, 30, 30, 30, 28, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30, 30},
+};
+static const uint8_t ref_qr_block_count[4][41] = {
+    {0, 1, 1, 1, 2, 2, 4, 4, 4, 5, 5,  5,  8,  9,  9, 10, 10, 11, 13, 14, 16, 17, 17, 18, 20, 21, 23, 25, 26, 28, 29, 31, 33, 35, 37, 38, 40, 43, 45, 47, 49},
+    {0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 4,  4,  4,  4,  4,  6,  6,  6,  6,  7,  8,  8,  9,  9, 10, 12, 12, 12, 13, 14, 15, 16, 17, 18, 19, 19, 20, 21, 22, 24, 25},
+    {0, 1, 1, 2, 4, 4, 4, 5, 6, 8, 8, 11, 11, 16, 16, 18, 16, 19, 21, 25, 25, 25, 34, 30, 32, 35, 37, 40, 42, 45, 48, 51, 54, 57, 60, 63, 66, 70, 74, 77, 81},
+    {0, 1, 1, 2, 2, 4, 4, 6, 6, 8, 8,  8, 10, 12, 16, 12, 17, 16, 18, 21, 20, 23, 23, 25, 27, 29, 34, 34, 35, 38, 40, 43, 45, 48, 51, 53, 56, 59, 62, 65, 68},
+};
+
+#define REF_QR_SIZE_MAX      177u
+#define REF_QR_CODEWORDS_MAX 3706u
+
+static bool    qr_function[REF_QR_SIZE_MAX][REF_QR_SIZE_MAX];  // [y][x]
+static uint8_t qr_codewords[REF_QR_CODEWORDS_MAX];
+static uint8_t qr_data[REF_QR_CODEWORDS_MAX];
+
+// Marks a function module and checks its color
+static bool qr_expect(uint8_t x, uint8_t y, bool dark) {
+    qr_function[y][x] = true;
+    return qr_get(x, y) == dark;
+}
+
+static uint32_t qr_bch(uint16_t data, uint8_t data_bits, uint16_t poly, uint8_t poly_bits) {
+    uint32_t rem = (uint32_t)data << poly_bits;
+    for (int8_t b = (int8_t)(data_bits + poly_bits - 1u); b >= poly_bits; b--)
+        if (rem & (1ul << b)) rem ^= (uint32_t)poly << (b - poly_bits);
+    return ((uint32_t)data << poly_bits) | rem;
+}
+
+static bool qr_mask_bit(uint8_t mask, uint16_t x, uint16_t y) {
+    switch (mask) {
+        case 0u: return ((x + y) % 2u) == 0u;
+        case 1u: return (y % 2u) == 0u;
+        case 2u: return (x % 3u) == 0u;
+        case 3u: return ((x + y) % 3u) == 0u;
+        case 4u: return (((x / 3u) + (y / 2u)) % 2u) == 0u;
+        case 5u: return (((x * y) % 2u) + ((x * y) % 3u)) == 0u;
+        case 6u: return ((((x * y) % 2u) + ((x * y) % 3u)) % 2u) == 0u;
+        default: return ((((x + y) % 2u) + ((x * y) % 3u)) % 2u) == 0u;
+    }
+}
+
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+    uint8_t product = 0u;
+    while (b) {
+        if (b & 1u) product ^= a;
+        a = (uint8_t)((a << 1) ^ ((a & 0x80u) ? 0x1Du : 0u));
+        b >>= 1;
+    }
+    return product;
+}
+
+// Reed-Solomon remainder of p_data by the generator (x - 1)(x - 2)(x - 4)...(x - 2^(ecc_len - 1))
+static void ref_rs_ecc(const uint8_t * p_data, uint16_t data_len, uint8_t ecc_len, uint8_t * p_ecc) {
+    uint8_t gen[31] = { 1u };  // Coefficients, highest power first
+    uint8_t root    = 1u;
+    for (uint8_t i = 0u; i < ecc_len; i++) {
+        for (int8_t c = (int8_t)i + 1; c > 0; c--) gen[c] = gen[c] ^ gf_mul(gen[c - 1], root);
+        root = gf_mul(root, 2u);
+    }
+    memset(p_ecc, 0u, ecc_len);
+    for (uint16_t i = 0u; i < data_len; i++) {
+        uint8_t factor = p_data[i] ^ p_ecc[0];
+        memmove(p_ecc, p_ecc + 1u, ecc_len - 1u);
+        p_ecc[ecc_len - 1u] = 0u;
+        for (uint8_t c = 0u; c < ecc_len; c++) p_ecc[c] ^= gf_mul(gen[c + 1u], factor);
+    }
+}
+
+typedef struct qr_bit_reader_t {
+    const uint8_t * p_data;
+    uint32_t        len_bits;
+    uint32_t        pos;
+} qr_bit_reader_t;
+
+static bool qr_read_bits(qr_bit_reader_t * p_rd, uint8_t count, uint16_t * p_value) {
+    *p_value = 0u;
+    if ((p_rd->pos + count) > p_rd->len_bits) return false;
+    for (uint8_t b = 0u; b < count; b++, p_rd->pos++)
+        *p_value = (uint16_t)((*p_value << 1) | ((p_rd->p_data[p_rd->pos >> 3] >> (7u - (p_rd->pos & 0x07u))) & 1u));
+    return true;
+}
+
+
+// Reads back the QR Code in QRCODE: function patterns, format and version info, Reed-Solomon ECC of every
+// block, then decodes the data segments and compares them with the text and structured append header
+static bool verify_qrcode(const uint8_t * p_text, uint16_t text_len, uint8_t sa_position, uint8_t sa_total, uint8_t sa_parity) {
+
+    static const char alnum_chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ $%*+-./:";
+    const uint8_t version = qr_version;
+    const uint8_t size    = qr_size;
+
+    if ((version < 1u) || (version > 40u) || (size != (version * 4u) + 17u)) return verify_fail("bad QR Code version %u", version);
+    memset(qr_function, 0, sizeof(qr_function));
+
+    // Finder patterns and separators, timing patterns
+    static const uint8_t finder_corner[3][2] = { {0u, 0u}, {1u, 0u}, {0u, 1u} };
+    for (uint8_t f = 0u; f < 3u; f++) {
+        int cx = (finder_corner[f][0]) ? (size - 4) : 3, cy = (finder_corner[f][1]) ? (size - 4) : 3;
+        for (int dy = -4; dy <= 4; dy++) for (int dx = -4; dx <= 4; dx++) {
+            int x = cx + dx, y = cy + dy, dist = (abs(dx) > abs(dy)) ? abs(dx) : abs(dy);
+            if ((x < 0) || (y < 0) || (x >= size) || (y >= size)) continue;
+            if (!qr_expect(x, y, (dist != 2) && (dist != 4))) return verify_fail("finder pattern mismatch", 0u);
+        }
+    }
+    for (uint8_t i = 8u; i < size - 8u; i++)
+        if (!qr_expect(i, 6u, !(i & 1u)) || !qr_expect(6u, i, !(i & 1u))) return verify_fail("timing pattern mismatch at %u", i);
+
+    // Alignment patterns, evenly spaced from the far side (rounded up to even) except for the first at 6
+    if (version > 1u) {
+        uint8_t count = (version / 7u) + 2u;
+        uint8_t step  = (version == 32u) ? 26u : (uint8_t)((((version * 4u) + (count * 2u) + 1u) / ((count * 2u) - 2u)) * 2u);
+        uint8_t pos[7];
+        pos[0] = 6u;
+        for (uint8_t i = count - 1u, p = size - 7u; i >= 1u; i--, p -= step) pos[i] = p;
+        for (uint8_t i = 0u; i < count; i++) for (uint8_t j = 0u; j < count; j++) {
+            if (((i == 0u) && (j == 0u)) || ((i == 0u) && (j == count - 1u)) || ((i == count - 1u) && (j == 0u))) continue;
+            for (int dy = -2; dy <= 2; dy++) for (int dx = -2; dx <= 2; dx++)
+                if (!qr_expect(pos[i] + dx, pos[j] + dy, ((abs(dx) > abs(dy)) ? abs(dx) : abs(dy)) != 1))
+                    return verify_fail("alignment pattern mismatch", 0u);
+        }
+    }
+
+    // Version info (version 7+), both copies
+    if (version >= 7u) {
+        uint32_t bits = qr_bch(version, 6u, 0x1F25u, 12u);
+        for (uint8_t i = 0u; i < 18u; i++) {
+            bool dark = (bits >> i) & 1u;
+            if (!qr_expect(size - 11u + (i % 3u), i / 3u, dark) || !qr_expect(i / 3u, size - 11u + (i % 3u), dark))
+                return verify_fail("version info mismatch", 0u);
+        }
+    }
+
+    // Format info: read both copies, they must match one of the 32 valid codes
+    uint16_t format_a = 0u, format_b = 0u;
+    for (uint8_t i = 0u; i < 15u; i++) {
+        uint8_t ax = (i < 6u) ? 8u : (i < 8u) ? 8u : (i == 8u) ? 7u : (14u - i);
+        uint8_t ay = (i < 6u) ? i  : (i == 6u) ? 7u : 8u;
+        uint8_t bx = (i < 8u) ? (size - 1u - i) : 8u;
+        uint8_t by = (i < 8u) ? 8u : (size - 15u + i);
+        qr_function[ay][ax] = qr_function[by][bx] = true;
+        format_a |= (uint16_t)qr_get(ax, ay) << i;
+        format_b |= (uint16_t)qr_get(bx, by) << i;
+    }
+    if (!qr_expect(8u, size - 8u, true)) return verify_fail("dark module missing", 0u);
+    if (format_a != format_b) return verify_fail("format info copies differ", 0u);
+    int8_t format = -1;
+    for (uint8_t f = 0u; f < 32u; f++) if ((qr_bch(f, 5u, 0x537u, 10u) ^ 0x5412u) == format_a) format = (int8_t)f;
+    if (format < 0) return verify_fail("bad format info 0x%04x", format_a);
+    const uint8_t ecl  = (uint8_t)format >> 3;
+    const uint8_t mask = (uint8_t)format & 0x07u;
+
+    // Codewords in the zigzag order, unmasked. Leftover remainder bits must be 0 (after unmasking)
+    uint32_t bit_count = 0u;
+    memset(qr_codewords, 0u, sizeof(qr_codewords));
+    for (int right = size - 1; right >= 1; right -= 2) {
+        if (right == 6) right = 5;
+        for (uint8_t vert = 0u; vert < size; vert++) for (uint8_t j = 0u; j < 2u; j++) {
+            uint8_t x = (uint8_t)(right - j);
+            uint8_t y = (((right + 1) & 2) == 0) ? (size - 1u - vert) : vert;
+            if (qr_function[y][x]) continue;
+            bool dark = qr_get(x, y) ^ qr_mask_bit(mask, x, y);
+            if ((bit_count >> 3) < REF_QR_CODEWORDS_MAX) qr_codewords[bit_count >> 3] |= (uint8_t)(dark << (7u - (bit_count & 0x07u)));
+            else if (dark) return verify_fail("remainder bit set", 0u);
+            bit_count++;
+        }
+    }
+
+    // Blocks: the short ones first, long ones have one more data codeword. Data codewords are interleaved
+    // across blocks, then the ECC codewords
+    const uint16_t total      = (uint16_t)(bit_count / 8u);
+    const uint8_t  ecc_len    = ref_qr_ecc_per_block[ecl][version];
+    const uint8_t  blocks     = ref_qr_block_count[ecl][version];
+    const uint8_t  short_cnt  = blocks - (uint8_t)(total % blocks);
+    const uint16_t short_data = (total / blocks) - ecc_len;
+    uint16_t data_len = 0u;
+
+    for (uint8_t blk = 0u; blk < blocks; blk++) {
+        uint16_t blk_data = short_data + ((blk >= short_cnt) ? 1u : 0u);
+        uint8_t  block[REF_QR_CODEWORDS_MAX / 8u], ecc[30];
+
+        for (uint16_t i = 0u; i < blk_data; i++)
+            block[i] = qr_codewords[(i * blocks) + blk - ((i == short_data) ? short_cnt : 0u)];
+        for (uint8_t i = 0u; i < ecc_len; i++)
+            block[blk_data + i] = qr_codewords[(short_data * blocks) + (blocks - short_cnt) + (i * blocks) + blk];
+
+        ref_rs_ecc(block, blk_data, ecc_len, ecc);
+        if (memcmp(ecc, block + blk_data, ecc_len)) return verify_fail("Reed-Solomon ECC mismatch in block %u", blk);
+        memcpy(qr_data + data_len, block, blk_data);
+        data_len += blk_data;
+    }
+
+    // Data segments
+    qr_bit_reader_t rd = { .p_data = qr_data, .len_bits = data_len * 8u, .pos = 0u };
+    uint16_t mode, value, text_pos = 0u;
+    const uint8_t cc_idx = (version <= 9u) ? 0u : (version <= 26u) ? 1u : 2u;
+    static const uint8_t count_bits[3][3] = { {10u, 12u, 14u}, {9u, 11u, 13u}, {8u, 16u, 16u} };  // Numeric, alphanumeric, byte
+
+    if (sa_total > 1u) {
+        uint16_t sa_pos, sa_cnt, sa_par;
+        if (!qr_read_bits(&rd, 4u, &mode) || (mode != 0x3u) || !qr_read_bits(&rd, 4u, &sa_pos) ||
+            !qr_read_bits(&rd, 4u, &sa_cnt) || !qr_read_bits(&rd, 8u, &sa_par) ||
+            (sa_pos != sa_position) || (sa_cnt != sa_total - 1u) || (sa_par != sa_parity))
+            return verify_fail("bad structured append header", 0u);
+    }
+    while (qr_read_bits(&rd, 4u, &mode) && mode) {
+        uint8_t  kind = (mode == 0x1u) ? 0u : (mode == 0x2u) ? 1u : (mode == 0x4u) ? 2u : 0xFFu;
+        uint16_t count;
+        if ((kind == 0xFFu) || !qr_read_bits(&rd, count_bits[kind][cc_idx], &count)) return verify_fail("bad segment mode %u", mode);
+        if ((text_pos + count) > text_len) return verify_fail("more data than the url at %u", text_pos);
+
+        for (uint16_t c = 0u; c < count; ) {
+            // Numeric packs 3 digits in 10 bits, alphanumeric 2 chars in 11 bits (shorter for the last group)
+            uint16_t left  = count - c;
+            uint8_t  chars = (kind == 0u) ? ((left >= 3u) ? 3u : (uint8_t)left) : (kind == 1u) ? ((left >= 2u) ? 2u : 1u) : 1u;
+            uint8_t  bits  = (kind == 0u) ? (uint8_t)((chars * 10u + 2u) / 3u) : (kind == 1u) ? ((chars == 2u) ? 11u : 6u) : 8u;
+            if (!qr_read_bits(&rd, bits, &value)) return verify_fail("segment truncated at %u", text_pos);
+            char out[3];
+            if (kind == 0u)      for (int8_t d = (int8_t)chars - 1; d >= 0; d--) { out[d] = (char)('0' + (value % 10u)); value /= 10u; }
+            else if (kind == 1u) {
+                if (chars == 2u) { out[0] = alnum_chars[value / 45u]; out[1] = alnum_chars[value % 45u]; if (value >= 45u * 45u) return verify_fail("bad alphanumeric value", 0u); }
+                else             { if (value >= 45u) return verify_fail("bad alphanumeric value", 0u); out[0] = alnum_chars[value]; }
+            }
+            else out[0] = (char)value;
+            if (memcmp(out, p_text + text_pos, chars)) return verify_fail("data differs from the url at %u", text_pos);
+            text_pos += chars;
+            c        += chars;
+        }
+    }
+    if (text_pos != text_len) return verify_fail("url cut short at %u", text_pos);
+
+    // After the terminator: zero bits up to the byte boundary, then alternating 0xEC, 0x11 pad bytes
+    rd.pos = (rd.pos + 7u) & ~7u;
+    for (uint8_t pad = 0xECu; rd.pos < rd.len_bits; pad ^= (0xECu ^ 0x11u), rd.pos += 8u)
+        if (qr_data[rd.pos >> 3] != pad) return verify_fail("bad pad byte at %u", rd.pos >> 3);
+    return true;
+}
+
+
+// Same split as qr_parts_plan() in img_2_qrcode.c, then generates each QR Code.
+// With p_check_ok each one also gets checked, clearing it on a failure
+static bool qr_generate_split(const uint8_t * p_url, uint16_t url_len, stage_result_t * p_result, bool * p_check_ok) {
+
+    qr_segment_t segments[QR_SEGMENTS_MAX];
+    uint16_t part_len[QR_STRUCTURED_APPEND_MAX];
+    uint8_t  count  = 0u;
+    uint8_t  parity = 0u;
+
+    qrcodegen_set_structured_append(0u, QR_STRUCTURED_APPEND_MAX, 0u);
+    for (uint16_t offset = 0u; offset < url_len; offset += part_len[count++]) {
+        if (count == QR_STRUCTURED_APPEND_MAX) return false;
+        uint8_t seg_count = qrcodegen_make_segments(p_url + offset, url_len - offset, segments, QR_SEGMENTS_MAX);
+        part_len[count] = qrcodegen_fit_segments(segments, &seg_count, qr_split_version);
+        if (part_len[count] == 0u) return false;
+    }
+    for (uint16_t c = 0u; c < url_len; c++) parity ^= p_url[c];
+
+    p_result->qr_version = 0u;
+    for (uint8_t part = 0u; part < count; part++) {
+        qrcodegen_set_structured_append(part, count, parity);
+        if (qrcodegen((const char *)p_url, part_len[part]) == NULL) return false;
+        if (qr_version > p_result->qr_version) p_result->qr_version = qr_version;
+        if (p_check_ok && *p_check_ok) *p_check_ok = verify_qrcode(p_url, part_len[part], part, count, parity);
+        p_url += part_len[part];
+    }
+    p_result->qr_count = count;
+    return true;
+}
+
+
+static void run_stages(const corpus_entry_t * p_entry, uint16_t iterations, stage_result_t * p_result) {
+
+    uint64_t start;
+
+    // PNG
+    start = time_now_ns();
+    for (uint16_t i = 0u; i < iterations; i++) {
+        png_indexed_init(IMG_WIDTH_PX, IMG_HEIGHT_PX, SRC_BPP_1, PNG_BPP_1, pal_1bpp_white_black_sz, png_compression, png_filter_mode);
+        png_indexed_set_buffers((uint8_t *)pal_1bpp_white_black, (uint8_t *)p_entry->pixels, png_buf);
+        p_result->png_sz = png_indexed_encode();
+    }
+    p_result->png_ns = (time_now_ns() - start) / iterations;
+
+    // Base64 (or Base32) url
+    start = time_now_ns();
+    for (uint16_t i = 0u; i < iterations; i++) {
+        if (p_url_base32_prefix)
+            p_result->b64_sz = base32_encode_to_url(b64_buf, (const uint8_t *)p_url_base32_prefix, (uint8_t)strlen(p_url_base32_prefix),
+                                                    png_buf, p_result->png_sz);
+        else
+            p_result->b64_sz = base64_encode_to_url(b64_buf, png_buf, p_result->png_sz);
+    }
+    p_result->b64_ns = (time_now_ns() - start) / iterations;
+
+    // QR Code(s)
+    p_result->qr_version = 0u;
+    p_result->qr_count   = 0u;
+    start = time_now_ns();
+    for (uint16_t i = 0u; i < iterations; i++) {
+        if (qr_split_version) {
+            if (!qr_generate_split(b64_buf, p_result->b64_sz, p_result, NULL)) { p_result->qr_version = 0u; break; }
+        }
+        else {
+            qrcodegen_set_structured_append(0u, 0u, 0u);
+            if (qrcodegen((const char *)b64_buf, p_result->b64_sz) == NULL) break;
+            p_result->qr_version = qr_version;
+            p_result->qr_count   = 1u;
+        }
+    }
+    p_result->qr_ns = (p_result->qr_version) ? ((time_now_ns() - start) / iterations) : 0u;
+
+    // Checks on the output of the last iteration (the split QR Codes get made again one at a time)
+    verify_error[0]    = '\0';
+    p_result->check_ok = verify_png(png_buf, p_result->png_sz, p_entry->pixels);
+    if (p_result->check_ok && p_result->qr_version) {
+        if (qr_split_version) qr_generate_split(b64_buf, p_result->b64_sz, p_result, &p_result->check_ok);
+        else                  p_result->check_ok = verify_qrcode(b64_buf, p_result->b64_sz, 0u, 0u, 0u);
+    }
+}
+
+
+static void show_help(void) {
+    printf("Usage: host_bench [-n iterations] [-s] [-f filter_mode] [-a url_prefix] [-m version] [drawing.bin ...]\n"
+           "  -s:          uncompressed PNG (Stored DEFLATE block)\n"
+           "  -f:          PNG row filter mode, 0 = none, 1 = heuristic per row, 2 = heuristic reused for 8 rows\n"
+           "  -a:          Base32 url format with the given prefix (ex: HTTPS://EXAMPLE.ORG/GBDRAW/#)\n"
+           "  -m:          split the url across QR Codes of at most this version (structured append)\n"
+           "  drawing.bin: raw 96x96 1bpp image (1152 bytes, MSB first, 1 = black)\n");
+}
+
+
+int main(int argc, char * argv[]) {
+
+    uint16_t iterations = ITERATIONS_DEFAULT;
+
+    corpus_generate();
+    qrcodegen_set_template_cache(qr_template_buf, sizeof(qr_template_buf));
+
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-n") == 0) && ((i + 1) < argc)) {
+            long n = strtol(argv[++i], NULL, 10);
+            if ((n < 1) || (n > 65535)) { show_help(); return EXIT_FAILURE; }
+            iterations = (uint16_t)n;
+        }
+        else if ((strcmp(argv[i], "-f") == 0) && ((i + 1) < argc)) {
+            long mode = strtol(argv[++i], NULL, 10);
+            if ((mode < PNG_FILTER_MODE_NONE) || (mode > PNG_FILTER_MODE_HEURISTIC_REUSE)) { show_help(); return EXIT_FAILURE; }
+            png_filter_mode = (uint8_t)mode;
+        }
+        else if ((strcmp(argv[i], "-a") == 0) && ((i + 1) < argc)) {
+            p_url_base32_prefix = argv[++i];
+            if (strlen(p_url_base32_prefix) > 255u) { show_help(); return EXIT_FAILURE; }
+        }
+        else if ((strcmp(argv[i], "-m") == 0) && ((i + 1) < argc)) {
+            long version = strtol(argv[++i], NULL, 10);
+            if ((version < QR_VERSION_MIN) || (version > QR_VERSION_MAX)) { show_help(); return EXIT_FAILURE; }
+            qr_split_version = (uint8_t)version;
+        }
+        else if (strcmp(argv[i], "-s") == 0) {
+            png_compression = PNG_COMPRESSION_NONE;
+        }
+        else if ((strcmp(argv[i], "-h") == 0) || (strcmp(argv[i], "--help") == 0)) {
+            show_help();
+            return EXIT_SUCCESS;
+        }
+        else if (!corpus_load_file(argv[i])) return EXIT_FAILURE;
+    }
+
+    printf("Iterations per stage: %u, PNG compression: %s, filter mode: %u, CRC engine: %s, url: %s\n\n", (unsigned)iterations,
+           (png_compression == PNG_COMPRESSION_NONE) ? "none" : "fixed huffman", (unsigned)png_filter_mode, crc_engine_names[PNG_CRC_ENGINE],
+           (p_url_base32_prefix) ? "base32" : "base64 data");
+    printf("%-20s %8s %8s %4s %4s %12s %12s %12s %6s\n", "drawing", "png_B", "url_B", "qr_n", "qr_v", "png_ns/op", "b64_ns/op", "qr_ns/op", "check");
+
+    stage_result_t total = {0};
+    uint32_t total_png_sz = 0u, total_b64_sz = 0u;
+    bool all_fit = true;
+    uint8_t check_fail_count = 0u;
+
+    for (uint8_t c = 0u; c < corpus_count; c++) {
+        stage_result_t result;
+        run_stages(&corpus[c], iterations, &result);
+
+        if (result.qr_version)
+            printf("%-20s %8u %8u %4u %4u %12llu %12llu %12llu %6s\n", corpus[c].name,
+                   (unsigned)result.png_sz, (unsigned)result.b64_sz, (unsigned)result.qr_count, (unsigned)result.qr_version,
+                   (unsigned long long)result.png_ns, (unsigned long long)result.b64_ns, (unsigned long long)result.qr_ns,
+                   (result.check_ok) ? "ok" : "FAIL");
+        else {
+            printf("%-20s %8u %8u %4s %4s %12llu %12llu %12s %6s\n", corpus[c].name,
+                   (unsigned)result.png_sz, (unsigned)result.b64_sz, "-", "-",
+                   (unsigned long long)result.png_ns, (unsigned long long)result.b64_ns, "too large",
+                   (result.check_ok) ? "ok" : "FAIL");
+            all_fit = false;
+        }
+        if (!result.check_ok) {
+            printf("  check failed: %s\n", verify_error);
+            check_fail_count++;
+        }
+
+        total.png_ns += result.png_ns;
+        total.b64_ns += result.b64_ns;
+        total.qr_ns  += result.qr_ns;
+        total_png_sz += result.png_sz;
+        total_b64_sz += result.b64_sz;
+    }
+
+    printf("%-20s %8lu %8lu %4s %4s %12llu %12llu %12llu\n", "(total)",
+           (unsigned long)total_png_sz, (unsigned long)total_b64_sz, "", "",
+           (unsigned long long)total.png_ns, (unsigned long long)total.b64_ns, (unsigned long long)total.qr_ns);
+
+    if (check_fail_count) printf("\nChecks: FAILED for %u of %u drawings\n", (unsigned)check_fail_count, (unsigned)corpus_count);
+    else                  printf("\nChecks: PASS (PNG chunks, inflate, Adler-32, pixels, QR Code patterns, RS ECC, data)\n");
+
+    return (all_fit && !check_fail_count) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,10 @@
+// Only the color names are needed by the headers shared with the encode pipeline
+#ifndef HOST_BENCH_STUB_DRAWING_H
+#define HOST_BENCH_STUB_DRAWING_H
+
+#define WHITE  0u
+#define LTGREY 1u
+#define DKGREY 2u
+#define BLACK  3u
+
+#endif // HOST_BENCH_STUB_DRAWING_H
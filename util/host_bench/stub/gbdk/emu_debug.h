@@ -0,0 +1,11 @@
+// Emulator debug output and profiling markers are compiled out for the host build
+#ifndef HOST_BENCH_STUB_EMU_DEBUG_H
+#define HOST_BENCH_STUB_EMU_DEBUG_H
+
+#define EMU_printf(...)
+#define EMU_MESSAGE(x)
+#define EMU_PROFILE_BEGIN(x)
+#define EMU_PROFILE_END(x)
+#define EMU_BREAKPOINT
+
+#endif // HOST_BENCH_STUB_EMU_DEBUG_H
@@ -0,0 +1,40 @@
+// Minimal stand-in for the GBDK platform header so the encode pipeline
+// (png_indexed.c, deflate.c, base64.c, qrcodegen.c) can be compiled natively.
+//
+// Only what those files use is provided, banking related macros are no-ops.
+#ifndef HOST_BENCH_STUB_PLATFORM_H
+#define HOST_BENCH_STUB_PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BANKED
+#define NONBANKED
+#define BANKREF(x)
+#define BANKREF_EXTERN(x)
+#define BANK(x)           0u
+
+#define SFR uint8_t
+
+#define CURRENT_BANK  0u
+#define SWITCH_ROM(b)
+#define SWITCH_RAM(b)
+
+#define DISPLAY_OFF
+#define DISPLAY_ON
+
+#define DEVICE_SCREEN_WIDTH      20u
+#define DEVICE_SCREEN_HEIGHT     18u
+#define DEVICE_SCREEN_PX_WIDTH  160u
+#define DEVICE_SCREEN_PX_HEIGHT 144u
+
+#define J_RIGHT  0x01u
+#define J_LEFT   0x02u
+#define J_UP     0x04u
+#define J_DOWN   0x08u
+#define J_A      0x10u
+#define J_B      0x20u
+#define J_SELECT 0x40u
+#define J_START  0x80u
+
+#endif // HOST_BENCH_STUB_PLATFORM_H
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 
 static uint8_t reedSolomonMultiply(uint8_t x, uint8_t y) {
@@ -37,9 +38,15 @@ static void gentable(uint8_t range) {
     uint16_t range_end    = range_start + (0x100u / 4);
     uint8_t  autobank_num = range + 1u;
 
-    printf("#include <stdint.h>\n\n");
+    printf("#include <gbdk/platform.h>\n");
+    printf("#include <stdint.h>\n");
+    printf("#include <stdbool.h>\n\n");
+    printf("#include \"qrcodegen.h\"\n\n");
     printf("#pragma bank %hu // Autobanked\n\n", autobank_num);
 
+    printf("// Only used with the banked LUT Reed-Solomon engine, see QR_RS_ENGINE in qrcodegen.h\n");
+    printf("#if (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)\n\n");
+
     printf("// Reed Solomon Multiply LUT x:(%u -> %u)\n\n", range_start, range_end - 1u);
     printf("const uint8_t reed_solomon_mul_lut_%u[] = {", autobank_num);
 
@@ -52,12 +59,85 @@ static void gentable(uint8_t range) {
         }
     }
 
-    printf("\n};\n\n\n");
+    printf("\n};\n\n");
+    printf("#endif // QR_RS_ENGINE_LUT_BANKED\n\n\n");
+}
+
+
+#define RS_GEN_DEGREE_MAX 30u  // Matches qrcodegen_REED_SOLOMON_DEGREE_MAX
+
+// Computes the divisor (generator) polynomial: product of (x - r^i) for i = 0 .. degree - 1
+// with r = 0x02. Coefficients are stored highest to lowest power, excluding the leading 1
+static void gen_divisor(uint8_t degree, uint8_t result[]) {
+
+    memset(result, 0, degree);
+    result[degree - 1] = 1;  // Start off with the monomial x^0
+
+    uint8_t root = 1;
+    for (uint8_t i = 0; i < degree; i++) {
+        for (uint8_t j = 0; j < degree; j++) {
+            result[j] = reedSolomonMultiply(result[j], root);
+            if (j + 1 < degree)
+                result[j] ^= result[j + 1];
+        }
+        root = reedSolomonMultiply(root, 0x02);
+    }
+}
+
+
+// Discrete log base 0x02, x must not be zero (generator coefficients never are)
+static uint8_t gf_log(uint8_t x) {
+
+    uint8_t power = 1;
+    for (uint16_t e = 0u; e < 255u; e++) {
+        if (power == x) return (uint8_t)e;
+        power = reedSolomonMultiply(power, 0x02);
+    }
+    return 0;
+}
+
+
+static void gen_divisor_table(bool log_form) {
+
+    uint8_t divisor[RS_GEN_DEGREE_MAX];
+
+    printf("const uint8_t rs_generators[] = {\n");
+    for (uint8_t degree = 1u; degree <= RS_GEN_DEGREE_MAX; degree++) {
+        gen_divisor(degree, divisor);
+        printf("    ");
+        for (uint8_t j = 0; j < degree; j++)
+            printf("0x%02hXu, ", (log_form) ? gf_log(divisor[j]) : divisor[j]);
+        printf("// %hu\n", degree);
+    }
+    printf("};\n\n");
+}
+
+
+// Generator polynomials for every degree 1 - 30, the output will get autobanked
+static void gentable_generators(void) {
+
+    printf("#include <gbdk/platform.h>\n");
+    printf("#include <stdint.h>\n");
+    printf("#include <stdbool.h>\n\n");
+    printf("#include \"qrcodegen.h\"\n\n");
+    printf("#pragma bank 255 // Autobanked\n\n");
+    printf("BANKREF(qrcode_rs_generators)\n\n");
+
+    printf("// Reed-Solomon divisor (generator) polynomials for degrees 1 - %hu, packed one after another\n", RS_GEN_DEGREE_MAX);
+    printf("// so degree N starts at index (N * (N - 1)) / 2. Coefficients are highest to lowest power,\n");
+    printf("// excluding the leading 1. Generated with: reedsolomon_mmul_lut gen\n\n");
+
+    printf("#if (QR_RS_ENGINE == QR_RS_ENGINE_LOG_EXP)\n\n");
+    printf("// In log form (base 0x02)\n");
+    gen_divisor_table(true);
+    printf("#elif (QR_RS_ENGINE == QR_RS_ENGINE_LUT_BANKED)\n\n");
+    gen_divisor_table(false);
+    printf("#endif // QR_RS_ENGINE\n\n");
 }
 
 
 static void show_help(void) {
-    printf("Error: incorrect arg count! Usage: reedsolomon_mmul_lut <table> (where table is 0-3)\n");
+    printf("Error: incorrect arg count! Usage: reedsolomon_mmul_lut <table> (where table is 0-3, or gen for the generator polynomials)\n");
 }
 
 
@@ -68,6 +148,11 @@ int main( int argc, char *argv[] )  {
         return EXIT_FAILURE;
     }
 
+    if (strcmp(argv[1], "gen") == 0) {
+        gentable_generators();
+        return EXIT_SUCCESS;
+    }
+
     uint8_t table = (uint8_t)strtol(argv[1], NULL, 10);
     if ((table < 0) || (table > 3)) {
         show_help();